@@ -14,6 +14,7 @@
 #include <math.h>
 #include "list.h"
 #include "text_io.h"
+#include "mem_stats.h"
 
 typedef struct func_node func_node;
 typedef func_node* func_list;
@@ -25,21 +26,29 @@ struct func_node{
 
 
 
+int exec(void* arg, FTSENT* file, time_t t);
+
 // frees function func_list
 // doesn't free funct pointers since
 // they are't dynamically allocated
+// exec's arg is a list, the rest are strings
 void func_list_free(func_list* l){
     while(*l != NULL){
         func_list next = (*l)->next;
-        free((*l)->arg);
-        free(*l);
+        if((*l)->funct == exec){
+            list args = (list)(*l)->arg;
+            listfree(&args);
+        }
+        else
+            mem_free(MEM_FUNC, (*l)->arg);
+        mem_free(MEM_FUNC, *l);
         *l = next;
     }
 }
 
 // adds a function node to a list of functions
 void add_func_node(func_list* l, int (*funct1)(void* arg, FTSENT* file, time_t t), void* arg){
-    func_list newnode = (func_list)malloc(sizeof(func_node));
+    func_list newnode = (func_list)mem_alloc(MEM_FUNC, sizeof(func_node));
     newnode->funct = funct1;
     newnode->arg = arg;
     newnode->next = NULL;
@@ -142,13 +151,19 @@ int exec(void* arg, FTSENT* file, time_t t){
 
 // parses arguments into primaries and their
 // corresponding args
+// --mem-stats takes no arg, it prints allocation
+// counts to stderr at exit
 void checkflags(int argc, char* argv[], func_list* flaglist){
         for(int i = 0; i < argc; i+=2){
-            if(strcoll(argv[i],"-cmin") == 0)
-                add_func_node(flaglist, cmin, strdup(argv[i+1]));
+            if(strcoll(argv[i],"--mem-stats") == 0){
+                mem_stats_at_exit();
+                i--;
+            }
+            else if(strcoll(argv[i],"-cmin") == 0)
+                add_func_node(flaglist, cmin, mem_strdup(MEM_FUNC, argv[i+1]));
             else if(strcoll(argv[i],"-cnewer") == 0){
                 struct stat file2;
-                char* argdup = strdup(argv[i+1]);
+                char* argdup = mem_strdup(MEM_FUNC, argv[i+1]);
                 if(stat(argdup, &file2) == 0)
                     add_func_node(flaglist, cnewer, argdup);
                 else{
@@ -157,18 +172,18 @@ void checkflags(int argc, char* argv[], func_list* flaglist){
                 }
             }
             else if(strcoll(argv[i],"-ctime") == 0)
-                add_func_node(flaglist, ctime1, strdup(argv[i+1]));
+                add_func_node(flaglist, ctime1, mem_strdup(MEM_FUNC, argv[i+1]));
             else if(strcoll(argv[i],"-mmin") == 0)
-                add_func_node(flaglist, mmin, strdup(argv[i+1]));
+                add_func_node(flaglist, mmin, mem_strdup(MEM_FUNC, argv[i+1]));
             else if(strcoll(argv[i],"-mtime") == 0)
-                add_func_node(flaglist, mtime, strdup(argv[i+1]));
+                add_func_node(flaglist, mtime, mem_strdup(MEM_FUNC, argv[i+1]));
             else if(strcoll(argv[i],"-type") == 0)
-                add_func_node(flaglist, type, strdup(argv[i+1]));
+                add_func_node(flaglist, type, mem_strdup(MEM_FUNC, argv[i+1]));
             else if(strcoll(argv[i],"-exec") == 0){
                 i++;
                 list args = NULL;
                 while(strcoll(argv[i],";") != 0){
-                    add(strdup(argv[i]), &args);
+                    add(argv[i], &args);
                     i++;
                 }
                 add_func_node(flaglist, exec, (list*)args);
@@ -179,7 +194,7 @@ void checkflags(int argc, char* argv[], func_list* flaglist){
                 exit(1);
             }
         }
-        add_func_node(flaglist, printfunc, strdup("hullo"));
+        add_func_node(flaglist, printfunc, mem_strdup(MEM_FUNC, "hullo"));
 }
 
 // used in find function
@@ -10,6 +10,7 @@
 #include <time.h>
 #include <unistd.h>
 #include "list.h"
+#include "mem_stats.h"
 
 int find_max(list l){
     int max = 0;
@@ -38,8 +39,8 @@ void forall(list l, void(*act)(char*s)){
 }
 
 void add(char* data, list* l){
-    list newnode = (list)malloc(sizeof(node));
-    newnode->data = strdup(data);
+    list newnode = (list)mem_alloc(MEM_LIST, sizeof(node));
+    newnode->data = mem_strdup(MEM_LIST, data);
     newnode->next = NULL;
     while(*l != NULL)
         l = &(*l)->next;
@@ -50,8 +51,8 @@ void listfree(list* l){
     assert(l != NULL);
     while(*l != NULL){
         list next = (*l)->next;
-        free((*l)->data);
-        free(*l);
+        mem_free(MEM_LIST, (*l)->data);
+        mem_free(MEM_LIST, *l);
         *l = next;
     }
 }
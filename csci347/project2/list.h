@@ -25,7 +25,8 @@ void forall(list l, void(*act)(char*s));
 
 /* list add
 *  adds a string, data, to the beginning of list l
-*  data is copied by strdup before being added to the list
+*  data is copied before being added to the list
+*  nodes and copies are counted as list memory
 */
 void add(char* data, list* l);
 
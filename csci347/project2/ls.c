@@ -11,11 +11,18 @@
 #include <unistd.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <getopt.h>
 #include "list.h"
 #include "text_io.h"
+#include "mem_stats.h"
 
 
 #define OPTSTRING "adil"
+#define OPT_MEM_STATS 256
+static const struct option long_opts[] = {
+    {"mem-stats", no_argument, NULL, OPT_MEM_STATS},
+    {NULL, 0, NULL, 0}
+};
 int show_hidden;
 int show_file_stats;
 int show_inode;
@@ -61,8 +68,9 @@ void parse_operands(int argc, char* argv[]){
 }
 
 // handles flags for ls
+// --mem-stats prints allocation counts to stderr at exit
 void parse_args(int argc, char* argv[]){
-    int getopt_check = getopt(argc, argv, OPTSTRING);
+    int getopt_check = getopt_long(argc, argv, OPTSTRING, long_opts, NULL);
     while(getopt_check != -1){
         if(getopt_check == 'a')
             show_hidden = 1;
@@ -72,10 +80,12 @@ void parse_args(int argc, char* argv[]){
             show_inode = 1;
         else if(getopt_check == 'd')
             recurse_dirs = 0;
+        else if(getopt_check == OPT_MEM_STATS)
+            mem_stats_at_exit();
         else{
-            printf("invalid arg, only supports: a, d, i, l\n");
+            printf("invalid arg, only supports: a, d, i, l, --mem-stats\n");
         }
-        getopt_check = getopt(argc, argv, OPTSTRING);
+        getopt_check = getopt_long(argc, argv, OPTSTRING, long_opts, NULL);
     }
 }
 
@@ -186,14 +196,16 @@ void print_stats(char* dir, list l){
         }
         char datestr[36];
         strftime(datestr, 36, "%b %d %H:%M", localtime(&file1.st_mtime));
+        char* mode = format_mode(file1);
         printf("%s %ld %s %s %ld %s ",
-                                        format_mode(file1),
+                                        mode,
                                         (long)file1.st_nlink,
                                         passwordptr->pw_name,
                                         groupptr->gr_name,
                                         (long)file1.st_size,
                                         datestr);
         printf("%s\n", l->data);
+        mem_free(MEM_TEXT, mode);
         free(path);
         l = l->next;
     }
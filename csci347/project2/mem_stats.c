@@ -0,0 +1,105 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "mem_stats.h"
+
+// room in front of each allocation for its size,
+// keeps the alignment malloc gives
+#define MEM_HEADER 16
+
+typedef struct mem_counts mem_counts;
+struct mem_counts{
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long long bytes;
+    unsigned long long live;
+    unsigned long long peak;
+};
+
+static const char* subsys_names[] = {"list", "text", "func"};
+// one per subsystem plus the total
+static mem_counts counts[MEM_SUBSYS_COUNT+1];
+static mem_allocator allocator = {malloc, free};
+
+void mem_set_allocator(mem_allocator* a){
+    if(a != NULL)
+        allocator = *a;
+    else{
+        allocator.alloc = malloc;
+        allocator.free = free;
+    }
+}
+
+// counts an allocation in subsys and the total
+static void count_alloc(enum mem_subsys subsys, size_t size){
+    mem_counts* c[2] = {&counts[subsys], &counts[MEM_SUBSYS_COUNT]};
+    for(int i = 0; i < 2; i++){
+        c[i]->allocs++;
+        c[i]->bytes += size;
+        c[i]->live += size;
+        if(c[i]->live > c[i]->peak)
+            c[i]->peak = c[i]->live;
+    }
+}
+
+// counts a free in subsys and the total
+static void count_free(enum mem_subsys subsys, size_t size){
+    mem_counts* c[2] = {&counts[subsys], &counts[MEM_SUBSYS_COUNT]};
+    for(int i = 0; i < 2; i++){
+        c[i]->frees++;
+        c[i]->live -= size;
+    }
+}
+
+void* mem_alloc(enum mem_subsys subsys, size_t size){
+    char* block = allocator.alloc(size + MEM_HEADER);
+    if(block == NULL){
+        perror("malloc error");
+        exit(1);
+    }
+    memcpy(block, &size, sizeof(size_t));
+    count_alloc(subsys, size);
+    return block + MEM_HEADER;
+}
+
+char* mem_strdup(enum mem_subsys subsys, const char* s){
+    size_t size = strlen(s) + 1;
+    char* copy = mem_alloc(subsys, size);
+    memcpy(copy, s, size);
+    return copy;
+}
+
+void mem_free(enum mem_subsys subsys, void* ptr){
+    if(ptr != NULL){
+        char* block = (char*)ptr - MEM_HEADER;
+        size_t size;
+        memcpy(&size, block, sizeof(size_t));
+        count_free(subsys, size);
+        allocator.free(block);
+    }
+}
+
+void mem_stats_print(FILE* f){
+    for(int i = 0; i <= MEM_SUBSYS_COUNT; i++){
+        mem_counts* c = &counts[i];
+        fprintf(f, "mem,%s,%lu,%lu,%llu,%llu,%llu",
+                (i < MEM_SUBSYS_COUNT) ? subsys_names[i] : "total",
+                c->allocs, c->frees, c->bytes, c->live, c->peak);
+        if(i < MEM_SUBSYS_COUNT)
+            fprintf(f, "\n");
+    }
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+        fprintf(f, ",%ld", usage.ru_maxrss);
+    fprintf(f, "\n");
+}
+
+// atexit handler for mem_stats_at_exit
+static void print_at_exit(){
+    mem_stats_print(stderr);
+}
+
+void mem_stats_at_exit(){
+    atexit(print_at_exit);
+}
@@ -0,0 +1,61 @@
+#if !defined(_c2518798_6936_4bad_b391_6bda62bbe8d6)
+#define _c2518798_6936_4bad_b391_6bda62bbe8d6
+
+#include <stddef.h>
+#include <stdio.h>
+
+// subsystems allocations are counted by
+// MEM_LIST is the string lists, MEM_TEXT the
+// strings built for printing and MEM_FUNC
+// find's primaries and their args
+enum mem_subsys{
+    MEM_LIST,
+    MEM_TEXT,
+    MEM_FUNC,
+    MEM_SUBSYS_COUNT
+};
+
+// allocator the counted allocations come from,
+// malloc and free unless it is replaced
+typedef struct mem_allocator mem_allocator;
+struct mem_allocator{
+    void* (*alloc)(size_t size);
+    void (*free)(void* ptr);
+};
+
+/* mem set_allocator
+*  replaces the allocator, NULL goes back to malloc and free
+*  must be called before anything is allocated
+*/
+void mem_set_allocator(mem_allocator* allocator);
+
+/* mem alloc
+*  allocates size bytes for subsys and counts them
+*  exits on failure like the rest of the tools do
+*/
+void* mem_alloc(enum mem_subsys subsys, size_t size);
+
+/* mem strdup
+*  counted strdup
+*/
+char* mem_strdup(enum mem_subsys subsys, const char* s);
+
+/* mem free
+*  frees memory from mem_alloc or mem_strdup
+*  must be the subsys it was allocated with, NULL is ignored
+*/
+void mem_free(enum mem_subsys subsys, void* ptr);
+
+/* mem stats_print
+*  prints a line per subsystem to f:
+*  mem,subsystem,allocs,frees,bytes,live,peak
+*  then one for all of them with the peak rss in KB on the end
+*/
+void mem_stats_print(FILE* f);
+
+/* mem stats_at_exit
+*  prints the stats to stderr when the program exits
+*/
+void mem_stats_at_exit();
+
+#endif //_c2518798_6936_4bad_b391_6bda62bbe8d6
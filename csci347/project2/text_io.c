@@ -10,6 +10,7 @@
 #include <time.h>
 #include <unistd.h>
 #include "text_io.h"
+#include "mem_stats.h"
 
 
 
@@ -37,7 +38,7 @@ char filetype(struct stat filestat){
 
 
 char* format_mode(struct stat filestat){
-    char* mode = (char*)malloc(sizeof(char) * 11);
+    char* mode = (char*)mem_alloc(MEM_TEXT, sizeof(char) * 11);
     if(filetype(filestat) == 'f')
         mode[0] = '-';
     else
@@ -14,6 +14,7 @@ char filetype(struct stat filestat);
 // build mode string to return to printdata_long
 // has file type fix for reg file being represented
 // as '-' in ls vs 'f' in find
+// free with mem_free(MEM_TEXT, mode)
 char* format_mode(struct stat filestat);
 
 // populates stat struct for a given file
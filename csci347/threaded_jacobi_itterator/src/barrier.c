@@ -1,4 +1,9 @@
 #include "barrier.h"
+#include "topology.h"
+
+// Index of the calling thread in the threads of the last hier_barrier it
+//   waited on, so it is usually found without a search
+static __thread unsigned hier_thread_index = 0;
 
 /**
  * Initializes the generic barrier b. Using the id in barrier_id, it calls the
@@ -27,6 +32,9 @@ int barrier_init(barrier_t *b, barrier_e barrier_id, unsigned thread_num, \
             ret = -1;
         }
 		break;
+    case HIER_BARRIER:
+        ret = hier_barrier_init(&(b->barrier.hier), thread_num, threads);
+        break;
     case BARRIER_TOTAL:
         abort();
         break;
@@ -53,6 +61,9 @@ void barrier_wait(barrier_t *b, pthread_t t) {
     case PTHREAD_BARRIER:
         pthread_barrier_wait(&(b->barrier.pthread));
 		break;
+    case HIER_BARRIER:
+        hier_barrier_wait(&(b->barrier.hier), t);
+        break;
     case BARRIER_TOTAL:
         abort();
         break;
@@ -76,6 +87,9 @@ void barrier_delete(barrier_t *b) {
     case PTHREAD_BARRIER:
         pthread_barrier_destroy(&(b->barrier.pthread));
 		break;
+    case HIER_BARRIER:
+        hier_barrier_delete(&(b->barrier.hier));
+        break;
     case BARRIER_TOTAL:
         abort();
         break;
@@ -152,6 +166,157 @@ int cond_barrier_init(cond_barrier_t *b, unsigned thread_num) {
     return ret;
 }
 
+/**
+ * Initializes a hier_barrier to block thread_num threads. Thread i of threads
+ *   belongs to the cache domain of topology slot i (see topology.h), which is
+ *   where it runs when it is pinned to its slot. Domains without any threads
+ *   are left out of the global level.
+ * Returns 0 if successful, -1 on error and errno is set appropriately.
+ */
+int hier_barrier_init(hier_barrier_t *b, unsigned thread_num, pthread_t **threads) {
+    const topology_t *topo = topology_get();
+    unsigned topo_domains = (topo != NULL) ? topo->domain_num : 1;
+    unsigned *domain_map;
+    int ret = 0;
+
+    assert(b != NULL);
+    b->thread_num = thread_num;
+    b->threads = threads;
+    b->domain_num = 0;
+    b->levels = NULL;
+
+    errno = 0;
+    b->thread_domain = malloc(sizeof(unsigned) * thread_num);
+    domain_map = malloc(sizeof(unsigned) * topo_domains);
+    if (b->thread_domain == NULL || domain_map == NULL) {
+        ret = -1;
+    }
+    else {
+        // Number the domains that have threads in order of first use
+        for (unsigned d = 0; d < topo_domains; d++) {
+            domain_map[d] = topo_domains;
+        }
+        for (unsigned i = 0; i < thread_num; i++) {
+            unsigned d = (topo != NULL) ? topology_slot_domain(topo, i) : 0;
+            if (domain_map[d] == topo_domains) {
+                domain_map[d] = b->domain_num++;
+            }
+            b->thread_domain[i] = domain_map[d];
+        }
+
+        ret = posix_memalign((void**)&(b->levels), sizeof(hier_level_t), \
+            sizeof(hier_level_t) * (b->domain_num + 1));
+        if (ret > 0) {
+            errno = ret;
+            b->levels = NULL;
+            ret = -1;
+        }
+        else {
+            for (unsigned l = 0; l <= b->domain_num; l++) {
+                b->levels[l].count = 0;
+                b->levels[l].thread_num = 0;
+                b->levels[l].generation = 0;
+                pthread_mutex_init(&(b->levels[l].mtx), NULL);
+                pthread_cond_init(&(b->levels[l].ready), NULL);
+            }
+            for (unsigned i = 0; i < thread_num; i++) {
+                b->levels[b->thread_domain[i]].thread_num++;
+            }
+            b->levels[b->domain_num].thread_num = b->domain_num;
+        }
+    }
+    if (ret < 0) {
+        free(b->thread_domain);
+        b->thread_domain = NULL;
+    }
+    free(domain_map);
+    return ret;
+}
+
+/**
+ * Deletes a hier_barrier's levels and thread domains.
+ */
+void hier_barrier_delete(hier_barrier_t *b) {
+    if (b->levels != NULL) {
+        for (unsigned l = 0; l <= b->domain_num; l++) {
+            pthread_mutex_destroy(&(b->levels[l].mtx));
+            pthread_cond_destroy(&(b->levels[l].ready));
+        }
+    }
+    free(b->levels);
+    free(b->thread_domain);
+}
+
+/**
+ * Waits for every thread of a single level. The last thread to arrive opens
+ *   the level for everyone by bumping its generation.
+ */
+void hier_level_wait(hier_level_t *level) {
+    pthread_mutex_lock(&(level->mtx));
+    unsigned generation = level->generation;
+    level->count++;
+    if (level->count < level->thread_num) {
+        while (generation == level->generation) {
+            pthread_cond_wait(&(level->ready), &(level->mtx));
+        }
+    }
+    else {
+        level->count = 0;
+        level->generation++;
+        pthread_cond_broadcast(&(level->ready));
+    }
+    pthread_mutex_unlock(&(level->mtx));
+}
+
+/**
+ * Waits for a hier_barrier.
+ * Algorithm:
+ *   Threads first gather in their own domain. The last thread to arrive in a
+ *   domain goes on to the global level on behalf of the domain, where it
+ *   meets the last arrivals of the other domains. Once every domain is in,
+ *   each of them opens its own domain. So only one thread per domain ever
+ *   touches the shared global level, and the rest only touch state within
+ *   their cache domain.
+ */
+void hier_barrier_wait(hier_barrier_t *b, pthread_t t) {
+    unsigned curr = hier_thread_index;
+    if (curr >= b->thread_num || \
+            pthread_equal((*(b->threads))[curr], t) == 0) {
+        curr = 0;
+        while (curr < b->thread_num && \
+                pthread_equal((*(b->threads))[curr], t) == 0) {
+            curr++;
+        }
+        if (curr == b->thread_num) {
+            abort();
+        }
+        hier_thread_index = curr;
+    }
+
+    hier_level_t *domain = &(b->levels[b->thread_domain[curr]]);
+    pthread_mutex_lock(&(domain->mtx));
+    unsigned generation = domain->generation;
+    domain->count++;
+    if (domain->count < domain->thread_num) {
+        while (generation == domain->generation) {
+            pthread_cond_wait(&(domain->ready), &(domain->mtx));
+        }
+        pthread_mutex_unlock(&(domain->mtx));
+    }
+    else {
+        // Everyone else in the domain is waiting, so nobody touches the
+        //   domain until it is opened
+        pthread_mutex_unlock(&(domain->mtx));
+        hier_level_wait(&(b->levels[b->domain_num]));
+
+        pthread_mutex_lock(&(domain->mtx));
+        domain->count = 0;
+        domain->generation++;
+        pthread_cond_broadcast(&(domain->ready));
+        pthread_mutex_unlock(&(domain->mtx));
+    }
+}
+
 /**
  * Waits for a sem_heap_barrier. Each thread is assigned a unique position in
  *   the heap by passing the list of thread_id's in with the initialization.
@@ -26,13 +26,37 @@ struct cond_barrier {
     pthread_cond_t barrier_ready;
 };
 
+// One level of a hier_barrier: the threads of a cache domain, or the last
+//   thread to arrive in each domain. Kept on its own cache line.
+typedef struct hier_level hier_level_t;
+struct hier_level {
+    pthread_mutex_t mtx;
+    pthread_cond_t ready;
+    unsigned count;
+    unsigned thread_num;
+    // Bumped every time the level opens, so waiters can tell a real wake up
+    unsigned generation;
+} __attribute__((aligned(64)));
+
+typedef struct hier_barrier hier_barrier_t;
+struct hier_barrier {
+    unsigned thread_num;
+    pthread_t **threads;
+    // Domain of each thread, by its index in threads
+    unsigned *thread_domain;
+    unsigned domain_num;
+    // domain_num domain levels, then the global level
+    hier_level_t *levels;
+};
+
 // enum to uniquely id each type of barrier
 typedef enum barrier_e barrier_e;
 enum barrier_e {
     SEM_HEAP_BARRIER = 0,
     COND_BARRIER     = 1,
     PTHREAD_BARRIER  = 2,
-    BARRIER_TOTAL    = 3
+    HIER_BARRIER     = 3,
+    BARRIER_TOTAL    = 4
 };
 
 // Generic barrier type. Union of all possible barriers and an enum to
@@ -43,6 +67,7 @@ struct barrier_t {
         sem_heap_barrier_t sem_heap;
         cond_barrier_t     cond;
         pthread_barrier_t  pthread;
+        hier_barrier_t     hier;
     } barrier;
     barrier_e barrier_id;
 };
@@ -61,11 +86,21 @@ int sem_heap_barrier_init(sem_heap_barrier_t *b, unsigned thread_num, pthread_t
 // Initialization for a cond_barrier. b must point to an allready allocated
 //   cond_barrier_t.
 int cond_barrier_init(cond_barrier_t *b, unsigned thread_num);
+// Initialization for a hier_barrier. b must point to an allready allocated
+//   hier_barrier_t. Like the sem_heap_barrier, threads is needed to tell the
+//   threads apart.
+int hier_barrier_init(hier_barrier_t *b, unsigned thread_num, pthread_t **threads);
 
 // Wait for a sem_heap_barrier. The b must already be initialized.
 void sem_heap_barrier_wait(sem_heap_barrier_t *b, pthread_t t);
 // Wait for a sem_heap_barrier. The b must already be initialized.
 void cond_barrier_wait(cond_barrier_t *b);
+// Wait for a hier_barrier. The b must already be initialized.
+void hier_barrier_wait(hier_barrier_t *b, pthread_t t);
+
+// Helpers for hier_barrier
+void hier_barrier_delete(hier_barrier_t *b);
+void hier_level_wait(hier_level_t *level);
 
 // Helpers for sem_heap_barrier_wait.
 unsigned get_heap_lchild(unsigned n, unsigned heap_max);
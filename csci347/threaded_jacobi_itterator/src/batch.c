@@ -0,0 +1,345 @@
+#include "batch.h"
+
+/**
+ * Frees a job and everything loaded for it.
+ */
+void batch_job_delete(batch_job_t *job) {
+    if (job->input_matrix != NULL) {
+        matrix_delete(&(job->input_matrix));
+    }
+    if (job->mask_p != NULL) {
+        mask_delete(job->mask_p);
+    }
+    free(job->input_fname);
+    free(job->output_fname);
+    free(job->mask_fname);
+    free(job);
+}
+
+/**
+ * Reads the input and mask of a job. Failures are kept in job->err and
+ *   job->err_no so they are reported by the worker with the other results.
+ */
+void batch_job_load(batch_job_t *job) {
+    job->input_matrix = NULL;
+    job->mask_p = NULL;
+    job->active_cells = (MATRIX_ROWS-2) * (MATRIX_COLS-2);
+
+    job->err = MAT_ERR_NONE;
+    if (job->mask_fname != NULL) {
+        job->err = mask_file_in(&(job->mask), job->mask_fname);
+        if (job->err == MAT_ERR_NONE) {
+            job->mask_p = &(job->mask);
+            job->active_cells = job->mask.active_cells;
+        }
+    }
+    if (job->err == MAT_ERR_NONE) {
+        job->err = matrix_init(&(job->input_matrix));
+        if (job->err == MAT_ERR_NONE) {
+            job->err = matrix_file_in(job->input_matrix, job->input_fname);
+        }
+    }
+    job->err_no = (job->err == MAT_ERR_NONE) ? 0 : errno;
+}
+
+/**
+ * Picks the number of threads for a job. Small jobs get one so the pool runs
+ *   many of them side by side, bigger ones one thread per BATCH_SPLIT_CELLS
+ *   active cells, up to the available threads of the pool. Rounded down to a
+ *   power of 2 so the square partitions of the barrier test work too.
+ */
+unsigned batch_job_threads(batch_job_t *job, unsigned available) {
+    unsigned long threads = job->active_cells / BATCH_SPLIT_CELLS;
+    if (threads > available) {
+        threads = available;
+    }
+    unsigned pow2 = 1;
+    while (pow2 * 2 <= threads) {
+        pow2 *= 2;
+    }
+    return pow2;
+}
+
+/**
+ * Loads every job in the batch list and queues it for the workers, blocking
+ *   while the queue is full. Each line is "input output [mask]".
+ */
+void* batch_loader(void* arg) {
+    batch_t *b = (batch_t*)arg;
+    char *line = NULL;
+    size_t line_len = 0;
+
+    while (getline(&line, &line_len, b->list) != -1) {
+        char *input_fname = NULL, *output_fname = NULL, *mask_fname = NULL;
+        if (sscanf(line, "%ms %ms %ms", &input_fname, &output_fname, \
+                &mask_fname) < 2) {
+            free(input_fname);
+            continue;
+        }
+
+        errno = 0;
+        batch_job_t *job = malloc(sizeof(batch_job_t));
+        if (job == NULL) {
+            int err_no = errno;
+            pthread_mutex_lock(&(b->out_mtx));
+            printf("%s,failed,%s\n", input_fname, strerror(err_no));
+            b->failed++;
+            pthread_mutex_unlock(&(b->out_mtx));
+            free(input_fname);
+            free(output_fname);
+            free(mask_fname);
+            continue;
+        }
+        job->input_fname = input_fname;
+        job->output_fname = output_fname;
+        job->mask_fname = mask_fname;
+        batch_job_load(job);
+
+        pthread_mutex_lock(&(b->queue_mtx));
+        while (b->queue_count == BATCH_QUEUE_LEN) {
+            pthread_cond_wait(&(b->queue_not_full), &(b->queue_mtx));
+        }
+        b->queue[(b->queue_head + b->queue_count) % BATCH_QUEUE_LEN] = job;
+        b->queue_count++;
+        pthread_cond_signal(&(b->queue_not_empty));
+        pthread_mutex_unlock(&(b->queue_mtx));
+    }
+    free(line);
+
+    pthread_mutex_lock(&(b->queue_mtx));
+    b->loading_done = true;
+    pthread_cond_broadcast(&(b->queue_not_empty));
+    pthread_mutex_unlock(&(b->queue_mtx));
+    pthread_exit(NULL);
+}
+
+/**
+ * Takes the next loaded job off the queue, once the pool has a thread free
+ *   for it. Returns NULL once the loader is done and the queue is empty.
+ * The job takes a thread of the pool, and if it is the last job of the
+ *   batch, as many of the free ones as batch_job_threads wants for it, since
+ *   no other job will ever use them.
+ */
+batch_job_t *batch_next_job(batch_t *b) {
+    batch_job_t *job = NULL;
+
+    pthread_mutex_lock(&(b->queue_mtx));
+    while ((b->queue_count == 0 && !b->loading_done) || \
+            (b->queue_count > 0 && b->free_threads == 0)) {
+        pthread_cond_wait(&(b->queue_not_empty), &(b->queue_mtx));
+    }
+    if (b->queue_count > 0) {
+        job = b->queue[b->queue_head];
+        b->queue_head = (b->queue_head + 1) % BATCH_QUEUE_LEN;
+        b->queue_count--;
+        pthread_cond_signal(&(b->queue_not_full));
+
+        job->threads = 1;
+        if (job->err == MAT_ERR_NONE && b->queue_count == 0 && \
+                b->loading_done) {
+            job->threads = batch_job_threads(job, b->free_threads);
+        }
+        b->free_threads -= job->threads;
+    }
+    pthread_mutex_unlock(&(b->queue_mtx));
+    return job;
+}
+
+/**
+ * Hands the threads of a solved job back to the pool.
+ */
+void batch_job_done(batch_t *b, batch_job_t *job) {
+    pthread_mutex_lock(&(b->queue_mtx));
+    b->free_threads += job->threads;
+    pthread_cond_broadcast(&(b->queue_not_empty));
+    pthread_mutex_unlock(&(b->queue_mtx));
+}
+
+/**
+ * Solves a single loaded job with threads subtasks (0 solves it on the calling
+ *   worker) and writes its output.
+ */
+int batch_job_solve(batch_t *b, batch_job_t *job, unsigned threads, \
+        unsigned *iterations) {
+    jacobi_opts_t opts;
+    jacobi_ctx_t *ctx;
+    struct runtime_stats rs;
+    int ret = 0;
+
+    jacobi_opts_default(&opts);
+    opts.barrier_id = b->barrier_id;
+    opts.subtask_num = threads;
+    opts.mask = job->mask_p;
+    opts.stencil = b->stencil;
+
+    if (jacobi_create(&ctx, &opts, job->input_matrix) != JACOBI_ERR_NONE) {
+        ret = -1;
+    }
+    else {
+        if (jacobi_solve(ctx, &rs) != JACOBI_ERR_NONE) {
+            ret = -1;
+        }
+        else {
+            *iterations = rs.iterations;
+            if (matrix_file_out(jacobi_result(ctx), job->output_fname) != \
+                    MAT_ERR_NONE) {
+                ret = -1;
+            }
+        }
+        jacobi_destroy(ctx);
+    }
+    return ret;
+}
+
+/**
+ * Solves jobs until there are none left, writes their output, and prints one
+ *   result line per job: input,threads,iterations,real-time elapsed(ms)
+ */
+void* batch_worker(void* arg) {
+    batch_t *b = (batch_t*)arg;
+    batch_job_t *job;
+
+    while ((job = batch_next_job(b)) != NULL) {
+        struct timespec starttime_real, endtime_real, runtime_real;
+        unsigned iterations = 0;
+        bool failed = (job->err != MAT_ERR_NONE);
+
+        clock_gettime(CLOCK_MONOTONIC_RAW, &starttime_real);
+        if (!failed) {
+            errno = 0;
+            if (batch_job_solve(b, job, (job->threads > 1) ? job->threads : \
+                    0, &iterations) < 0) {
+                failed = true;
+                job->err_no = errno;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC_RAW, &endtime_real);
+        timespec_diff(&endtime_real, &starttime_real, &runtime_real);
+        batch_job_done(b, job);
+
+        pthread_mutex_lock(&(b->out_mtx));
+        if (failed) {
+            printf("%s,failed,%s\n", job->input_fname, (job->err_no != 0) ? \
+                strerror(job->err_no) : "solve failed");
+            b->failed++;
+        }
+        else {
+            printf("%s,%u,%d,%.10e,\n", job->input_fname, job->threads, \
+                iterations, conv_timespec_to_ms(&runtime_real));
+            b->solved++;
+        }
+        pthread_mutex_unlock(&(b->out_mtx));
+
+        batch_job_delete(job);
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Starts the loader and worker_num workers and waits for all of them to finish.
+ * Returns 0 on success, -1 if a thread could not be created and errno is set.
+ */
+int batch_pool_run(batch_t *b, pthread_t *workers) {
+    pthread_t loader;
+    int ret = 0;
+
+    int err = pthread_create(&loader, NULL, batch_loader, (void*)b);
+    if (err > 0) {
+        errno = err;
+        ret = -1;
+    }
+    else {
+        unsigned t = 0;
+        while (err == 0 && t < b->worker_num) {
+            err = pthread_create(&(workers[t]), NULL, batch_worker, (void*)b);
+            if (err == 0) {
+                t++;
+            }
+        }
+        if (err > 0) {
+            errno = err;
+            ret = -1;
+        }
+        // Without any workers the queue has to be drained here, otherwise the
+        //   loader blocks forever on a full queue. Nothing is solved, so the
+        //   jobs just need a thread to be taken with.
+        if (t == 0) {
+            batch_job_t *job;
+            pthread_mutex_lock(&(b->queue_mtx));
+            b->free_threads = 1;
+            pthread_mutex_unlock(&(b->queue_mtx));
+            while ((job = batch_next_job(b)) != NULL) {
+                batch_job_done(b, job);
+                batch_job_delete(job);
+            }
+        }
+        for (unsigned j = 0; j < t; j++) {
+            pthread_join(workers[j], NULL);
+        }
+        pthread_join(loader, NULL);
+    }
+    return ret;
+}
+
+/**
+ * Runs every job in the batch list on a pool of worker_num workers. Prints
+ *   a summary once all are done: batch,solved,failed,real-time elapsed(ms),
+ *   solves per second
+ * The number of jobs that failed is stored in failed.
+ * Returns 0 on success, -1 if the pool could not run and errno is set.
+ */
+int batch_run(char *list_fname, barrier_e barrier_id, unsigned worker_num, \
+        const stencil_t *stencil, unsigned *failed) {
+    batch_t b;
+    pthread_t *workers;
+    struct timespec starttime_real, endtime_real, runtime_real;
+    int ret = 0;
+
+    errno = 0;
+    b.list = fopen(list_fname, "r");
+    if (b.list == NULL) {
+        ret = -1;
+    }
+    else {
+        errno = 0;
+        workers = malloc(sizeof(pthread_t) * worker_num);
+        if (workers == NULL) {
+            ret = -1;
+        }
+        else {
+            b.barrier_id = barrier_id;
+            b.stencil = stencil;
+            b.worker_num = worker_num;
+            b.queue_head = 0;
+            b.queue_count = 0;
+            b.loading_done = false;
+            b.free_threads = worker_num;
+            b.solved = 0;
+            b.failed = 0;
+            pthread_mutex_init(&(b.queue_mtx), NULL);
+            pthread_cond_init(&(b.queue_not_empty), NULL);
+            pthread_cond_init(&(b.queue_not_full), NULL);
+            pthread_mutex_init(&(b.out_mtx), NULL);
+
+            clock_gettime(CLOCK_MONOTONIC_RAW, &starttime_real);
+            ret = batch_pool_run(&b, workers);
+            clock_gettime(CLOCK_MONOTONIC_RAW, &endtime_real);
+            timespec_diff(&endtime_real, &starttime_real, &runtime_real);
+
+            if (ret == 0) {
+                double ms = conv_timespec_to_ms(&runtime_real);
+                printf("batch,%u,%u,%.10e,%.10e,", b.solved, b.failed, ms, \
+                    (ms > 0.0) ? b.solved / (ms / 1000.0) : 0.0);
+                *failed = b.failed;
+            }
+
+            pthread_mutex_destroy(&(b.queue_mtx));
+            pthread_cond_destroy(&(b.queue_not_empty));
+            pthread_cond_destroy(&(b.queue_not_full));
+            pthread_mutex_destroy(&(b.out_mtx));
+            free(workers);
+        }
+        fclose(b.list);
+    }
+    return ret;
+}
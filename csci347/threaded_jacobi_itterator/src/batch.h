@@ -0,0 +1,79 @@
+#ifndef __BATCH_H
+#define __BATCH_H
+#include "jacobi.h"
+#include <stdio.h>
+
+// Batch mode
+// A loader thread reads the jobs in the batch list ahead of time into a bounded
+//   queue, overlapping input with the solves. A pool of workers takes jobs off
+//   the queue. Small jobs are solved on the worker alone, so the pool runs as
+//   many of them at once as it has workers. Jobs with enough active cells are
+//   split across several threads instead, but only with threads the pool
+//   isn't using: the pool has one thread per worker to hand out, a worker
+//   takes one for every job it solves, and only the last jobs of the batch,
+//   once there are no more to wait for, are given more. So the solves never
+//   run more threads between them than there are workers. Every job has its
+//   own solver context, so split jobs run alongside everything else.
+
+// Jobs with fewer active cells than this are solved by a single worker, and
+//   split jobs get one thread per this many active cells.
+#define BATCH_SPLIT_CELLS (256UL * 256UL)
+// Number of loaded jobs that can wait for a worker
+#define BATCH_QUEUE_LEN 16
+
+// A single input of the batch and everything loaded for it
+typedef struct batch_job batch_job_t;
+struct batch_job {
+    char *input_fname;
+    char *output_fname;
+    char *mask_fname;
+    double (*input_matrix)[MATRIX_STRIDE];
+    mask_t mask;
+    mask_t *mask_p;
+    unsigned long active_cells;
+    // Threads the job was given out of the pool's, at least 1
+    unsigned threads;
+    mat_err err;
+    int err_no;
+};
+
+// Shared state of a batch run
+typedef struct batch batch_t;
+struct batch {
+    FILE *list;
+    barrier_e barrier_id;
+    const stencil_t *stencil;
+    unsigned worker_num;
+
+    // Queue of loaded jobs, filled by the loader and drained by the workers
+    pthread_mutex_t queue_mtx;
+    pthread_cond_t queue_not_empty;
+    pthread_cond_t queue_not_full;
+    batch_job_t *queue[BATCH_QUEUE_LEN];
+    unsigned queue_head;
+    unsigned queue_count;
+    bool loading_done;
+    // Threads not taken by a job being solved, guarded by queue_mtx.
+    //   queue_not_empty is also signalled when threads are handed back.
+    unsigned free_threads;
+
+    // Keeps the result lines of different workers from interleaving
+    pthread_mutex_t out_mtx;
+    unsigned solved;
+    unsigned failed;
+};
+
+// Runs every job in the batch list on a pool of worker_num workers.
+int batch_run(char *list_fname, barrier_e barrier_id, unsigned worker_num, \
+    const stencil_t *stencil, unsigned *failed);
+
+// Helpers for batch_run
+void batch_job_load(batch_job_t *job);
+void batch_job_delete(batch_job_t *job);
+unsigned batch_job_threads(batch_job_t *job, unsigned available);
+int batch_job_solve(batch_t *b, batch_job_t *job, unsigned threads, \
+    unsigned *iterations);
+batch_job_t *batch_next_job(batch_t *b);
+void batch_job_done(batch_t *b, batch_job_t *job);
+
+#endif /* __BATCH_H */
@@ -0,0 +1,661 @@
+#include "compress.h"
+#include "pyramid.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Bit stream writer, most significant bit first
+typedef struct cmtx_bitw cmtx_bitw_t;
+struct cmtx_bitw {
+    uint8_t *buf;
+    size_t pos;
+    uint64_t acc;
+    unsigned nbits;
+};
+
+// Bit stream reader. Reading past the end gives zeros and sets overrun.
+typedef struct cmtx_bitr cmtx_bitr_t;
+struct cmtx_bitr {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+    uint64_t acc;
+    unsigned nbits;
+    bool overrun;
+};
+
+// Arguments of a thread compressing one block
+typedef struct cmtx_out_arg cmtx_out_arg_t;
+struct cmtx_out_arg {
+    double (*matrix)[MATRIX_STRIDE];
+    unsigned block_id;
+    uint8_t *buf;
+    size_t bytes;
+};
+
+// Arguments of a thread decompressing blocks into a matrix
+typedef struct cmtx_in_arg cmtx_in_arg_t;
+struct cmtx_in_arg {
+    double (*matrix)[MATRIX_STRIDE];
+    char *fname;
+    // Next block to decompress, shared between the threads
+    unsigned *next_block;
+    mat_err ret;
+    int err_no;
+};
+
+/**
+ * Appends the low n bits of v, n is at most 32.
+ */
+static inline void cmtx_bitw_put(cmtx_bitw_t *w, uint64_t v, unsigned n) {
+    w->acc = (w->acc << n) | (v & ((1ULL << n) - 1));
+    w->nbits += n;
+    while (w->nbits >= 8) {
+        w->nbits -= 8;
+        w->buf[w->pos++] = (uint8_t)(w->acc >> w->nbits);
+    }
+}
+
+/**
+ * Takes the next n bits, n is at most 32.
+ */
+static inline uint64_t cmtx_bitr_get(cmtx_bitr_t *r, unsigned n) {
+    while (r->nbits < n) {
+        uint8_t byte = 0;
+        if (r->pos < r->len) {
+            byte = r->buf[r->pos++];
+        }
+        else {
+            r->overrun = true;
+        }
+        r->acc = (r->acc << 8) | byte;
+        r->nbits += 8;
+    }
+    r->nbits -= n;
+    return (r->acc >> r->nbits) & ((1ULL << n) - 1);
+}
+
+/**
+ * Predicts a value from the ones coded before it. The first row of a block
+ *   has nothing above it, so it only uses the value to the left.
+ */
+static inline double cmtx_predict(const double *row, const double *above, \
+        unsigned col) {
+    double pred;
+    if (above == NULL) {
+        pred = (col > 0) ? row[col-1] : 0.0;
+    }
+    else if (col == 0) {
+        pred = above[0];
+    }
+    else {
+        pred = row[col-1] + above[col] - above[col-1];
+    }
+    return pred;
+}
+
+/**
+ * Compresses rows of a matrix into buf, which holds at least
+ *   CMTX_BLOCK_BYTES_MAX(rows, cols) bytes. Returns the bytes used.
+ */
+size_t cmtx_compress_block(const double *src, size_t stride, unsigned rows, \
+        unsigned cols, uint8_t *buf) {
+    cmtx_bitw_t w = {buf, 0, 0, 0};
+    const double *above = NULL;
+
+    for (unsigned row = 0; row < rows; row++) {
+        const double *cur = src + stride * row;
+        for (unsigned col = 0; col < cols; col++) {
+            double pred = cmtx_predict(cur, above, col);
+            uint64_t bits, pred_bits;
+            memcpy(&bits, &cur[col], sizeof(uint64_t));
+            memcpy(&pred_bits, &pred, sizeof(uint64_t));
+
+            uint64_t x = bits ^ pred_bits;
+            if (x == 0) {
+                cmtx_bitw_put(&w, 0, 1);
+            }
+            else {
+                unsigned lz = __builtin_clzll(x);
+                unsigned tz = __builtin_ctzll(x);
+                unsigned len = 64 - lz - tz;
+                uint64_t sig = x >> tz;
+                cmtx_bitw_put(&w, 1, 1);
+                cmtx_bitw_put(&w, lz, 6);
+                cmtx_bitw_put(&w, len-1, 6);
+                if (len > 32) {
+                    cmtx_bitw_put(&w, sig >> 32, len-32);
+                    cmtx_bitw_put(&w, sig, 32);
+                }
+                else {
+                    cmtx_bitw_put(&w, sig, len);
+                }
+            }
+        }
+        above = cur;
+    }
+    if (w.nbits > 0) {
+        cmtx_bitw_put(&w, 0, 8 - w.nbits);
+    }
+    return w.pos;
+}
+
+/**
+ * Decompresses a block into rows * cols doubles at dst. Returns false if the
+ *   block is corrupt.
+ */
+bool cmtx_decompress_block(const uint8_t *buf, size_t bytes, double *dst, \
+        unsigned rows, unsigned cols) {
+    cmtx_bitr_t r = {buf, bytes, 0, 0, 0, false};
+    const double *above = NULL;
+    bool ok = true;
+
+    for (unsigned row = 0; row < rows && ok; row++) {
+        double *cur = dst + (size_t)cols * row;
+        for (unsigned col = 0; col < cols && ok; col++) {
+            double pred = cmtx_predict(cur, above, col);
+            uint64_t x = 0, pred_bits;
+            memcpy(&pred_bits, &pred, sizeof(uint64_t));
+
+            if (cmtx_bitr_get(&r, 1) != 0) {
+                unsigned lz = cmtx_bitr_get(&r, 6);
+                unsigned len = cmtx_bitr_get(&r, 6) + 1;
+                if (lz + len > 64) {
+                    ok = false;
+                }
+                else {
+                    if (len > 32) {
+                        x = cmtx_bitr_get(&r, len-32) << 32;
+                        x |= cmtx_bitr_get(&r, 32);
+                    }
+                    else {
+                        x = cmtx_bitr_get(&r, len);
+                    }
+                    x <<= 64 - lz - len;
+                }
+            }
+            x ^= pred_bits;
+            memcpy(&cur[col], &x, sizeof(uint64_t));
+        }
+        above = cur;
+    }
+    return ok && !r.overrun;
+}
+
+/**
+ * True if the file starts with the compressed matrix magic.
+ */
+bool cmtx_file_check(char *fname) {
+    char magic[CMTX_MAGIC_LEN];
+    bool ret = false;
+
+    FILE *f = fopen(fname, "r");
+    if (f != NULL) {
+        ret = (fread(magic, 1, CMTX_MAGIC_LEN, f) == CMTX_MAGIC_LEN && \
+            memcmp(magic, CMTX_MAGIC, CMTX_MAGIC_LEN) == 0);
+        fclose(f);
+    }
+    return ret;
+}
+
+/**
+ * Opens a compressed file and reads its header and block index. On error
+ *   nothing is left open.
+ */
+mat_err cmtx_open(cmtx_file_t *cf, char *fname) {
+    cmtx_header_t *h = &(cf->header);
+    cmtx_trailer_t trailer;
+    struct stat st;
+    mat_err ret = MAT_ERR_NONE;
+
+    cf->index = NULL;
+    cf->buf = NULL;
+    cf->block = NULL;
+    cf->block_cached = UINT_MAX;
+
+    errno = 0;
+    cf->fd = open(fname, O_RDONLY);
+    if (cf->fd < 0) {
+        ret = MAT_ERR_FOPEN;
+    }
+    else if (fstat(cf->fd, &st) < 0 || \
+            st.st_size < (off_t)(sizeof(cmtx_header_t) + \
+            sizeof(cmtx_trailer_t)) || \
+            pread(cf->fd, h, sizeof(cmtx_header_t), 0) != \
+            sizeof(cmtx_header_t) || \
+            pread(cf->fd, &trailer, sizeof(cmtx_trailer_t), \
+            st.st_size - sizeof(cmtx_trailer_t)) != sizeof(cmtx_trailer_t) || \
+            memcmp(h->magic, CMTX_MAGIC, CMTX_MAGIC_LEN) != 0 || \
+            memcmp(trailer.magic, CMTX_MAGIC, CMTX_MAGIC_LEN) != 0 || \
+            h->version != CMTX_VERSION || h->rows == 0 || h->cols == 0 || \
+            h->block_rows == 0 || \
+            h->block_num != (h->rows + h->block_rows - 1) / h->block_rows || \
+            trailer.index_offset + sizeof(cmtx_index_t) * h->block_num != \
+            st.st_size - sizeof(cmtx_trailer_t)) {
+        errno = EILSEQ;
+        ret = MAT_ERR_FSCANF;
+    }
+    else {
+        size_t bytes_max = CMTX_BLOCK_BYTES_MAX(h->block_rows, h->cols);
+        cf->index = malloc(sizeof(cmtx_index_t) * h->block_num);
+        cf->buf = malloc(bytes_max);
+        cf->block = malloc(sizeof(double) * h->block_rows * h->cols);
+        if (cf->index == NULL || cf->buf == NULL || cf->block == NULL) {
+            ret = MAT_ERR_MALLOC;
+        }
+        else if (pread(cf->fd, cf->index, sizeof(cmtx_index_t) * \
+                h->block_num, trailer.index_offset) != \
+                (ssize_t)(sizeof(cmtx_index_t) * h->block_num)) {
+            errno = EILSEQ;
+            ret = MAT_ERR_FSCANF;
+        }
+        else {
+            for (unsigned b = 0; b < h->block_num; b++) {
+                if (cf->index[b].bytes > bytes_max || \
+                        cf->index[b].offset + cf->index[b].bytes > \
+                        trailer.index_offset) {
+                    errno = EILSEQ;
+                    ret = MAT_ERR_FSCANF;
+                }
+            }
+        }
+    }
+    if (ret != MAT_ERR_NONE) {
+        int err_no = errno;
+        cmtx_close(cf);
+        errno = err_no;
+    }
+    return ret;
+}
+
+/**
+ * Decompresses a block into cf->block, unless it is already there.
+ */
+mat_err cmtx_read_block(cmtx_file_t *cf, unsigned block_id) {
+    mat_err ret = MAT_ERR_NONE;
+
+    if (block_id != cf->block_cached) {
+        cmtx_index_t *index = &(cf->index[block_id]);
+        unsigned rows = cf->header.rows - block_id * cf->header.block_rows;
+        if (rows > cf->header.block_rows) {
+            rows = cf->header.block_rows;
+        }
+
+        cf->block_cached = UINT_MAX;
+        errno = 0;
+        if (pread(cf->fd, cf->buf, index->bytes, index->offset) != \
+                (ssize_t)index->bytes) {
+            if (errno == 0) {
+                errno = EIO;
+            }
+            ret = MAT_ERR_FSCANF;
+        }
+        else if (!cmtx_decompress_block(cf->buf, index->bytes, cf->block, \
+                rows, cf->header.cols)) {
+            errno = EILSEQ;
+            ret = MAT_ERR_FSCANF;
+        }
+        else {
+            cf->block_cached = block_id;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Reads row_num rows starting at row_start into rows, which holds
+ *   row_num * cols doubles. Only the blocks holding those rows are
+ *   decompressed.
+ */
+mat_err cmtx_read_rows(cmtx_file_t *cf, double *rows, unsigned row_start, \
+        unsigned row_num) {
+    mat_err ret = MAT_ERR_NONE;
+    unsigned cols = cf->header.cols;
+
+    if (row_start + row_num > cf->header.rows) {
+        errno = EILSEQ;
+        ret = MAT_ERR_FSCANF;
+    }
+    unsigned row = row_start;
+    while (row < row_start + row_num && ret == MAT_ERR_NONE) {
+        unsigned block_id = row / cf->header.block_rows;
+        ret = cmtx_read_block(cf, block_id);
+        if (ret == MAT_ERR_NONE) {
+            memcpy(rows + (size_t)cols * (row - row_start), cf->block + \
+                (size_t)cols * (row - block_id * cf->header.block_rows), \
+                sizeof(double) * cols);
+        }
+        row++;
+    }
+    return ret;
+}
+
+/**
+ * Closes a compressed file and frees its buffers.
+ */
+void cmtx_close(cmtx_file_t *cf) {
+    if (cf->fd >= 0) {
+        close(cf->fd);
+    }
+    free(cf->index);
+    free(cf->buf);
+    free(cf->block);
+    cf->fd = -1;
+    cf->index = NULL;
+    cf->buf = NULL;
+    cf->block = NULL;
+}
+
+/**
+ * Takes blocks off the shared counter and decompresses them into the matrix.
+ *   When the file is bigger than the matrix, the rows and columns are sampled
+ *   the same way matrix_file_in samples a text file.
+ */
+void* cmtx_in_thread(void *arg) {
+    cmtx_in_arg_t *in_arg = (cmtx_in_arg_t*)arg;
+    cmtx_file_t cf;
+
+    in_arg->ret = cmtx_open(&cf, in_arg->fname);
+    if (in_arg->ret == MAT_ERR_NONE) {
+        cmtx_header_t *h = &(cf.header);
+        if (h->rows < MATRIX_ROWS || h->cols < MATRIX_COLS) {
+            errno = EILSEQ;
+            in_arg->ret = MAT_ERR_FSCANF;
+        }
+        unsigned block_id = __atomic_fetch_add(in_arg->next_block, 1, \
+            __ATOMIC_RELAXED);
+        while (block_id < h->block_num && in_arg->ret == MAT_ERR_NONE) {
+            in_arg->ret = cmtx_read_block(&cf, block_id);
+            unsigned src_start = block_id * h->block_rows;
+            unsigned row = 0;
+            while (row < MATRIX_ROWS && in_arg->ret == MAT_ERR_NONE) {
+                unsigned src_row = pyramid_sample_index(row, MATRIX_ROWS, \
+                    h->rows);
+                if (src_row >= src_start && src_row < src_start + \
+                        h->block_rows) {
+                    double *src = cf.block + (size_t)h->cols * \
+                        (src_row - src_start);
+                    if (h->cols == MATRIX_COLS) {
+                        memcpy(in_arg->matrix[row], src, \
+                            sizeof(double) * MATRIX_COLS);
+                    }
+                    else {
+                        for (unsigned col = 0; col < MATRIX_COLS; col++) {
+                            in_arg->matrix[row][col] = src[ \
+                                pyramid_sample_index(col, MATRIX_COLS, \
+                                h->cols)];
+                        }
+                    }
+                }
+                row++;
+            }
+            block_id = __atomic_fetch_add(in_arg->next_block, 1, \
+                __ATOMIC_RELAXED);
+        }
+        cmtx_close(&cf);
+    }
+    in_arg->err_no = errno;
+    return NULL;
+}
+
+/**
+ * Reads a matrix from a compressed file, decompressing blocks on as many
+ *   threads as there are online CPUs. If no thread can be started the calling
+ *   thread does all of it.
+ */
+mat_err cmtx_file_in(double (*matrix)[MATRIX_STRIDE], char *input_fname) {
+    unsigned thread_num = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned next_block = 0;
+    pthread_t *threads;
+    cmtx_in_arg_t *args;
+    mat_err ret = MAT_ERR_NONE;
+
+    if (thread_num == 0) {
+        thread_num = 1;
+    }
+    errno = 0;
+    threads = malloc(sizeof(pthread_t) * thread_num);
+    args = malloc(sizeof(cmtx_in_arg_t) * thread_num);
+    if (threads == NULL || args == NULL) {
+        ret = MAT_ERR_MALLOC;
+    }
+    else {
+        unsigned t = 0;
+        bool started = true;
+        while (t < thread_num && started) {
+            args[t].matrix = matrix;
+            args[t].fname = input_fname;
+            args[t].next_block = &next_block;
+            started = (pthread_create(&(threads[t]), NULL, cmtx_in_thread, \
+                (void*)&(args[t])) == 0);
+            if (started) {
+                t++;
+            }
+        }
+        if (t == 0) {
+            cmtx_in_thread((void*)&(args[0]));
+            if (args[0].ret != MAT_ERR_NONE) {
+                ret = args[0].ret;
+                errno = args[0].err_no;
+            }
+        }
+        for (unsigned i = 0; i < t; i++) {
+            pthread_join(threads[i], NULL);
+            if (args[i].ret != MAT_ERR_NONE) {
+                ret = args[i].ret;
+                errno = args[i].err_no;
+            }
+        }
+    }
+    free(threads);
+    free(args);
+    return ret;
+}
+
+/**
+ * Compresses one block of the matrix.
+ */
+void* cmtx_out_thread(void *arg) {
+    cmtx_out_arg_t *out_arg = (cmtx_out_arg_t*)arg;
+    unsigned row_start = out_arg->block_id * CMTX_BLOCK_ROWS;
+    unsigned rows = MATRIX_ROWS - row_start;
+    if (rows > CMTX_BLOCK_ROWS) {
+        rows = CMTX_BLOCK_ROWS;
+    }
+    out_arg->bytes = cmtx_compress_block(out_arg->matrix[row_start], \
+        MATRIX_STRIDE, rows, MATRIX_COLS, out_arg->buf);
+    return NULL;
+}
+
+/**
+ * Writes a matrix to a compressed file. Blocks are compressed a wave at a
+ *   time, one per thread, and each wave is written out in order before the
+ *   next one starts, so only a wave's worth of compressed data is ever held.
+ */
+mat_err cmtx_file_out(double (*matrix)[MATRIX_STRIDE], char *output_fname) {
+    cmtx_header_t header;
+    cmtx_trailer_t trailer;
+    cmtx_index_t *index;
+    cmtx_out_arg_t *args;
+    pthread_t *threads;
+    bool *started;
+    uint8_t *bufs;
+    FILE *output;
+    mat_err ret = MAT_ERR_NONE;
+
+    memcpy(header.magic, CMTX_MAGIC, CMTX_MAGIC_LEN);
+    header.version = CMTX_VERSION;
+    header.rows = MATRIX_ROWS;
+    header.cols = MATRIX_COLS;
+    header.block_rows = CMTX_BLOCK_ROWS;
+    header.block_num = (MATRIX_ROWS + CMTX_BLOCK_ROWS - 1) / CMTX_BLOCK_ROWS;
+    header.reserved = 0;
+
+    unsigned thread_num = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_num == 0) {
+        thread_num = 1;
+    }
+    if (thread_num > header.block_num) {
+        thread_num = header.block_num;
+    }
+    size_t bytes_max = CMTX_BLOCK_BYTES_MAX(CMTX_BLOCK_ROWS, MATRIX_COLS);
+
+    errno = 0;
+    index = malloc(sizeof(cmtx_index_t) * header.block_num);
+    args = malloc(sizeof(cmtx_out_arg_t) * thread_num);
+    threads = malloc(sizeof(pthread_t) * thread_num);
+    started = malloc(sizeof(bool) * thread_num);
+    bufs = malloc(bytes_max * thread_num);
+    if (index == NULL || args == NULL || threads == NULL || started == NULL || \
+            bufs == NULL) {
+        ret = MAT_ERR_MALLOC;
+    }
+    else {
+        output = fopen(output_fname, "w+");
+        if (output == NULL) {
+            ret = MAT_ERR_FOPEN;
+        }
+        else {
+            uint64_t offset = sizeof(cmtx_header_t);
+            if (fwrite(&header, sizeof(cmtx_header_t), 1, output) != 1) {
+                ret = MAT_ERR_FPRINTF;
+            }
+            unsigned wave = 0;
+            while (wave < header.block_num && ret == MAT_ERR_NONE) {
+                unsigned wave_num = header.block_num - wave;
+                if (wave_num > thread_num) {
+                    wave_num = thread_num;
+                }
+                for (unsigned t = 0; t < wave_num; t++) {
+                    args[t].matrix = matrix;
+                    args[t].block_id = wave + t;
+                    args[t].buf = bufs + bytes_max * t;
+                    started[t] = (t > 0 && pthread_create(&(threads[t]), \
+                        NULL, cmtx_out_thread, (void*)&(args[t])) == 0);
+                }
+                // The calling thread takes the first block of the wave, and
+                //   any block whose thread failed to start
+                for (unsigned t = 0; t < wave_num; t++) {
+                    if (!started[t]) {
+                        cmtx_out_thread((void*)&(args[t]));
+                    }
+                }
+                for (unsigned t = 0; t < wave_num; t++) {
+                    if (started[t]) {
+                        pthread_join(threads[t], NULL);
+                    }
+                    index[wave+t].offset = offset;
+                    index[wave+t].bytes = args[t].bytes;
+                    offset += args[t].bytes;
+                    if (ret == MAT_ERR_NONE && fwrite(args[t].buf, 1, \
+                            args[t].bytes, output) != args[t].bytes) {
+                        ret = MAT_ERR_FPRINTF;
+                    }
+                }
+                wave += wave_num;
+            }
+            if (ret == MAT_ERR_NONE) {
+                trailer.index_offset = offset;
+                memcpy(trailer.magic, CMTX_MAGIC, CMTX_MAGIC_LEN);
+                if (fwrite(index, sizeof(cmtx_index_t), header.block_num, \
+                        output) != header.block_num || \
+                        fwrite(&trailer, sizeof(cmtx_trailer_t), 1, \
+                        output) != 1) {
+                    ret = MAT_ERR_FPRINTF;
+                }
+            }
+            if (fclose(output) != 0 && ret == MAT_ERR_NONE) {
+                ret = MAT_ERR_FPRINTF;
+            }
+        }
+    }
+    free(index);
+    free(args);
+    free(threads);
+    free(started);
+    free(bufs);
+    return ret;
+}
+
+/**
+ * Writes a rows x cols compressed file a block at a time, getting the rows of
+ *   each block from fill, on the calling thread. Only one block is ever held,
+ *   so the matrix can be any size.
+ */
+mat_err cmtx_stream_out(char *output_fname, unsigned rows, unsigned cols, \
+        cmtx_fill_fn fill, void *arg) {
+    cmtx_header_t header;
+    cmtx_trailer_t trailer;
+    cmtx_index_t *index;
+    double *block;
+    uint8_t *buf;
+    FILE *output;
+    mat_err ret = MAT_ERR_NONE;
+
+    memcpy(header.magic, CMTX_MAGIC, CMTX_MAGIC_LEN);
+    header.version = CMTX_VERSION;
+    header.rows = rows;
+    header.cols = cols;
+    header.block_rows = CMTX_BLOCK_ROWS;
+    header.block_num = (rows + CMTX_BLOCK_ROWS - 1) / CMTX_BLOCK_ROWS;
+    header.reserved = 0;
+
+    errno = 0;
+    index = malloc(sizeof(cmtx_index_t) * header.block_num);
+    block = malloc(sizeof(double) * CMTX_BLOCK_ROWS * cols);
+    buf = malloc(CMTX_BLOCK_BYTES_MAX(CMTX_BLOCK_ROWS, cols));
+    if (index == NULL || block == NULL || buf == NULL) {
+        ret = MAT_ERR_MALLOC;
+    }
+    else {
+        output = fopen(output_fname, "w+");
+        if (output == NULL) {
+            ret = MAT_ERR_FOPEN;
+        }
+        else {
+            uint64_t offset = sizeof(cmtx_header_t);
+            if (fwrite(&header, sizeof(cmtx_header_t), 1, output) != 1) {
+                ret = MAT_ERR_FPRINTF;
+            }
+            unsigned block_id = 0;
+            while (block_id < header.block_num && ret == MAT_ERR_NONE) {
+                unsigned row_start = block_id * CMTX_BLOCK_ROWS;
+                unsigned row_num = rows - row_start;
+                if (row_num > CMTX_BLOCK_ROWS) {
+                    row_num = CMTX_BLOCK_ROWS;
+                }
+                ret = fill(arg, block, row_start, row_num);
+                if (ret == MAT_ERR_NONE) {
+                    size_t bytes = cmtx_compress_block(block, cols, row_num, \
+                        cols, buf);
+                    index[block_id].offset = offset;
+                    index[block_id].bytes = bytes;
+                    offset += bytes;
+                    if (fwrite(buf, 1, bytes, output) != bytes) {
+                        ret = MAT_ERR_FPRINTF;
+                    }
+                }
+                block_id++;
+            }
+            if (ret == MAT_ERR_NONE) {
+                trailer.index_offset = offset;
+                memcpy(trailer.magic, CMTX_MAGIC, CMTX_MAGIC_LEN);
+                if (fwrite(index, sizeof(cmtx_index_t), header.block_num, \
+                        output) != header.block_num || \
+                        fwrite(&trailer, sizeof(cmtx_trailer_t), 1, \
+                        output) != 1) {
+                    ret = MAT_ERR_FPRINTF;
+                }
+            }
+            if (fclose(output) != 0 && ret == MAT_ERR_NONE) {
+                ret = MAT_ERR_FPRINTF;
+            }
+        }
+    }
+    free(index);
+    free(block);
+    free(buf);
+    return ret;
+}
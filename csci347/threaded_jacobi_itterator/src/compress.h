@@ -0,0 +1,86 @@
+#ifndef __COMPRESS_H
+#define __COMPRESS_H
+#include "matrix.h"
+#include <stdint.h>
+
+// Compressed matrix files
+// A lossless format for solution files. Values are predicted from their
+//   already coded neighbours (left + above - above left), the prediction is
+//   XORed with the actual bits, and only the bits between the leading and
+//   trailing zeros of the XOR are stored. Smooth solutions agree with their
+//   prediction in the sign, exponent and top of the mantissa, so most of each
+//   value packs away.
+// Rows are coded in independent blocks of CMTX_BLOCK_ROWS, so blocks compress
+//   and decompress on separate threads, and a reader can go straight to the
+//   rows it wants.
+// Layout, all in host byte order:
+//   cmtx_header_t
+//   the blocks, back to back
+//   cmtx_index_t for each block
+//   cmtx_trailer_t
+// The index is at the end so a file can be written in one pass.
+
+#define CMTX_MAGIC "JCMTX001"
+#define CMTX_MAGIC_LEN 8
+#define CMTX_VERSION 1
+#define CMTX_BLOCK_ROWS 64
+// Worst case bits for a value: a flag, 6 bits of leading zeros, 6 of length,
+//   and all 64 bits of the XOR.
+#define CMTX_VALUE_BITS_MAX 77
+#define CMTX_BLOCK_BYTES_MAX(rows, cols) \
+    (((size_t)(rows) * (cols) * CMTX_VALUE_BITS_MAX + 7) / 8 + 8)
+
+typedef struct cmtx_header cmtx_header_t;
+struct cmtx_header {
+    char magic[CMTX_MAGIC_LEN];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t block_rows;
+    uint32_t block_num;
+    uint32_t reserved;
+};
+
+typedef struct cmtx_index cmtx_index_t;
+struct cmtx_index {
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+typedef struct cmtx_trailer cmtx_trailer_t;
+struct cmtx_trailer {
+    uint64_t index_offset;
+    char magic[CMTX_MAGIC_LEN];
+};
+
+// An open compressed file. Every thread reading a file opens its own, since
+//   the last decompressed block is cached in it.
+typedef struct cmtx_file cmtx_file_t;
+struct cmtx_file {
+    int fd;
+    cmtx_header_t header;
+    cmtx_index_t *index;
+    // Compressed bytes of a block, then the block decompressed
+    uint8_t *buf;
+    double *block;
+    unsigned block_cached;
+};
+
+// Fills row_num rows of a matrix being streamed out, from row_start on, into
+//   rows, each cols of the matrix long
+typedef mat_err (*cmtx_fill_fn)(void *arg, double *rows, unsigned row_start, \
+    unsigned row_num);
+
+// Compressed file operations
+bool cmtx_file_check(char *fname);
+mat_err cmtx_open(cmtx_file_t *cf, char *fname);
+mat_err cmtx_read_rows(cmtx_file_t *cf, double *rows, unsigned row_start, \
+    unsigned row_num);
+void cmtx_close(cmtx_file_t *cf);
+mat_err cmtx_file_in(double (*matrix)[MATRIX_STRIDE], char *input_fname);
+mat_err cmtx_file_out(double (*matrix)[MATRIX_STRIDE], char *output_fname);
+// Writes a file of any size without it being in memory, see cmtx_fill_fn.
+mat_err cmtx_stream_out(char *output_fname, unsigned rows, unsigned cols, \
+    cmtx_fill_fn fill, void *arg);
+
+#endif /* __COMPRESS_H */
@@ -1,34 +1,517 @@
+// Only statistics are reduced here, so their order of summation is free to
+//   change, which lets gcc vectorize the reductions.
+#pragma GCC optimize ("tree-vectorize", "finite-math-only", "no-signed-zeros", \
+    "no-trapping-math", "associative-math")
 #include <stdio.h>
 #include "matrix.h"
+#include "compress.h"
 #include <math.h>
+#include <float.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Rows compared at a time by a thread
+#define DIFF_CHUNK_ROWS 16
+// Histogram buckets. Bucket 0 counts exact matches, bucket i counts deltas in
+//   [10^(i-1+DIFF_HIST_MIN_EXP), 10^(i+DIFF_HIST_MIN_EXP)), and anything
+//   smaller or larger is clamped into the first or last decade.
+#define DIFF_HIST_MIN_EXP -12
+#define DIFF_HIST_BUCKETS 15
+
+// Options of a comparison
+typedef struct diff_opts diff_opts_t;
+// With residual, the one file is compared to a plain Jacobi sweep of itself
+struct diff_opts {
+    char *fname[2];
+    unsigned thread_num;
+    double tolerance;
+    bool histogram;
+    bool residual;
+};
+
+// Statistics of the deltas compared so far
+typedef struct diff_stats diff_stats_t;
+struct diff_stats {
+    double min;
+    double max;
+    double sum;
+    double sum_sq;
+    unsigned long count;
+    unsigned max_row;
+    unsigned max_col;
+    unsigned long hist[DIFF_HIST_BUCKETS];
+};
+
+// Work shared between the comparing threads
+typedef struct diff_shared diff_shared_t;
+struct diff_shared {
+    diff_opts_t *opts;
+    // Next chunk of rows to compare, taken atomically
+    unsigned next_row;
+    // Set once the tolerance is exceeded so every thread stops early
+    bool exceeded;
+};
+
+// A file being compared, either a text or a compressed matrix file
+typedef struct diff_src diff_src_t;
+struct diff_src {
+    FILE *f;
+    cmtx_file_t cf;
+    bool compressed;
+};
+
+// Per thread arguments and results
+typedef struct diff_arg diff_arg_t;
+struct diff_arg {
+    diff_shared_t *shared;
+    diff_stats_t stats;
+    mat_err err;
+    int err_no;
+};
+
+/**
+ * Resets stats to an empty comparison.
+ */
+void diff_stats_init(diff_stats_t *stats) {
+    memset(stats, 0, sizeof(diff_stats_t));
+    stats->min = DBL_MAX;
+}
+
+/**
+ * Merges the stats of another thread into stats.
+ */
+void diff_stats_merge(diff_stats_t *stats, diff_stats_t *other) {
+    if (other->min < stats->min) {
+        stats->min = other->min;
+    }
+    if (other->max > stats->max || stats->count == 0) {
+        stats->max = other->max;
+        stats->max_row = other->max_row;
+        stats->max_col = other->max_col;
+    }
+    stats->sum += other->sum;
+    stats->sum_sq += other->sum_sq;
+    stats->count += other->count;
+    for (int i = 0; i < DIFF_HIST_BUCKETS; i++) {
+        stats->hist[i] += other->hist[i];
+    }
+}
+
+/**
+ * Finds the histogram bucket of a delta.
+ */
+int diff_hist_bucket(double delta) {
+    int bucket = 0;
+    if (delta > 0.0) {
+        bucket = (int)floor(log10(delta)) - DIFF_HIST_MIN_EXP + 1;
+        if (bucket < 1) {
+            bucket = 1;
+        }
+        if (bucket > DIFF_HIST_BUCKETS-1) {
+            bucket = DIFF_HIST_BUCKETS-1;
+        }
+    }
+    return bucket;
+}
+
+/**
+ * Opens a file to compare. A compressed file has to be full size, like a text
+ *   file read by matrix_file_read_rows.
+ */
+mat_err diff_src_open(diff_src_t *src, char *fname) {
+    mat_err ret = MAT_ERR_NONE;
+
+    src->f = NULL;
+    src->compressed = cmtx_file_check(fname);
+    if (src->compressed) {
+        ret = cmtx_open(&(src->cf), fname);
+        if (ret == MAT_ERR_NONE && (src->cf.header.rows != MATRIX_ROWS || \
+                src->cf.header.cols != MATRIX_COLS)) {
+            cmtx_close(&(src->cf));
+            errno = EILSEQ;
+            ret = MAT_ERR_FSCANF;
+        }
+    }
+    else {
+        errno = 0;
+        src->f = fopen(fname, "r");
+        if (src->f == NULL) {
+            ret = MAT_ERR_FOPEN;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Reads a chunk of rows from a file being compared.
+ */
+mat_err diff_src_read_rows(diff_src_t *src, char *buf, double *rows, \
+        unsigned row_start, unsigned row_num) {
+    mat_err ret;
+    if (src->compressed) {
+        ret = cmtx_read_rows(&(src->cf), rows, row_start, row_num);
+    }
+    else {
+        ret = matrix_file_read_rows(src->f, buf, rows, row_start, row_num);
+    }
+    return ret;
+}
+
+/**
+ * Closes a file being compared.
+ */
+void diff_src_close(diff_src_t *src) {
+    if (src->compressed) {
+        cmtx_close(&(src->cf));
+    }
+    else {
+        fclose(src->f);
+    }
+}
+
+/**
+ * Compares one chunk of rows and folds it into stats. The deltas are
+ *   computed into their own array first, so every reduction over them is a
+ *   plain loop the compiler can vectorize.
+ * Returns true if a delta is over tolerance (when one is set).
+ */
+bool diff_chunk(double *rows_1, double *rows_2, double *delta, \
+        unsigned row_start, unsigned row_num, diff_opts_t *opts, \
+        diff_stats_t *stats) {
+    unsigned n = row_num * MATRIX_COLS;
+    double chunk_min = DBL_MAX, chunk_max = 0.0, sum = 0.0, sum_sq = 0.0;
+
+    for (unsigned i = 0; i < n; i++) {
+        delta[i] = fabs(rows_1[i] - rows_2[i]);
+    }
+    for (unsigned i = 0; i < n; i++) {
+        chunk_min = (delta[i] < chunk_min) ? delta[i] : chunk_min;
+        chunk_max = (delta[i] > chunk_max) ? delta[i] : chunk_max;
+        sum += delta[i];
+        sum_sq += delta[i] * delta[i];
+    }
+
+    if (chunk_min < stats->min) {
+        stats->min = chunk_min;
+    }
+    if (chunk_max > stats->max || stats->count == 0) {
+        unsigned i = 0;
+        while (delta[i] != chunk_max) {
+            i++;
+        }
+        stats->max = chunk_max;
+        stats->max_row = row_start + i / MATRIX_COLS;
+        stats->max_col = i % MATRIX_COLS;
+    }
+    stats->sum += sum;
+    stats->sum_sq += sum_sq;
+    stats->count += n;
+    if (opts->histogram) {
+        for (unsigned i = 0; i < n; i++) {
+            stats->hist[diff_hist_bucket(delta[i])]++;
+        }
+    }
+    return (opts->tolerance >= 0.0 && chunk_max > opts->tolerance);
+}
+
+/**
+ * Streams chunks of rows from both files and compares them, until there are no
+ *   chunks left or some thread finds a delta over tolerance. Each thread has
+ *   its own file handles, so they only share the chunk counter.
+ */
+void* diff_thread(void* arg) {
+    diff_arg_t *diff_arg = (diff_arg_t*)arg;
+    diff_shared_t *shared = diff_arg->shared;
+    diff_src_t src[2];
+    bool opened[2] = {false, false};
+    char *buf = NULL;
+    double *rows = NULL;
+
+    diff_stats_init(&(diff_arg->stats));
+
+    diff_arg->err = diff_src_open(&(src[0]), shared->opts->fname[0]);
+    opened[0] = (diff_arg->err == MAT_ERR_NONE);
+    if (opened[0]) {
+        diff_arg->err = diff_src_open(&(src[1]), shared->opts->fname[1]);
+        opened[1] = (diff_arg->err == MAT_ERR_NONE);
+    }
+    if (diff_arg->err == MAT_ERR_NONE) {
+        errno = 0;
+        buf = malloc((size_t)ROW_CHARS * DIFF_CHUNK_ROWS + 1);
+        rows = malloc(sizeof(double) * MATRIX_COLS * DIFF_CHUNK_ROWS * 3);
+        if (buf == NULL || rows == NULL) {
+            diff_arg->err = MAT_ERR_MALLOC;
+        }
+    }
+    if (diff_arg->err == MAT_ERR_NONE) {
+        double *rows_1 = rows;
+        double *rows_2 = rows + MATRIX_COLS * DIFF_CHUNK_ROWS;
+        double *delta = rows + MATRIX_COLS * DIFF_CHUNK_ROWS * 2;
+
+        unsigned row_start = __atomic_fetch_add(&(shared->next_row), \
+            DIFF_CHUNK_ROWS, __ATOMIC_RELAXED);
+        while (row_start < MATRIX_ROWS && diff_arg->err == MAT_ERR_NONE && \
+                !__atomic_load_n(&(shared->exceeded), __ATOMIC_RELAXED)) {
+            unsigned row_num = MATRIX_ROWS - row_start;
+            if (row_num > DIFF_CHUNK_ROWS) {
+                row_num = DIFF_CHUNK_ROWS;
+            }
+            diff_arg->err = diff_src_read_rows(&(src[0]), buf, rows_1, \
+                row_start, row_num);
+            if (diff_arg->err == MAT_ERR_NONE) {
+                diff_arg->err = diff_src_read_rows(&(src[1]), buf, rows_2, \
+                    row_start, row_num);
+            }
+            if (diff_arg->err == MAT_ERR_NONE) {
+                if (diff_chunk(rows_1, rows_2, delta, row_start, row_num, \
+                        shared->opts, &(diff_arg->stats))) {
+                    __atomic_store_n(&(shared->exceeded), true, \
+                        __ATOMIC_RELAXED);
+                }
+            }
+            row_start = __atomic_fetch_add(&(shared->next_row), \
+                DIFF_CHUNK_ROWS, __ATOMIC_RELAXED);
+        }
+    }
+    diff_arg->err_no = errno;
+
+    for (int i = 0; i < 2; i++) {
+        if (opened[i]) {
+            diff_src_close(&(src[i]));
+        }
+    }
+    free(buf);
+    free(rows);
+    pthread_exit(NULL);
+}
+
+/**
+ * Sweeps a chunk of rows of matrix once with the plain 5 point stencil into
+ *   swept, leaving the boundary as it is, and copies the rows as they were
+ *   into old.
+ */
+void diff_sweep_rows(double (*matrix)[MATRIX_STRIDE], double *old, \
+        double *swept, unsigned row_start, unsigned row_num) {
+    for (unsigned i = 0; i < row_num; i++) {
+        unsigned row = row_start + i;
+        double *out = swept + (size_t)MATRIX_COLS * i;
+        memcpy(old + (size_t)MATRIX_COLS * i, matrix[row], \
+            sizeof(double) * MATRIX_COLS);
+        memcpy(out, matrix[row], sizeof(double) * MATRIX_COLS);
+        if (row > 0 && row < MATRIX_ROWS-1) {
+            for (unsigned col = 1; col < MATRIX_COLS-1; col++) {
+                out[col] = 0.25 * (matrix[row-1][col] + matrix[row+1][col] + \
+                    matrix[row][col-1] + matrix[row][col+1]);
+            }
+        }
+    }
+}
+
+/**
+ * Compares a matrix file to one plain Jacobi sweep of itself, which is how far
+ *   a solve written to it was from converged. The matrix is read in whole and
+ *   compared a chunk of rows at a time on the calling thread. Sets exceeded
+ *   like diff_chunk, if a delta is over tolerance.
+ */
+mat_err diff_residual(diff_opts_t *opts, diff_stats_t *stats, \
+        bool *exceeded) {
+    double (*matrix)[MATRIX_STRIDE] = NULL;
+    double *rows = NULL;
+    mat_err ret;
+
+    ret = matrix_init(&matrix);
+    if (ret == MAT_ERR_NONE) {
+        ret = matrix_file_in(matrix, opts->fname[0]);
+    }
+    if (ret == MAT_ERR_NONE) {
+        errno = 0;
+        rows = malloc(sizeof(double) * MATRIX_COLS * DIFF_CHUNK_ROWS * 3);
+        if (rows == NULL) {
+            ret = MAT_ERR_MALLOC;
+        }
+    }
+    if (ret == MAT_ERR_NONE) {
+        double *old = rows;
+        double *swept = rows + MATRIX_COLS * DIFF_CHUNK_ROWS;
+        double *delta = rows + MATRIX_COLS * DIFF_CHUNK_ROWS * 2;
+
+        for (unsigned row_start = 0; row_start < MATRIX_ROWS && !*exceeded; \
+                row_start += DIFF_CHUNK_ROWS) {
+            unsigned row_num = MATRIX_ROWS - row_start;
+            if (row_num > DIFF_CHUNK_ROWS) {
+                row_num = DIFF_CHUNK_ROWS;
+            }
+            diff_sweep_rows(matrix, old, swept, row_start, row_num);
+            *exceeded = diff_chunk(old, swept, delta, row_start, row_num, \
+                opts, stats);
+        }
+    }
+    free(rows);
+    if (matrix != NULL) {
+        matrix_delete(&matrix);
+    }
+    return ret;
+}
+
+/**
+ * Compares the two files of opts on opts->thread_num threads, merging what
+ *   they found into stats. Returns 2 if any thread failed, 0 otherwise.
+ */
+int diff_files(diff_opts_t *opts, diff_shared_t *shared, diff_stats_t *stats) {
+    diff_arg_t *args;
+    pthread_t *threads;
+    int ret = 0;
+
+    shared->opts = opts;
+    shared->next_row = 0;
+
+    args = malloc(sizeof(diff_arg_t) * opts->thread_num);
+    threads = malloc(sizeof(pthread_t) * opts->thread_num);
+    assert(args != NULL && threads != NULL);
+
+    unsigned t = 0;
+    int err = 0;
+    while (t < opts->thread_num && err == 0) {
+        args[t].shared = shared;
+        err = pthread_create(&(threads[t]), NULL, diff_thread, \
+            (void*)&(args[t]));
+        if (err == 0) {
+            t++;
+        }
+    }
+    assert(t > 0);
+
+    for (unsigned i = 0; i < t; i++) {
+        pthread_join(threads[i], NULL);
+        if (args[i].err != MAT_ERR_NONE) {
+            errno = args[i].err_no;
+            ret = 2;
+        }
+        diff_stats_merge(stats, &(args[i].stats));
+    }
+
+    free(args);
+    free(threads);
+    return ret;
+}
 
 /**
- * Extremely simple utility to check if a solved matrix is valid. Prints in a
- *   form compatible with the test output.
- * Returns 0 on success, and another value if one of the (many) assertions
- *   fails.
+ * Parses the arguments: two file paths, or one and --residual, then
+ *   optionally --threads n, --tolerance t and --histogram. Returns -1 on
+ *   error.
+ */
+int diff_get_opts(int argc, char **argv, diff_opts_t *opts) {
+    int ret = 0;
+
+    opts->thread_num = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+    opts->tolerance = -1.0;
+    opts->histogram = false;
+    opts->residual = false;
+
+    if (argc < 3) {
+        ret = -1;
+    }
+    else {
+        opts->fname[0] = argv[1];
+        opts->fname[1] = argv[2];
+        if (strcmp(argv[2], "--residual") == 0) {
+            opts->fname[1] = NULL;
+            opts->residual = true;
+        }
+        int arg = 3;
+        while (arg < argc && ret == 0) {
+            if (strcmp(argv[arg], "--histogram") == 0) {
+                opts->histogram = true;
+                arg++;
+            }
+            else if (arg+1 >= argc) {
+                ret = -1;
+            }
+            else if (strcmp(argv[arg], "--threads") == 0) {
+                opts->thread_num = (unsigned)strtoul(argv[arg+1], NULL, 10);
+                arg += 2;
+            }
+            else if (strcmp(argv[arg], "--tolerance") == 0) {
+                opts->tolerance = strtod(argv[arg+1], NULL);
+                arg += 2;
+            }
+            else {
+                ret = -1;
+            }
+        }
+    }
+    if (opts->thread_num == 0) {
+        opts->thread_num = 1;
+    }
+    return ret;
+}
+
+/**
+ * Prints the histogram, one bucket per line: hist,low,high,count
+ */
+void diff_print_hist(diff_stats_t *stats) {
+    printf("\nhist,0,0,%lu", stats->hist[0]);
+    for (int i = 1; i < DIFF_HIST_BUCKETS; i++) {
+        printf("\nhist,1e%d,1e%d,%lu", i-1+DIFF_HIST_MIN_EXP, \
+            i+DIFF_HIST_MIN_EXP, stats->hist[i]);
+    }
+    printf("\n");
+}
+
+/**
+ * Utility to check if a solved matrix is valid. Both files are streamed in
+ *   chunks of rows on several threads, so neither is ever held in memory.
+ *   Prints in a form compatible with the test output:
+ *   min,max,mean,rms,row of max,col of max,
+ * With --residual one file is compared to a Jacobi sweep of itself instead.
+ * With --tolerance the comparison stops at the first chunk with a delta over
+ *   the tolerance, and the stats only cover what was compared until then.
+ * Returns 0 on success, 1 if the tolerance was exceeded, and 2 on errors.
  */
 int main(int argc, char **argv) {
-    double (*m1)[MATRIX_COLS];
-    double (*m2)[MATRIX_COLS];
-    assert(matrix_init(&m1) == MAT_ERR_NONE);
-    assert(matrix_init(&m2) == MAT_ERR_NONE);
-    assert(matrix_file_in(m1, argv[1]) == MAT_ERR_NONE);
-    assert(matrix_file_in(m2, argv[2]) == MAT_ERR_NONE);
+    diff_opts_t opts;
+    diff_shared_t shared;
+    diff_stats_t stats;
+    int ret = 0;
 
-    double delta, delta_max = 0.0, delta_min = 100.0;
-    for (int r = 0; r < MATRIX_ROWS; r++) {
-        for (int c = 0; c < MATRIX_COLS; c++) {
-            delta = fabs(m1[r][c] - m2[r][c]);
-            if (delta > delta_max) {
-                delta_max = delta;
+    if (diff_get_opts(argc, argv, &opts) < 0) {
+        printf("Usage: %s file1 file2|--residual (--threads n) "\
+            "(--tolerance t) (--histogram)\n", argv[0]);
+        ret = 2;
+    }
+    else {
+        diff_stats_init(&stats);
+        shared.exceeded = false;
+        if (opts.residual) {
+            if (diff_residual(&opts, &stats, &(shared.exceeded)) != \
+                    MAT_ERR_NONE) {
+                ret = 2;
+            }
+        }
+        else {
+            ret = diff_files(&opts, &shared, &stats);
+        }
+
+        if (ret != 0) {
+            printf("%s: mat_err: ", argv[0]);
+            perror(NULL);
+        }
+        else {
+            double mean = 0.0, rms = 0.0;
+            if (stats.count > 0) {
+                mean = stats.sum / stats.count;
+                rms = sqrt(stats.sum_sq / stats.count);
+            }
+            printf("%.10e,%.10e,%.10e,%.10e,%u,%u,", stats.min, stats.max, \
+                mean, rms, stats.max_row, stats.max_col);
+            if (opts.histogram) {
+                diff_print_hist(&stats);
             }
-            if (delta < delta_min) {
-                delta_min = delta;
+            if (shared.exceeded) {
+                ret = 1;
             }
         }
     }
-    printf("%.10e,%.10e,", delta_min, delta_max);
-    return 0;
-}
\ No newline at end of file
+    return ret;
+}
@@ -0,0 +1,198 @@
+#include "gen.h"
+#include "compress.h"
+
+const char * const gen_profiles[] = {"constant", "gradient", "random", \
+    "hotspot"};
+
+// A matrix being generated. Rows have to be filled in order, since the random
+//   profile draws a value for every boundary cell as it comes to it.
+typedef struct gen_state gen_state_t;
+struct gen_state {
+    const gen_opts_t *opts;
+    uint64_t rng;
+    // Cells around the boundary, and the position along it that each hot spot
+    //   starts at and their length
+    uint64_t perimeter;
+    uint64_t spots[GEN_HOTSPOTS];
+    uint64_t spot_len;
+};
+
+/**
+ * Next number of a splitmix64 generator.
+ */
+static inline uint64_t gen_next(uint64_t *rng) {
+    uint64_t z = (*rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Position of a boundary cell along the boundary, going clockwise from the
+ *   top left corner.
+ */
+static inline uint64_t gen_perimeter_pos(const gen_opts_t *opts, \
+        unsigned row, unsigned col) {
+    uint64_t width = opts->cols - 1;
+    uint64_t height = opts->rows - 1;
+    uint64_t pos;
+
+    if (row == 0) {
+        pos = col;
+    }
+    else if (col == opts->cols - 1) {
+        pos = width + row;
+    }
+    else if (row == opts->rows - 1) {
+        pos = width + height + (width - col);
+    }
+    else {
+        pos = 2 * width + height + (height - row);
+    }
+    return pos;
+}
+
+/**
+ * Value of a boundary cell under the profile.
+ */
+static inline double gen_boundary(gen_state_t *gs, unsigned row, \
+        unsigned col) {
+    const gen_opts_t *opts = gs->opts;
+    double value = 0.0;
+
+    switch (opts->profile) {
+    case GEN_CONSTANT:
+        value = 1.0;
+        break;
+    case GEN_GRADIENT:
+        value = 1.0 - (double)(row + col) / (opts->rows - 1 + opts->cols - 1);
+        break;
+    case GEN_RANDOM:
+        value = (gen_next(&(gs->rng)) >> 11) * 0x1.0p-53;
+        break;
+    case GEN_HOTSPOT: {
+        uint64_t pos = gen_perimeter_pos(opts, row, col);
+        for (unsigned i = 0; i < GEN_HOTSPOTS; i++) {
+            if ((pos + gs->perimeter - gs->spots[i]) % gs->perimeter < \
+                    gs->spot_len) {
+                value = 1.0;
+            }
+        }
+        break;
+    }
+    case GEN_TOTAL:
+        abort();
+        break;
+    default:
+        abort();
+    }
+    return value;
+}
+
+/**
+ * Fills the next row_num rows, see cmtx_fill_fn.
+ */
+static mat_err gen_fill(void *arg, double *rows, unsigned row_start, \
+        unsigned row_num) {
+    gen_state_t *gs = (gen_state_t*)arg;
+    unsigned cols = gs->opts->cols;
+
+    for (unsigned i = 0; i < row_num; i++) {
+        unsigned row = row_start + i;
+        double *dst = rows + (size_t)cols * i;
+        bool edge_row = (row == 0 || row == gs->opts->rows - 1);
+        for (unsigned col = 0; col < cols; col++) {
+            if (edge_row || col == 0 || col == cols - 1) {
+                dst[col] = gen_boundary(gs, row, col);
+            }
+            else {
+                dst[col] = 0.0;
+            }
+        }
+    }
+    return MAT_ERR_NONE;
+}
+
+/**
+ * Writes the matrix as text, a row at a time, in the format
+ *   matrix_text_file_out uses.
+ */
+static mat_err gen_text_out(gen_state_t *gs, char *output_fname) {
+    unsigned cols = gs->opts->cols;
+    FILE *output;
+    double *line;
+    mat_err ret = MAT_ERR_NONE;
+
+    errno = 0;
+    line = malloc(sizeof(double) * cols);
+    if (line == NULL) {
+        ret = MAT_ERR_MALLOC;
+    }
+    else {
+        output = fopen(output_fname, "w+");
+        if (output == NULL) {
+            ret = MAT_ERR_FOPEN;
+        }
+        else {
+            unsigned row = 0;
+            while (row < gs->opts->rows && ret == MAT_ERR_NONE) {
+                ret = gen_fill(gs, line, row, 1);
+                unsigned col = 0;
+                while (col < cols && ret == MAT_ERR_NONE) {
+                    errno = 0;
+                    if (fprintf(output, "%.10lf ", line[col]) < 0) {
+                        ret = MAT_ERR_FPRINTF;
+                    }
+                    col++;
+                }
+                if (ret == MAT_ERR_NONE && fprintf(output, "\n") < 0) {
+                    ret = MAT_ERR_FPRINTF;
+                }
+                row++;
+            }
+            if (fclose(output) != 0 && ret == MAT_ERR_NONE) {
+                ret = MAT_ERR_FPRINTF;
+            }
+        }
+    }
+    free(line);
+    return ret;
+}
+
+/**
+ * Seeds the generator, places the hot spots and writes the matrix in the
+ *   format asked for.
+ */
+mat_err gen_file_out(const gen_opts_t *opts, char *output_fname) {
+    gen_state_t gs;
+    mat_err ret = MAT_ERR_NONE;
+
+    assert(opts->rows >= 3 && opts->cols >= 3);
+    assert(opts->profile < GEN_TOTAL);
+    gs.opts = opts;
+    gs.rng = opts->seed;
+    gs.perimeter = 2 * ((uint64_t)opts->rows - 1 + opts->cols - 1);
+    gs.spot_len = gs.perimeter / GEN_HOTSPOT_SHARE;
+    if (gs.spot_len == 0) {
+        gs.spot_len = 1;
+    }
+    for (unsigned i = 0; i < GEN_HOTSPOTS; i++) {
+        gs.spots[i] = gen_next(&(gs.rng)) % gs.perimeter;
+    }
+
+    switch (opts->format) {
+    case MAT_FORMAT_TEXT:
+        ret = gen_text_out(&gs, output_fname);
+        break;
+    case MAT_FORMAT_COMPRESSED:
+        ret = cmtx_stream_out(output_fname, opts->rows, opts->cols, \
+            gen_fill, &gs);
+        break;
+    case MAT_FORMAT_TOTAL:
+        abort();
+        break;
+    default:
+        abort();
+    }
+    return ret;
+}
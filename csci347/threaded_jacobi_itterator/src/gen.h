@@ -0,0 +1,51 @@
+#ifndef __GEN_H
+#define __GEN_H
+#include "matrix.h"
+#include <stdint.h>
+
+// Synthetic input matrices
+// Writes inputs of any size, not just the size the solver is built for, a
+//   block of rows at a time so they never have to fit in memory. The interior
+//   starts at 0 and the boundary follows a profile:
+//   constant  every boundary cell is 1
+//   gradient  falls linearly from 1 at the top left corner to 0 at the bottom
+//             right one
+//   random    every boundary cell is uniform in [0, 1)
+//   hotspot   the boundary is 0 but for GEN_HOTSPOTS stretches of 1, each
+//             1/GEN_HOTSPOT_SHARE of the perimeter long, at random places
+// Everything random comes from a splitmix64 generator seeded with the seed and
+//   used in the same order every time, so a seed always gives the same file
+//   on any machine. Values stay in [0, 1], so every value of a text file takes
+//   exactly COL_CHARS characters, like the files the solver writes.
+// A text file can only be read by a build whose MATRIX_ROWS_FULL and
+//   MATRIX_COLS_FULL match its size, see matrix.h. A compressed file can be
+//   read by any build no bigger than it, which samples it down.
+
+#define GEN_HOTSPOTS 4
+#define GEN_HOTSPOT_SHARE 32
+
+typedef enum gen_profile_e gen_profile_e;
+enum gen_profile_e {
+    GEN_CONSTANT = 0,
+    GEN_GRADIENT = 1,
+    GEN_RANDOM   = 2,
+    GEN_HOTSPOT  = 3,
+    GEN_TOTAL    = 4
+};
+// Name of each profile
+extern const char * const gen_profiles[];
+
+typedef struct gen_opts gen_opts_t;
+struct gen_opts {
+    unsigned rows;
+    unsigned cols;
+    gen_profile_e profile;
+    uint64_t seed;
+    mat_format_e format;
+};
+
+// Writes the matrix opts describes to output_fname. rows and cols must be at
+//   least 3, for any interior at all.
+mat_err gen_file_out(const gen_opts_t *opts, char *output_fname);
+
+#endif /* __GEN_H */
@@ -0,0 +1,371 @@
+#define _GNU_SOURCE
+#include "incr.h"
+#include "mem_stats.h"
+
+// Edges of a tile, for the deltas of the cells along them
+typedef enum incr_edge_e incr_edge_e;
+enum incr_edge_e {
+    INCR_EDGE_TOP    = 0,
+    INCR_EDGE_BOTTOM = 1,
+    INCR_EDGE_LEFT   = 2,
+    INCR_EDGE_RIGHT  = 3,
+    INCR_EDGE_TOTAL  = 4
+};
+
+// State of a re-solve. Tiles are numbered row by row.
+typedef struct incr_region incr_region_t;
+struct incr_region {
+    // Where a sweep reads from and writes to. They only differ in the dirty
+    //   region.
+    double (*matrix)[MATRIX_STRIDE];
+    double (*scratch)[MATRIX_STRIDE];
+    // The matrix as the re-solve started, after the edits
+    double (*start)[MATRIX_STRIDE];
+    const jacobi_opts_t *opts;
+    bool dirty[INCR_TILES];
+    // The dirty tiles, in the order they became dirty
+    unsigned tiles[INCR_TILES];
+    unsigned tile_num;
+};
+
+/**
+ * Reads the edits file. Lines without all three fields are skipped.
+ */
+mat_err incr_edits_file_in(incr_edit_t **edits, unsigned *edit_num, \
+        char *edits_fname) {
+    char *line = NULL;
+    size_t line_len = 0;
+    unsigned capacity = 0;
+    mat_err ret = MAT_ERR_NONE;
+
+    *edits = NULL;
+    *edit_num = 0;
+    errno = 0;
+    FILE *f = fopen(edits_fname, "r");
+    if (f == NULL) {
+        ret = MAT_ERR_FOPEN;
+    }
+    else {
+        while (ret == MAT_ERR_NONE && getline(&line, &line_len, f) != -1) {
+            incr_edit_t edit;
+            if (sscanf(line, "%u %u %lf", &edit.row, &edit.col, \
+                    &edit.value) < 3) {
+                // Not an edit
+            }
+            else if (edit.row >= MATRIX_ROWS || edit.col >= MATRIX_COLS) {
+                errno = EINVAL;
+                ret = MAT_ERR_FSCANF;
+            }
+            else {
+                if (*edit_num == capacity) {
+                    capacity = (capacity > 0) ? capacity * 2 : 64;
+                    incr_edit_t *grown = realloc(*edits, \
+                        sizeof(incr_edit_t) * capacity);
+                    if (grown == NULL) {
+                        ret = MAT_ERR_MALLOC;
+                    }
+                    else {
+                        *edits = grown;
+                    }
+                }
+                if (ret == MAT_ERR_NONE) {
+                    (*edits)[*edit_num] = edit;
+                    (*edit_num)++;
+                }
+            }
+        }
+        free(line);
+        fclose(f);
+        if (ret != MAT_ERR_NONE) {
+            free(*edits);
+            *edits = NULL;
+            *edit_num = 0;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Marks a tile dirty, if it is on the grid and not dirty yet. Returns true if
+ *   it became dirty.
+ */
+bool incr_dirty(incr_region_t *region, int tile_row, int tile_col) {
+    bool ret = false;
+
+    if (tile_row >= 0 && tile_row < INCR_TILE_ROWS && tile_col >= 0 && \
+            tile_col < INCR_TILE_COLS) {
+        unsigned tile = (unsigned)tile_row * INCR_TILE_COLS + tile_col;
+        if (!region->dirty[tile]) {
+            region->dirty[tile] = true;
+            region->tiles[region->tile_num] = tile;
+            region->tile_num++;
+            ret = true;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Marks the tiles of every cell a stencil at row, col reads from dirty. The
+ *   stencils only read the 8 cells around the one they update, so those are
+ *   the cells whose updates an edit of row, col changes.
+ */
+void incr_dirty_around(incr_region_t *region, unsigned row, unsigned col) {
+    for (int r = (int)row-1; r <= (int)row+1; r++) {
+        for (int c = (int)col-1; c <= (int)col+1; c++) {
+            if (r >= 1 && r < MATRIX_ROWS-1 && c >= 1 && c < MATRIX_COLS-1) {
+                incr_dirty(region, (r-1) / INCR_TILE, (c-1) / INCR_TILE);
+            }
+        }
+    }
+}
+
+/**
+ * Rows and columns of a tile, [row_start, row_end) and [col_start, col_end).
+ */
+void incr_tile_bounds(unsigned tile, matrix_partition_t *bounds) {
+    bounds->row_start = 1 + (tile / INCR_TILE_COLS) * INCR_TILE;
+    bounds->row_end = bounds->row_start + INCR_TILE;
+    if (bounds->row_end > MATRIX_ROWS-1) {
+        bounds->row_end = MATRIX_ROWS-1;
+    }
+    bounds->col_start = 1 + (tile % INCR_TILE_COLS) * INCR_TILE;
+    bounds->col_end = bounds->col_start + INCR_TILE;
+    if (bounds->col_end > MATRIX_COLS-1) {
+        bounds->col_end = MATRIX_COLS-1;
+    }
+}
+
+/**
+ * Works out one row of a tile from matrix into scratch. Without a mask the
+ *   whole row is free, otherwise only the parts of the spans of the row that
+ *   fall in the tile are.
+ */
+double incr_row(incr_region_t *region, unsigned row, unsigned col_start, \
+        unsigned col_end) {
+    const double *rows[STENCIL_WINDOW] = {NULL};
+    const mask_t *mask = region->opts->mask;
+    stencil_row_f kernel = region->opts->stencil->row;
+    double delta_max = 0.0;
+
+    rows[STENCIL_ROW(1, 0)] = region->matrix[row-1];
+    rows[STENCIL_ROW(1, 1)] = region->matrix[row];
+    rows[STENCIL_ROW(1, 2)] = region->matrix[row+1];
+    if (mask == NULL) {
+        delta_max = kernel(rows, region->scratch[row], col_start, col_end, \
+            delta_max);
+    }
+    else {
+        for (unsigned s = mask->row_spans[row]; s < mask->row_spans[row+1]; \
+                s++) {
+            unsigned start = mask->spans[s].col_start;
+            unsigned end = mask->spans[s].col_end;
+            start = (start > col_start) ? start : col_start;
+            end = (end < col_end) ? end : col_end;
+            if (start < end) {
+                delta_max = kernel(rows, region->scratch[row], start, end, \
+                    delta_max);
+            }
+        }
+    }
+    return delta_max;
+}
+
+/**
+ * Sweeps every dirty tile from matrix into scratch and returns the max delta.
+ *   The tiles are swept a band of tile rows at a time, and every run of dirty
+ *   tiles next to each other in a row is worked out in one go, so the kernels
+ *   run over as long rows as they can.
+ */
+double incr_sweep(incr_region_t *region) {
+    double delta_max = 0.0;
+
+    for (unsigned tile_row = 0; tile_row < INCR_TILE_ROWS; tile_row++) {
+        const bool *dirty = &(region->dirty[tile_row * INCR_TILE_COLS]);
+        unsigned tile_col = 0;
+        while (tile_col < INCR_TILE_COLS) {
+            if (!dirty[tile_col]) {
+                tile_col++;
+            }
+            else {
+                matrix_partition_t first, last;
+                incr_tile_bounds(tile_row * INCR_TILE_COLS + tile_col, &first);
+                while (tile_col < INCR_TILE_COLS && dirty[tile_col]) {
+                    tile_col++;
+                }
+                incr_tile_bounds(tile_row * INCR_TILE_COLS + tile_col-1, &last);
+                for (unsigned row = first.row_start; row < first.row_end; \
+                        row++) {
+                    double row_delta = incr_row(region, row, first.col_start, \
+                        last.col_end);
+                    delta_max = (row_delta > delta_max) ? row_delta : \
+                        delta_max;
+                }
+            }
+        }
+    }
+    return delta_max;
+}
+
+/**
+ * Stores in edges how far the cells along each edge of a tile have moved
+ *   from where the re-solve started.
+ */
+void incr_tile_drift(incr_region_t *region, unsigned tile, \
+        double edges[INCR_EDGE_TOTAL]) {
+    matrix_partition_t b;
+    double (*matrix)[MATRIX_STRIDE] = region->matrix;
+    double (*start)[MATRIX_STRIDE] = region->start;
+
+    incr_tile_bounds(tile, &b);
+    for (unsigned e = 0; e < INCR_EDGE_TOTAL; e++) {
+        edges[e] = 0.0;
+    }
+    for (unsigned col = b.col_start; col < b.col_end; col++) {
+        double top = fabs(matrix[b.row_start][col] - start[b.row_start][col]);
+        double bottom = fabs(matrix[b.row_end-1][col] - \
+            start[b.row_end-1][col]);
+        edges[INCR_EDGE_TOP] = fmax(edges[INCR_EDGE_TOP], top);
+        edges[INCR_EDGE_BOTTOM] = fmax(edges[INCR_EDGE_BOTTOM], bottom);
+    }
+    for (unsigned row = b.row_start; row < b.row_end; row++) {
+        double left = fabs(matrix[row][b.col_start] - start[row][b.col_start]);
+        double right = fabs(matrix[row][b.col_end-1] - \
+            start[row][b.col_end-1]);
+        edges[INCR_EDGE_LEFT] = fmax(edges[INCR_EDGE_LEFT], left);
+        edges[INCR_EDGE_RIGHT] = fmax(edges[INCR_EDGE_RIGHT], right);
+    }
+}
+
+/**
+ * True if the tile at tile_row, tile_col is on the grid and still clean.
+ */
+bool incr_clean(incr_region_t *region, int tile_row, int tile_col) {
+    return tile_row >= 0 && tile_row < INCR_TILE_ROWS && tile_col >= 0 && \
+        tile_col < INCR_TILE_COLS && \
+        !region->dirty[tile_row * INCR_TILE_COLS + tile_col];
+}
+
+/**
+ * Dirties the clean tiles across the edges of a dirty tile whose cells have
+ *   moved more than epsilon. Returns true if any became dirty. The edges are
+ *   only looked at if there is a clean tile across one of them.
+ */
+bool incr_grow(incr_region_t *region, unsigned tile) {
+    int tile_row = (int)(tile / INCR_TILE_COLS);
+    int tile_col = (int)(tile % INCR_TILE_COLS);
+    int across[INCR_EDGE_TOTAL][2] = {{tile_row-1, tile_col}, \
+        {tile_row+1, tile_col}, {tile_row, tile_col-1}, {tile_row, tile_col+1}};
+    double edges[INCR_EDGE_TOTAL];
+    bool fringe = false;
+    bool ret = false;
+
+    for (unsigned e = 0; e < INCR_EDGE_TOTAL; e++) {
+        fringe |= incr_clean(region, across[e][0], across[e][1]);
+    }
+    if (fringe) {
+        incr_tile_drift(region, tile, edges);
+        for (unsigned e = 0; e < INCR_EDGE_TOTAL; e++) {
+            if (edges[e] > region->opts->epsilon) {
+                ret |= incr_dirty(region, across[e][0], across[e][1]);
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * Copies a tile of the latest sweep into matrix.
+ */
+void incr_copy_tile(incr_region_t *region, unsigned tile, \
+        double (*matrix)[MATRIX_STRIDE]) {
+    matrix_partition_t b;
+
+    incr_tile_bounds(tile, &b);
+    for (unsigned row = b.row_start; row < b.row_end; row++) {
+        memcpy(&(matrix[row][b.col_start]), \
+            &(region->matrix[row][b.col_start]), \
+            sizeof(double) * (b.col_end - b.col_start));
+    }
+}
+
+/**
+ * Applies the edits to matrix and dirties the tiles around them, then sweeps
+ *   the dirty region until it settles. matrix and a copy of it take turns
+ *   being read and written, like a full solve does. Cells outside the dirty
+ *   region are the same in both, and a tile that becomes dirty is swept every
+ *   time from then on, so the two never disagree anywhere but in the region.
+ *   The tiles a sweep dirties are first swept in the next one.
+ */
+jacobi_err incr_solve(double (*matrix)[MATRIX_STRIDE], \
+        const jacobi_opts_t *opts, const incr_edit_t *edits, unsigned edit_num, \
+        struct runtime_stats *rs, unsigned *dirty_tiles) {
+    struct timespec starttime_cpu_process, starttime_real;
+    struct timespec endtime_cpu_process, endtime_real;
+    incr_region_t *region;
+    double (*copy)[MATRIX_STRIDE];
+    jacobi_err ret = JACOBI_ERR_NONE;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &starttime_cpu_process);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &starttime_real);
+
+    errno = 0;
+    region = mem_calloc(MEM_SOLVER, 1, sizeof(incr_region_t));
+    if (region == NULL) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        region->matrix = matrix;
+        region->opts = opts;
+        for (unsigned i = 0; i < edit_num; i++) {
+            matrix[edits[i].row][edits[i].col] = edits[i].value;
+            incr_dirty_around(region, edits[i].row, edits[i].col);
+        }
+        if (matrix_init_value(&copy, matrix) != MAT_ERR_NONE) {
+            ret = JACOBI_ERR_MALLOC;
+        }
+        else if (matrix_init_value(&(region->start), matrix) != \
+                MAT_ERR_NONE) {
+            matrix_delete(&copy);
+            ret = JACOBI_ERR_MALLOC;
+        }
+        else {
+            unsigned iterations = 0;
+            double delta_max;
+            bool grown;
+            region->scratch = copy;
+            do {
+                unsigned swept = region->tile_num;
+                delta_max = incr_sweep(region);
+                double (*swap)[MATRIX_STRIDE] = region->matrix;
+                region->matrix = region->scratch;
+                region->scratch = swap;
+                grown = false;
+                for (unsigned i = 0; i < swept; i++) {
+                    grown |= incr_grow(region, region->tiles[i]);
+                }
+                iterations++;
+            } while (delta_max > opts->epsilon || grown);
+
+            clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endtime_cpu_process);
+            clock_gettime(CLOCK_MONOTONIC_RAW, &endtime_real);
+            rs->iterations = iterations;
+            timespec_diff(&endtime_cpu_process, &starttime_cpu_process, \
+                &(rs->runtime_cpu_process));
+            timespec_diff(&endtime_real, &starttime_real, &(rs->runtime_real));
+            rs->delta_max = delta_max;
+            rs->converged = true;
+            rs->iterations_left = 0.0;
+            if (region->matrix != matrix) {
+                for (unsigned i = 0; i < region->tile_num; i++) {
+                    incr_copy_tile(region, region->tiles[i], matrix);
+                }
+            }
+            *dirty_tiles = region->tile_num;
+            matrix_delete(&copy);
+            matrix_delete(&(region->start));
+        }
+        mem_free(MEM_SOLVER, region);
+    }
+    return ret;
+}
@@ -0,0 +1,51 @@
+#ifndef __INCR_H
+#define __INCR_H
+#include "jacobi.h"
+
+// Incremental re-solves
+// Re-solves a converged solution after a few fixed cells (the outer boundary,
+//   or cells the mask fixes) have been edited, without sweeping the whole
+//   grid. The grid is split into square tiles. Only the tiles around the edits
+//   start out dirty, and only dirty tiles are swept, reading the tiles around
+//   them as they were left. Once the cells on an edge of a dirty tile have
+//   moved more than epsilon from where they started, the tile across that
+//   edge becomes dirty too, so the dirty region grows tile by tile as far as
+//   the edits reach. It goes by how far the cells have moved in all, not in
+//   a sweep, as far from the edits the cells move by less than epsilon a
+//   sweep long before they have moved by much. The re-solve stops once a sweep
+//   changes no cell by more than epsilon and dirties no new tiles.
+// Tiles never become clean again, so the region only ever grows, and the
+//   result is what a full solve from the old solution would give to within
+//   epsilon. The re-solve runs on the calling thread.
+
+// Side of a tile, in cells
+#define INCR_TILE 32
+// Tiles over the free interior of the matrix
+#define INCR_TILE_ROWS ((MATRIX_ROWS-2 + INCR_TILE-1) / INCR_TILE)
+#define INCR_TILE_COLS ((MATRIX_COLS-2 + INCR_TILE-1) / INCR_TILE)
+#define INCR_TILES (INCR_TILE_ROWS * INCR_TILE_COLS)
+
+// A cell and the value it is edited to
+typedef struct incr_edit incr_edit_t;
+struct incr_edit {
+    unsigned row;
+    unsigned col;
+    double value;
+};
+
+// Reads a list of edits, one "row col value" a line. The list is allocated
+//   here and must be freed by the caller. Cells outside the matrix are an
+//   error, with errno set to EINVAL.
+mat_err incr_edits_file_in(incr_edit_t **edits, unsigned *edit_num, \
+    char *edits_fname);
+
+// Applies edit_num edits to matrix, a solution solved with opts, and
+//   re-solves it in place. Only the mask, stencil and epsilon of opts are
+//   used. Edits of free cells only change where the re-solve starts from.
+//   The iterations in rs are sweeps of the dirty region, and the number of
+//   tiles it grew to is stored in dirty_tiles.
+jacobi_err incr_solve(double (*matrix)[MATRIX_STRIDE], \
+    const jacobi_opts_t *opts, const incr_edit_t *edits, unsigned edit_num, \
+    struct runtime_stats *rs, unsigned *dirty_tiles);
+
+#endif /* __INCR_H */
@@ -0,0 +1,1856 @@
+#include "jacobi.h"
+#include "topology.h"
+#include "mem_stats.h"
+#include <stdbool.h>
+#include <math.h>
+#include <sched.h>
+#include <stdint.h>
+#include <ucontext.h>
+
+// Times a thread polls a neighbour's counter before yielding its CPU
+#define JACOBI_SPIN_MAX 1024
+// Time between checks of the async mode monitor
+#define JACOBI_MONITOR_NS 1000000L
+
+// Progress of a partition, alone on its cache line since other threads poll
+//   it while the partition is worked on. done is the iterations (or sweeps)
+//   finished. In async mode below is the number of sweeps in a row with a
+//   residual under epsilon, epoch the async_epoch that run of sweeps belongs
+//   to, and delta the residual of the last sweep.
+typedef struct jacobi_counter jacobi_counter_t;
+struct jacobi_counter {
+    unsigned done;
+    unsigned below;
+    unsigned epoch;
+    double delta;
+    char pad[MATRIX_ALIGN - 3 * sizeof(unsigned) - sizeof(double)];
+};
+
+typedef struct fiber_worker fiber_worker_t;
+
+// Subtask arguments
+typedef struct subtask_arg subtask_arg_t;
+struct subtask_arg {
+    jacobi_ctx_t *ctx;
+    matrix_partition_t *subtask_bounds;
+    unsigned subtask_id;
+    double delta_max;
+    // Time spent working and waiting, published to the stats if there are
+    //   any. round_start_ns is when the current round of work started.
+    uint64_t busy_ns;
+    uint64_t wait_ns;
+    uint64_t round_start_ns;
+    // Line buffers of the modes that work in place. Async mode uses one for
+    //   the row being worked out and two for copies of the rows around the
+    //   partition, in place mode two for the rows waiting to be written back.
+    double *line_rows;
+    // Rebalance mode. Time spent sweeping since the last rebalance.
+    uint64_t sweep_ns;
+    // Fiber mode. The fiber the subtask runs on, its stack, the worker that
+    //   runs it, and whether it has finished the round the worker is on.
+    ucontext_t fiber;
+    void *fiber_stack;
+    fiber_worker_t *worker;
+    bool round_done;
+};
+
+// A worker thread of fiber mode. Runs the fibers of subtasks [first, last)
+//   from sched, which they switch back to whenever they wait.
+struct fiber_worker {
+    jacobi_ctx_t *ctx;
+    unsigned worker_id;
+    unsigned first;
+    unsigned last;
+    ucontext_t sched;
+};
+
+// Everything about one solve. Shared by the controlling thread (whoever calls
+//   jacobi_step) and the subtask threads.
+struct jacobi_ctx {
+    jacobi_opts_t opts;
+
+    // In place mode has only the input matrix, which both point to
+    double (*matrix_a)[MATRIX_STRIDE];
+    double (*matrix_b)[MATRIX_STRIDE];
+    unsigned partition_num;
+
+    // thread_num+1 long, the controlling thread is last since it is used by
+    //   the semaphore heap barrier. thread_num is the subtasks, or the
+    //   workers in fiber mode.
+    pthread_t *threads;
+    unsigned thread_num;
+    subtask_arg_t *subtask_args;
+    matrix_partition_t *subtask_bounds;
+    bool threads_started;
+    // Fiber mode, if it applies to the solve, and its thread_num workers
+    bool fibers;
+    fiber_worker_t *workers;
+
+    // Where all subtask threads sync after doing an iteration
+    barrier_t subtask_done_barrier;
+    // Where the subtask threads wait for the controlling thread to start the
+    //   next iteration or decide their fate
+    barrier_t subtask_wait_barrier;
+    bool barriers_init;
+
+    // Neighbour sync mode. The neighbours of partition i are
+    //   neighbours[neighbour_start[i]] up to neighbours[neighbour_start[i+1]].
+    jacobi_counter_t *counters;
+    unsigned *neighbours;
+    unsigned *neighbour_start;
+    // Async mode. Set by the monitor to stop the sweeps.
+    bool async_stop;
+    // Async mode. Bumped by every sweep with a residual over epsilon.
+    unsigned async_epoch;
+    // Deadline of the solve in progress, if it has one, for the async monitor
+    const struct timespec *deadline;
+    // In place mode. Copies of the first and last row of every partition as
+    //   of the last iteration, in two sets so the next iteration's copies
+    //   can be made while the neighbours still read these. Picked by
+    //   read_a_write_b, like the matrices.
+    double *halo_rows;
+
+    // Keeps threads from executing before all threads are created (to make
+    //   errors in thread creation easier to handle).
+    sem_t creation_wait;
+    // Controls further iterations of jacobi algorithm
+    bool do_next_iteration;
+    // Controls which matrix is read from or written to. Shared since this must
+    //   be identical between threads.
+    bool read_a_write_b;
+
+    unsigned iterations;
+
+    // Chebyshev mode, if it applies to the solve. omega is the weight of the
+    //   next iteration, rho the estimate of the spectral radius (0 until the
+    //   first one), accel_k the iterations since the recurrence started and
+    //   accel_since those since the estimate was last checked. deltas holds
+    //   the max delta of the last iterations, by iteration.
+    bool accel;
+    double omega;
+    double rho;
+    unsigned accel_k;
+    unsigned accel_since;
+    double deltas[JACOBI_ACCEL_HISTORY];
+
+    // Active set mode, if it applies to the solve. Tiles are numbered row by
+    //   row. tile_deltas is the max delta of every tile the last time it was
+    //   swept, tile_quiet the iterations in a row it and the tiles around it
+    //   have been under the threshold, and tile_cells its free cells. The
+    //   first awake_num of awake_tiles are the tiles swept, in order.
+    //   verifying is set for the full iteration that confirms convergence.
+    bool active;
+    bool verifying;
+    double *tile_deltas;
+    unsigned *tile_quiet;
+    bool *tile_awake;
+    unsigned long *tile_cells;
+    unsigned *awake_tiles;
+    unsigned awake_num;
+    unsigned long awake_cells;
+    unsigned long all_cells;
+    // Cell updates done and those a full iteration would have done, so far
+    double swept_cells;
+    double total_cells;
+
+    // Rebalance mode, if it applies to the solve. rebalancing is set while
+    //   boundaries are being moved, between the enter and exit thresholds.
+    //   The imbalance of the first and the last interval measured, 0 until
+    //   one has been.
+    bool rebalance;
+    bool rebalancing;
+    unsigned rebalance_since;
+    double imbalance_before;
+    double imbalance_after;
+};
+
+/**
+ * Calcualtes difference between start and end times for a given run of jacobi
+ */
+void timespec_diff(struct timespec *end, struct timespec *start, \
+        struct timespec *diff) {
+    diff->tv_sec = end->tv_sec - start->tv_sec;
+    diff->tv_nsec = end->tv_nsec - start->tv_nsec;
+    if (diff->tv_nsec < 0) {
+        diff->tv_sec--;
+        diff->tv_nsec = 1000000000L + diff->tv_nsec;
+    }
+}
+
+/**
+ * Converts time to microseconds
+ */
+double conv_timespec_to_ms(struct timespec *tm) {
+    double msec = tm->tv_sec * 1000.0;
+    msec += tm->tv_nsec / 1000000.0;
+    return msec;
+}
+
+/**
+ * Moves a time ms milliseconds on
+ */
+void timespec_add_ms(struct timespec *tm, unsigned ms) {
+    tm->tv_sec += ms / 1000;
+    tm->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (tm->tv_nsec >= 1000000000L) {
+        tm->tv_sec++;
+        tm->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * True once CLOCK_MONOTONIC_RAW has reached deadline
+ */
+bool timespec_passed(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec \
+        && now.tv_nsec >= deadline->tv_nsec);
+}
+
+/**
+ * Calculates an iteration of jacobi's over the columns [col_start, col_end)
+ *   of a single row by handing the rows around it to the stencil's kernel.
+ *   Any omega but 1 takes the accelerated kernel, which needs write_matrix to
+ *   hold the iteration before the one in read_matrix.
+ * Returns the max delta of the row, or delta_max if that is larger.
+ */
+static inline double do_row_iteration(double (*read_matrix)[MATRIX_STRIDE], \
+        double (*write_matrix)[MATRIX_STRIDE], unsigned row, \
+        unsigned col_start, unsigned col_end, double delta_max, \
+        const stencil_t *stencil, double omega) {
+
+    const double *rows[STENCIL_WINDOW] = {NULL};
+    rows[STENCIL_ROW(1, 0)] = read_matrix[row-1];
+    rows[STENCIL_ROW(1, 1)] = read_matrix[row];
+    rows[STENCIL_ROW(1, 2)] = read_matrix[row+1];
+
+    if (omega != 1.0) {
+        return stencil->accel_row(rows, write_matrix[row], col_start, \
+            col_end, delta_max, omega);
+    }
+    return stencil->row(rows, write_matrix[row], col_start, col_end, \
+        delta_max);
+}
+
+/**
+ * Calculcates an iteration of jacobi's within the specified bounds.
+ * Returns the max delta of the iteration.
+ */
+double do_bounded_iteration(double (*read_matrix)[MATRIX_STRIDE], \
+        double (*write_matrix)[MATRIX_STRIDE], \
+        matrix_partition_t *subtask_bounds, const stencil_t *stencil, \
+        double omega) {
+
+    double delta_max = 0.0;
+
+    for (unsigned row = subtask_bounds->row_start; \
+            row < subtask_bounds->row_end; row++) {
+        delta_max = do_row_iteration(read_matrix, write_matrix, row, \
+            subtask_bounds->col_start, subtask_bounds->col_end, delta_max, \
+            stencil, omega);
+    }
+    return delta_max;
+}
+
+/**
+ * Calculcates an iteration of jacobi's over the free cells of mask within the
+ *   specified bounds. Spans are clipped to the bounds' columns, so this works
+ *   with any partitioning.
+ * Returns the max delta of the iteration.
+ */
+double do_masked_iteration(double (*read_matrix)[MATRIX_STRIDE], \
+        double (*write_matrix)[MATRIX_STRIDE], \
+        matrix_partition_t *subtask_bounds, mask_t *mask, \
+        const stencil_t *stencil, double omega) {
+
+    double delta_max = 0.0;
+
+    for (unsigned row = subtask_bounds->row_start; \
+            row < subtask_bounds->row_end; row++) {
+        for (unsigned span = mask->row_spans[row]; \
+                span < mask->row_spans[row+1]; span++) {
+            unsigned col_start = mask->spans[span].col_start;
+            unsigned col_end   = mask->spans[span].col_end;
+            if (col_start < subtask_bounds->col_start) {
+                col_start = subtask_bounds->col_start;
+            }
+            if (col_end > subtask_bounds->col_end) {
+                col_end = subtask_bounds->col_end;
+            }
+            if (col_start < col_end) {
+                delta_max = do_row_iteration(read_matrix, write_matrix, row, \
+                    col_start, col_end, delta_max, stencil, omega);
+            }
+        }
+    }
+    return delta_max;
+}
+
+/**
+ * The copy of a partition's first (edge 0) or last (edge 1) row in one of the
+ *   two sets of in place mode.
+ */
+static inline double *jacobi_halo_row(jacobi_ctx_t *ctx, bool set, \
+        unsigned partition, unsigned edge) {
+    return ctx->halo_rows + MATRIX_STRIDE * \
+        (((set ? 1 : 0) * ctx->partition_num + partition) * 2 + edge);
+}
+
+/**
+ * Works out the new values of one row of a row band into line, over the
+ *   free cells only if the run has a mask.
+ * Returns the max delta of the row, or delta_max if that is larger.
+ */
+static inline double do_line_iteration(jacobi_ctx_t *ctx, \
+        const double *const *rows, double *line, unsigned row, \
+        matrix_partition_t *bounds, double delta_max) {
+    mask_t *mask = ctx->opts.mask;
+
+    if (mask != NULL) {
+        for (unsigned span = mask->row_spans[row]; \
+                span < mask->row_spans[row+1]; span++) {
+            delta_max = ctx->opts.stencil->row(rows, line, \
+                mask->spans[span].col_start, mask->spans[span].col_end, \
+                delta_max);
+        }
+    }
+    else {
+        delta_max = ctx->opts.stencil->row(rows, line, bounds->col_start, \
+            bounds->col_end, delta_max);
+    }
+    return delta_max;
+}
+
+/**
+ * Writes back the cells of a row that do_line_iteration worked out.
+ */
+static inline void jacobi_line_write_back(jacobi_ctx_t *ctx, double *dst, \
+        const double *line, unsigned row, matrix_partition_t *bounds) {
+    mask_t *mask = ctx->opts.mask;
+
+    if (mask != NULL) {
+        for (unsigned span = mask->row_spans[row]; \
+                span < mask->row_spans[row+1]; span++) {
+            memcpy(&dst[mask->spans[span].col_start], \
+                &line[mask->spans[span].col_start], sizeof(double) * \
+                (mask->spans[span].col_end - mask->spans[span].col_start));
+        }
+    }
+    else {
+        memcpy(&dst[bounds->col_start], &line[bounds->col_start], \
+            sizeof(double) * (bounds->col_end - bounds->col_start));
+    }
+}
+
+/**
+ * Calculates an iteration of jacobi's over a row band in place. The new values
+ *   of a row go into a line buffer and are only written back once the row
+ *   below it has been worked out, so every row is read as it was before the
+ *   iteration, the same as with two matrices.
+ * The rows just outside the band belong to the bands next to it, which may
+ *   already be overwriting them, so they are read from the copies those bands
+ *   made at the end of the iteration before, in set. The band then leaves
+ *   copies of its own first and last rows in the other set.
+ * Returns the max delta of the iteration.
+ */
+double do_in_place_iteration(subtask_arg_t *subtask_args, bool set) {
+    jacobi_ctx_t *ctx = subtask_args->ctx;
+    matrix_partition_t *bounds = subtask_args->subtask_bounds;
+    unsigned id = subtask_args->subtask_id;
+    double (*matrix)[MATRIX_STRIDE] = ctx->matrix_a;
+    double *lines[2] = {subtask_args->line_rows, \
+        subtask_args->line_rows + MATRIX_STRIDE};
+    double delta_max = 0.0;
+
+    for (unsigned row = bounds->row_start; row < bounds->row_end; row++) {
+        const double *rows[STENCIL_WINDOW] = {NULL};
+        rows[STENCIL_ROW(1, 0)] = matrix[row-1];
+        rows[STENCIL_ROW(1, 1)] = matrix[row];
+        rows[STENCIL_ROW(1, 2)] = matrix[row+1];
+        if (row == bounds->row_start && id > 0) {
+            rows[STENCIL_ROW(1, 0)] = jacobi_halo_row(ctx, set, id-1, 1);
+        }
+        if (row == bounds->row_end-1 && id < ctx->partition_num-1) {
+            rows[STENCIL_ROW(1, 2)] = jacobi_halo_row(ctx, set, id+1, 0);
+        }
+
+        delta_max = do_line_iteration(ctx, rows, lines[row & 1], row, \
+            bounds, delta_max);
+        if (row > bounds->row_start) {
+            jacobi_line_write_back(ctx, matrix[row-1], lines[(row-1) & 1], \
+                row-1, bounds);
+        }
+    }
+    jacobi_line_write_back(ctx, matrix[bounds->row_end-1], \
+        lines[(bounds->row_end-1) & 1], bounds->row_end-1, bounds);
+
+    memcpy(jacobi_halo_row(ctx, !set, id, 0), matrix[bounds->row_start], \
+        sizeof(double) * MATRIX_COLS);
+    memcpy(jacobi_halo_row(ctx, !set, id, 1), matrix[bounds->row_end-1], \
+        sizeof(double) * MATRIX_COLS);
+    return delta_max;
+}
+
+/**
+ * Rows and columns of a tile of active set mode, [row_start, row_end) and
+ *   [col_start, col_end).
+ */
+static inline void jacobi_tile_bounds(unsigned tile, \
+        matrix_partition_t *bounds) {
+    bounds->row_start = 1 + (tile / JACOBI_TILE_COLS) * JACOBI_TILE;
+    bounds->row_end = bounds->row_start + JACOBI_TILE;
+    if (bounds->row_end > MATRIX_ROWS-1) {
+        bounds->row_end = MATRIX_ROWS-1;
+    }
+    bounds->col_start = 1 + (tile % JACOBI_TILE_COLS) * JACOBI_TILE;
+    bounds->col_end = bounds->col_start + JACOBI_TILE;
+    if (bounds->col_end > MATRIX_COLS-1) {
+        bounds->col_end = MATRIX_COLS-1;
+    }
+}
+
+/**
+ * Calculates an iteration of jacobi's over a subtask's share of the awake
+ *   tiles in active set mode, storing the max delta of every tile swept.
+ * Returns the max delta of the iteration.
+ */
+double do_active_iteration(subtask_arg_t *subtask_args, \
+        double (*read_matrix)[MATRIX_STRIDE], \
+        double (*write_matrix)[MATRIX_STRIDE]) {
+    jacobi_ctx_t *ctx = subtask_args->ctx;
+    unsigned id = subtask_args->subtask_id;
+    unsigned first = (unsigned)((unsigned long)ctx->awake_num * id / \
+        ctx->partition_num);
+    unsigned last = (unsigned)((unsigned long)ctx->awake_num * (id+1) / \
+        ctx->partition_num);
+    double delta_max = 0.0;
+
+    for (unsigned i = first; i < last; i++) {
+        unsigned tile = ctx->awake_tiles[i];
+        matrix_partition_t bounds;
+        double tile_delta;
+        jacobi_tile_bounds(tile, &bounds);
+        if (ctx->opts.mask != NULL) {
+            tile_delta = do_masked_iteration(read_matrix, write_matrix, \
+                &bounds, ctx->opts.mask, ctx->opts.stencil, 1.0);
+        }
+        else {
+            tile_delta = do_bounded_iteration(read_matrix, write_matrix, \
+                &bounds, ctx->opts.stencil, 1.0);
+        }
+        ctx->tile_deltas[tile] = tile_delta;
+        delta_max = (tile_delta > delta_max) ? tile_delta : delta_max;
+    }
+    return delta_max;
+}
+
+/**
+ * Calculates an iteration of jacobi's over a subtask's partition, only
+ *   touching the free cells if the run has a mask. Reads from whichever
+ *   matrix read_a_write_b says, or in place mode's copies of the rows around
+ *   the partition. Weights the iteration by the omega of the context.
+ */
+double do_subtask_iteration(subtask_arg_t *subtask_args, bool read_a_write_b) {
+    jacobi_ctx_t *ctx = subtask_args->ctx;
+    double (*read_matrix)[MATRIX_STRIDE];
+    double (*write_matrix)[MATRIX_STRIDE];
+
+    if (ctx->opts.in_place) {
+        return do_in_place_iteration(subtask_args, read_a_write_b);
+    }
+    if (read_a_write_b) {
+        read_matrix = ctx->matrix_a;
+        write_matrix = ctx->matrix_b;
+    }
+    else {
+        read_matrix = ctx->matrix_b;
+        write_matrix = ctx->matrix_a;
+    }
+
+    if (ctx->active) {
+        return do_active_iteration(subtask_args, read_matrix, write_matrix);
+    }
+    if (ctx->opts.mask != NULL) {
+        return do_masked_iteration(read_matrix, write_matrix, \
+            subtask_args->subtask_bounds, ctx->opts.mask, ctx->opts.stencil, \
+            ctx->omega);
+    }
+    else {
+        return do_bounded_iteration(read_matrix, write_matrix, \
+            subtask_args->subtask_bounds, ctx->opts.stencil, ctx->omega);
+    }
+}
+
+/**
+ * Fiber mode. Switches from a subtask's fiber back to its worker, which runs
+ *   its other fibers before coming back to this one.
+ */
+static inline void jacobi_fiber_yield(subtask_arg_t *subtask_args) {
+    swapcontext(&(subtask_args->fiber), &(subtask_args->worker->sched));
+}
+
+/**
+ * Does check_interval iterations over a subtask's partition, only syncing with
+ *   the neighbouring partitions. Before starting an iteration a partition
+ *   waits for every neighbour to have finished the iteration before, which
+ *   both makes the rows it reads current and means the neighbours are done
+ *   reading the rows it is about to overwrite. In fiber mode the wait gives
+ *   the worker to its other fibers instead of spinning.
+ * Stores the max delta of the last iteration.
+ */
+void do_neighbour_iterations(subtask_arg_t *subtask_args) {
+    jacobi_ctx_t *ctx = subtask_args->ctx;
+    unsigned id = subtask_args->subtask_id;
+    bool read_a_write_b = ctx->read_a_write_b;
+    unsigned done = ctx->counters[id].done;
+
+    for (unsigned i = 0; i < ctx->opts.check_interval; i++) {
+        for (unsigned n = ctx->neighbour_start[id]; \
+                n < ctx->neighbour_start[id+1]; n++) {
+            unsigned *neighbour_done = &(ctx->counters[ctx->neighbours[n]].done);
+            unsigned spins = 0;
+            uint64_t wait_start = 0;
+            // Counters wrap, so they are compared by their difference
+            while ((int)(__atomic_load_n(neighbour_done, __ATOMIC_ACQUIRE) - \
+                    done) < 0) {
+                if (spins == 0 && ctx->opts.stats != NULL) {
+                    wait_start = stats_now_ns();
+                }
+                spins++;
+                if (ctx->fibers) {
+                    jacobi_fiber_yield(subtask_args);
+                }
+                else if (spins > JACOBI_SPIN_MAX) {
+                    sched_yield();
+                }
+            }
+            if (wait_start != 0) {
+                subtask_args->wait_ns += stats_now_ns() - wait_start;
+            }
+        }
+        subtask_args->delta_max = do_subtask_iteration(subtask_args, \
+            read_a_write_b);
+        done++;
+        __atomic_store_n(&(ctx->counters[id].done), done, __ATOMIC_RELEASE);
+        read_a_write_b = !read_a_write_b;
+    }
+}
+
+/**
+ * Copies a row that another thread may be writing, without tearing values.
+ */
+static inline void jacobi_row_load(double *dst, const double *src) {
+    for (unsigned col = 0; col < MATRIX_COLS; col++) {
+        __atomic_load(&src[col], &dst[col], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Writes a row that another thread may be reading, without tearing values.
+ */
+static inline void jacobi_row_store(double *dst, const double *src) {
+    for (unsigned col = 0; col < MATRIX_COLS; col++) {
+        __atomic_store(&dst[col], (double*)&src[col], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Sweeps a subtask's row band in place until the monitor says stop, reading
+ *   whatever the neighbouring bands hold at the time. Each row is worked out
+ *   into a line buffer and then written back, so the rows below read the new
+ *   values of the rows above. Only the first and last rows of the band are
+ *   shared with other threads, so only they and the rows next to them are
+ *   accessed atomically.
+ * Publishes the residual of every sweep, and how many sweeps in a row have
+ *   been under epsilon everywhere along with the epoch they were counted in,
+ *   and stores the last residual. The count is published before the epoch,
+ *   so a monitor that reads the epoch first sees a count at least as new.
+ */
+void do_async_sweeps(subtask_arg_t *subtask_args) {
+    jacobi_ctx_t *ctx = subtask_args->ctx;
+    jacobi_counter_t *counter = &(ctx->counters[subtask_args->subtask_id]);
+    matrix_partition_t *bounds = subtask_args->subtask_bounds;
+    double (*matrix)[MATRIX_STRIDE] = jacobi_result(ctx);
+    double *line = subtask_args->line_rows;
+    double *above = line + MATRIX_STRIDE;
+    double *below = line + MATRIX_STRIDE * 2;
+    double delta_max = 0.0;
+    unsigned below_num = 0;
+    unsigned epoch = __atomic_load_n(&(ctx->async_epoch), __ATOMIC_RELAXED);
+
+    while (!__atomic_load_n(&(ctx->async_stop), __ATOMIC_ACQUIRE)) {
+        delta_max = 0.0;
+        for (unsigned row = bounds->row_start; row < bounds->row_end; row++) {
+            const double *rows[STENCIL_WINDOW] = {NULL};
+            bool shared = (row == bounds->row_start || \
+                row == bounds->row_end-1);
+            rows[STENCIL_ROW(1, 0)] = matrix[row-1];
+            rows[STENCIL_ROW(1, 1)] = matrix[row];
+            rows[STENCIL_ROW(1, 2)] = matrix[row+1];
+            if (row == bounds->row_start) {
+                jacobi_row_load(above, matrix[row-1]);
+                rows[STENCIL_ROW(1, 0)] = above;
+            }
+            if (row == bounds->row_end-1) {
+                jacobi_row_load(below, matrix[row+1]);
+                rows[STENCIL_ROW(1, 2)] = below;
+            }
+
+            memcpy(line, matrix[row], sizeof(double) * MATRIX_COLS);
+            if (ctx->opts.mask != NULL) {
+                for (unsigned span = ctx->opts.mask->row_spans[row]; \
+                        span < ctx->opts.mask->row_spans[row+1]; span++) {
+                    delta_max = ctx->opts.stencil->row(rows, line, \
+                        ctx->opts.mask->spans[span].col_start, \
+                        ctx->opts.mask->spans[span].col_end, delta_max);
+                }
+            }
+            else {
+                delta_max = ctx->opts.stencil->row(rows, line, \
+                    bounds->col_start, bounds->col_end, delta_max);
+            }
+
+            if (shared) {
+                jacobi_row_store(matrix[row], line);
+            }
+            else {
+                memcpy(matrix[row], line, sizeof(double) * MATRIX_COLS);
+            }
+        }
+
+        // A band can settle against stale neighbours, so a run of sweeps
+        //   under epsilon only counts while no other band is over it either.
+        if (delta_max > ctx->opts.epsilon) {
+            epoch = __atomic_add_fetch(&(ctx->async_epoch), 1, \
+                __ATOMIC_RELAXED);
+            below_num = 0;
+        }
+        else if (__atomic_load_n(&(ctx->async_epoch), __ATOMIC_RELAXED) != \
+                epoch) {
+            epoch = __atomic_load_n(&(ctx->async_epoch), __ATOMIC_RELAXED);
+            below_num = 0;
+        }
+        else {
+            below_num++;
+        }
+        __atomic_store(&(counter->delta), &delta_max, __ATOMIC_RELAXED);
+        __atomic_store_n(&(counter->below), below_num, __ATOMIC_RELAXED);
+        __atomic_store_n(&(counter->epoch), epoch, __ATOMIC_RELEASE);
+        __atomic_store_n(&(counter->done), counter->done + 1, \
+            __ATOMIC_RELAXED);
+        if (ctx->opts.stats != NULL) {
+            stats_thread_publish(ctx->opts.stats, subtask_args->subtask_id, \
+                counter->done, subtask_args->busy_ns + stats_now_ns() - \
+                subtask_args->round_start_ns, subtask_args->wait_ns, delta_max);
+        }
+        // A settled band only changes again once its neighbours do, so give
+        //   them the CPU in case threads outnumber cores
+        if (below_num >= ctx->opts.check_interval) {
+            sched_yield();
+        }
+    }
+    subtask_args->delta_max = delta_max;
+}
+
+/**
+ * Starts timing a round of work of a subtask for the stats. The time since the
+ *   last round ended was spent waiting on the wait barrier.
+ */
+static inline void jacobi_round_start(subtask_arg_t *subtask_args, \
+        uint64_t wait_start) {
+    subtask_args->round_start_ns = stats_now_ns();
+    subtask_args->wait_ns += subtask_args->round_start_ns - wait_start;
+}
+
+/**
+ * Ends a round of work of a subtask, which finished its work at work_end and
+ *   then waited on the done barrier. Any waiting on neighbours during the
+ *   round has already been added to the wait time.
+ * Publishes the iterations the subtask has done and the delta of the last.
+ */
+static inline void jacobi_round_end(subtask_arg_t *subtask_args, \
+        uint64_t wait_before, uint64_t work_end, unsigned iterations) {
+    subtask_args->busy_ns += work_end - subtask_args->round_start_ns - \
+        (subtask_args->wait_ns - wait_before);
+    subtask_args->wait_ns += stats_now_ns() - work_end;
+    stats_thread_publish(subtask_args->ctx->opts.stats, \
+        subtask_args->subtask_id, iterations, subtask_args->busy_ns, \
+        subtask_args->wait_ns, subtask_args->delta_max);
+}
+
+/**
+ * Does a subtask's work for one jacobi_step of the controlling thread: an
+ *   iteration, a round of check_interval of them in neighbour sync mode, or
+ *   sweeps until the monitor stops them in async mode.
+ * Returns the iterations the subtask has done after the round, given those
+ *   it had done before it.
+ */
+static inline unsigned jacobi_subtask_round(subtask_arg_t *subtask_args, \
+        unsigned iterations) {
+    jacobi_ctx_t *ctx = subtask_args->ctx;
+
+    if (ctx->opts.sync == JACOBI_SYNC_NEIGHBOUR) {
+        do_neighbour_iterations(subtask_args);
+        iterations += ctx->opts.check_interval;
+    }
+    else if (ctx->opts.sync == JACOBI_SYNC_ASYNC) {
+        do_async_sweeps(subtask_args);
+        iterations = ctx->counters[subtask_args->subtask_id].done;
+    }
+    else if (ctx->rebalance) {
+        uint64_t sweep_start = stats_now_ns();
+        subtask_args->delta_max = do_subtask_iteration(subtask_args, \
+            ctx->read_a_write_b);
+        subtask_args->sweep_ns += stats_now_ns() - sweep_start;
+        iterations++;
+    }
+    else {
+        subtask_args->delta_max = do_subtask_iteration(subtask_args, \
+            ctx->read_a_write_b);
+        iterations++;
+    }
+    return iterations;
+}
+
+/**
+ * Does iterations of jacobi over some bounds given in arg, one for each
+ *   jacobi_step of the controlling thread (or a round of check_interval of
+ *   them in neighbour sync mode).
+ * creation_wait provides a way to kill threads if one of them fails to create.
+ *   Once passed, it waits for the controlling thread to start each iteration.
+ * Exit condition is do_next_iteration being set false.
+ * With the hierarchical barrier every thread is pinned to the CPU of its slot,
+ *   so it really is in the cache domain the barrier thinks it is in. Pinning
+ *   is only a hint, so failing to pin is not an error.
+ * With stats, each round is timed and published once the done barrier has
+ *   been passed. Nothing is timed without them.
+ */
+void* jacobi_iteration_subtask(void* arg) {
+    subtask_arg_t *subtask_args = (subtask_arg_t*)arg;
+    jacobi_ctx_t *ctx = subtask_args->ctx;
+    bool stats = (ctx->opts.stats != NULL);
+    uint64_t wait_start = 0, wait_before = 0, work_end = 0;
+    unsigned iterations = 0;
+
+    sem_wait(&(ctx->creation_wait));
+    if (ctx->opts.barrier_id == HIER_BARRIER) {
+        topology_pin(subtask_args->subtask_id);
+    }
+
+    bool run = ctx->do_next_iteration;
+    while (run) {
+        if (stats) {
+            wait_start = stats_now_ns();
+        }
+        barrier_wait(&(ctx->subtask_wait_barrier), pthread_self());
+        run = ctx->do_next_iteration;
+        if (run) {
+            if (stats) {
+                jacobi_round_start(subtask_args, wait_start);
+                wait_before = subtask_args->wait_ns;
+            }
+            iterations = jacobi_subtask_round(subtask_args, iterations);
+            if (stats) {
+                work_end = stats_now_ns();
+            }
+            barrier_wait(&(ctx->subtask_done_barrier), pthread_self());
+            if (stats) {
+                jacobi_round_end(subtask_args, wait_before, work_end, \
+                    iterations);
+            }
+        }
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Fiber mode. The fiber of a subtask, whose subtask_arg_t is split into two
+ *   halves since makecontext only passes ints. Does a round of work every
+ *   time its worker switches to it for a new round, then marks the round done
+ *   and switches back. The fiber never returns: once the solve is over it is
+ *   left suspended and its stack freed.
+ * With stats, a round is timed from when the fiber picks it up, and the time
+ *   since it last finished one counts as waiting.
+ */
+static void jacobi_fiber_main(unsigned arg_high, unsigned arg_low) {
+    subtask_arg_t *subtask_args = (subtask_arg_t*)(((uintptr_t)arg_high << \
+        16 << 16) | arg_low);
+    bool stats = (subtask_args->ctx->opts.stats != NULL);
+    uint64_t wait_start = 0, wait_before = 0, work_end = 0;
+    unsigned iterations = 0;
+
+    if (stats) {
+        wait_start = stats_now_ns();
+    }
+    while (true) {
+        if (stats) {
+            jacobi_round_start(subtask_args, wait_start);
+            wait_before = subtask_args->wait_ns;
+        }
+        iterations = jacobi_subtask_round(subtask_args, iterations);
+        if (stats) {
+            work_end = stats_now_ns();
+            jacobi_round_end(subtask_args, wait_before, work_end, iterations);
+            wait_start = work_end;
+        }
+        subtask_args->round_done = true;
+        jacobi_fiber_yield(subtask_args);
+    }
+}
+
+/**
+ * Fiber mode. A worker thread, pinned to the CPU of its slot. For every
+ *   jacobi_step it switches to each of its fibers in turn, over and over,
+ *   until they have all done their round, then waits on the done barrier
+ *   with the other workers. A fiber waiting on a neighbour switches back
+ *   early, so the worker gets on with the others meanwhile.
+ * creation_wait and do_next_iteration work the same as for subtask threads.
+ */
+void* jacobi_fiber_worker(void* arg) {
+    fiber_worker_t *worker = (fiber_worker_t*)arg;
+    jacobi_ctx_t *ctx = worker->ctx;
+
+    sem_wait(&(ctx->creation_wait));
+    topology_pin(worker->worker_id);
+
+    bool run = ctx->do_next_iteration;
+    while (run) {
+        barrier_wait(&(ctx->subtask_wait_barrier), pthread_self());
+        run = ctx->do_next_iteration;
+        if (run) {
+            unsigned left = worker->last - worker->first;
+            for (unsigned i = worker->first; i < worker->last; i++) {
+                ctx->subtask_args[i].round_done = false;
+            }
+            while (left > 0) {
+                for (unsigned i = worker->first; i < worker->last; i++) {
+                    subtask_arg_t *subtask_args = &(ctx->subtask_args[i]);
+                    if (!subtask_args->round_done) {
+                        swapcontext(&(worker->sched), &(subtask_args->fiber));
+                        if (subtask_args->round_done) {
+                            left--;
+                        }
+                    }
+                }
+            }
+            barrier_wait(&(ctx->subtask_done_barrier), pthread_self());
+        }
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Creates the subtask threads, or in fiber mode the workers.
+ * creation_wait exists as a safeguard against a pthread failing to
+ *   create. If one fails, do_next_iteration is set to false and creation_wait
+ *   is released for all the threads that succeeded, killing them. Otherwise at
+ *   the end it is released for all threads.
+ * At the end, the calling thread id is put into threads since it is used by
+ *   the semaphore heap barrier.
+ */
+jacobi_err jacobi_iteration_start_subtasks(jacobi_ctx_t *ctx) {
+    int err = 0;
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned thread_num = ctx->thread_num;
+
+    ctx->do_next_iteration = true;
+    sem_init(&(ctx->creation_wait), 0, 0);
+    unsigned t = 0;
+    while (t < thread_num && err == 0) {
+        if (ctx->fibers) {
+            err = pthread_create(&(ctx->threads[t]), NULL, \
+                jacobi_fiber_worker, (void*)&(ctx->workers[t]));
+        }
+        else {
+            err = pthread_create(&(ctx->threads[t]), NULL, \
+                jacobi_iteration_subtask, (void*)&(ctx->subtask_args[t]));
+        }
+        if (err > 0) {
+            ctx->do_next_iteration = false;
+            for (int j = 0; j < t; j++) {
+                sem_post(&(ctx->creation_wait));
+            }
+            for (int j = 0; j < t; j++) {
+                pthread_join(ctx->threads[j], NULL);
+            }
+
+            sem_destroy(&(ctx->creation_wait));
+
+            errno = err;
+            ret = JACOBI_ERR_PTHREAD_CREATE;
+        }
+        else {
+            t++;
+        }
+    }
+
+    ctx->threads[t] = pthread_self();
+
+    if (t == thread_num) {
+        for (int j = 0; j < thread_num; j++) {
+            sem_post(&(ctx->creation_wait));
+        }
+        ctx->threads_started = true;
+    }
+
+    return ret;
+}
+
+/**
+ * True if the solve iterates between the caller's buffers, see
+ *   jacobi_opts_t.
+ */
+bool jacobi_own_buffers(jacobi_ctx_t *ctx) {
+    return ctx->opts.buffers[0] != NULL && ctx->opts.buffers[1] != NULL;
+}
+
+/**
+ * Frees whatever has been allocated for ctx so far. ctx is zeroed on
+ *   creation so this works for partially created contexts too.
+ */
+void jacobi_ctx_free(jacobi_ctx_t *ctx) {
+    if (ctx->barriers_init) {
+        barrier_delete(&(ctx->subtask_done_barrier));
+        barrier_delete(&(ctx->subtask_wait_barrier));
+    }
+    if (ctx->matrix_a != NULL && !ctx->opts.in_place && \
+            !jacobi_own_buffers(ctx)) {
+        matrix_delete(&(ctx->matrix_a));
+    }
+    if (ctx->matrix_b != NULL && !ctx->opts.in_place && \
+            !jacobi_own_buffers(ctx)) {
+        matrix_delete(&(ctx->matrix_b));
+    }
+    mem_free(MEM_SOLVER, ctx->threads);
+    if (ctx->subtask_args != NULL) {
+        for (unsigned i = 0; i < ctx->partition_num; i++) {
+            mem_free(MEM_SOLVER, ctx->subtask_args[i].line_rows);
+            mem_free(MEM_SOLVER, ctx->subtask_args[i].fiber_stack);
+        }
+    }
+    mem_free(MEM_SOLVER, ctx->subtask_args);
+    mem_free(MEM_SOLVER, ctx->subtask_bounds);
+    if (ctx->counters != NULL) {
+        free(ctx->counters);
+        mem_count_free(MEM_SOLVER, sizeof(jacobi_counter_t) * \
+            ctx->opts.subtask_num);
+    }
+    mem_free(MEM_SOLVER, ctx->neighbours);
+    mem_free(MEM_SOLVER, ctx->neighbour_start);
+    mem_free(MEM_SOLVER, ctx->halo_rows);
+    mem_free(MEM_SOLVER, ctx->tile_deltas);
+    mem_free(MEM_SOLVER, ctx->tile_quiet);
+    mem_free(MEM_SOLVER, ctx->tile_awake);
+    mem_free(MEM_SOLVER, ctx->tile_cells);
+    mem_free(MEM_SOLVER, ctx->awake_tiles);
+    mem_free(MEM_SOLVER, ctx->workers);
+    mem_free(MEM_SOLVER, ctx);
+}
+
+/**
+ * True if partitions a and b touch, corners included, so that a stencil
+ *   reaching one cell out from one of them reads the other.
+ */
+bool jacobi_partitions_touch(matrix_partition_t *a, matrix_partition_t *b) {
+    return a->row_start <= b->row_end && b->row_start <= a->row_end && \
+        a->col_start <= b->col_end && b->col_start <= a->col_end;
+}
+
+/**
+ * Allocates the progress counters of the partitions, for the modes that
+ *   don't keep the threads in step with barriers.
+ */
+jacobi_err jacobi_counters_init(jacobi_ctx_t *ctx) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned subtask_num = ctx->opts.subtask_num;
+
+    errno = 0;
+    int err = posix_memalign((void**)&(ctx->counters), MATRIX_ALIGN, \
+        sizeof(jacobi_counter_t) * subtask_num);
+    if (err > 0) {
+        errno = err;
+        ctx->counters = NULL;
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        memset(ctx->counters, 0, sizeof(jacobi_counter_t) * subtask_num);
+        mem_count_alloc(MEM_SOLVER, sizeof(jacobi_counter_t) * subtask_num);
+    }
+    return ret;
+}
+
+/**
+ * Gives every partition its line buffers, for the modes that work in place.
+ */
+jacobi_err jacobi_line_rows_init(jacobi_ctx_t *ctx) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+
+    errno = 0;
+    for (unsigned i = 0; i < ctx->partition_num; i++) {
+        ctx->subtask_args[i].line_rows = mem_alloc(MEM_SOLVER, \
+            sizeof(double) * MATRIX_STRIDE * 3);
+        if (ctx->subtask_args[i].line_rows == NULL) {
+            ret = JACOBI_ERR_MALLOC;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Allocates in place mode's copies of the partitions' first and last rows,
+ *   and fills the set the first iteration reads from the input.
+ */
+jacobi_err jacobi_halo_init(jacobi_ctx_t *ctx) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+
+    errno = 0;
+    ctx->halo_rows = mem_alloc(MEM_SOLVER, sizeof(double) * MATRIX_STRIDE * \
+        4 * ctx->partition_num);
+    if (ctx->halo_rows == NULL) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        for (unsigned i = 0; i < ctx->partition_num; i++) {
+            memcpy(jacobi_halo_row(ctx, ctx->read_a_write_b, i, 0), \
+                ctx->matrix_a[ctx->subtask_bounds[i].row_start], \
+                sizeof(double) * MATRIX_COLS);
+            memcpy(jacobi_halo_row(ctx, ctx->read_a_write_b, i, 1), \
+                ctx->matrix_a[ctx->subtask_bounds[i].row_end-1], \
+                sizeof(double) * MATRIX_COLS);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Fiber mode. Makes a worker per CPU, up to one per subtask, hands each a
+ *   contiguous block of subtasks, and gives every subtask its fiber.
+ */
+jacobi_err jacobi_fibers_init(jacobi_ctx_t *ctx) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned subtask_num = ctx->opts.subtask_num;
+    const topology_t *topo = topology_get();
+    unsigned worker_num = (topo != NULL) ? topo->cpu_num : \
+        (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (worker_num == 0 || worker_num > subtask_num) {
+        worker_num = subtask_num;
+    }
+    errno = 0;
+    ctx->workers = mem_calloc(MEM_SOLVER, worker_num, sizeof(fiber_worker_t));
+    if (ctx->workers == NULL) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        ctx->thread_num = worker_num;
+        for (unsigned w = 0; w < worker_num; w++) {
+            fiber_worker_t *worker = &(ctx->workers[w]);
+            worker->ctx = ctx;
+            worker->worker_id = w;
+            worker->first = (unsigned)((unsigned long)subtask_num * w / \
+                worker_num);
+            worker->last = (unsigned)((unsigned long)subtask_num * (w+1) / \
+                worker_num);
+            for (unsigned i = worker->first; i < worker->last && \
+                    ret == JACOBI_ERR_NONE; i++) {
+                subtask_arg_t *subtask_args = &(ctx->subtask_args[i]);
+                uintptr_t arg = (uintptr_t)subtask_args;
+                subtask_args->worker = worker;
+                subtask_args->fiber_stack = mem_alloc(MEM_SOLVER, \
+                    JACOBI_FIBER_STACK);
+                if (subtask_args->fiber_stack == NULL || \
+                        getcontext(&(subtask_args->fiber)) < 0) {
+                    ret = JACOBI_ERR_MALLOC;
+                }
+                else {
+                    subtask_args->fiber.uc_stack.ss_sp = \
+                        subtask_args->fiber_stack;
+                    subtask_args->fiber.uc_stack.ss_size = JACOBI_FIBER_STACK;
+                    subtask_args->fiber.uc_link = NULL;
+                    makecontext(&(subtask_args->fiber), \
+                        (void (*)(void))jacobi_fiber_main, 2, \
+                        (unsigned)(arg >> 16 >> 16), (unsigned)arg);
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * Lists the awake tiles of active set mode in order, and counts their cells.
+ */
+void jacobi_awake_list(jacobi_ctx_t *ctx) {
+    ctx->awake_num = 0;
+    ctx->awake_cells = 0;
+    for (unsigned tile = 0; tile < JACOBI_TILES; tile++) {
+        if (ctx->tile_awake[tile]) {
+            ctx->awake_tiles[ctx->awake_num] = tile;
+            ctx->awake_num++;
+            ctx->awake_cells += ctx->tile_cells[tile];
+        }
+    }
+}
+
+/**
+ * Allocates the tiles of active set mode, all awake, and counts the free
+ *   cells of each.
+ */
+jacobi_err jacobi_active_init(jacobi_ctx_t *ctx) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+    mask_t *mask = ctx->opts.mask;
+
+    errno = 0;
+    ctx->tile_deltas = mem_calloc(MEM_SOLVER, JACOBI_TILES, sizeof(double));
+    ctx->tile_quiet = mem_calloc(MEM_SOLVER, JACOBI_TILES, sizeof(unsigned));
+    ctx->tile_awake = mem_alloc(MEM_SOLVER, sizeof(bool) * JACOBI_TILES);
+    ctx->tile_cells = mem_calloc(MEM_SOLVER, \
+        JACOBI_TILES, sizeof(unsigned long));
+    ctx->awake_tiles = mem_alloc(MEM_SOLVER, sizeof(unsigned) * JACOBI_TILES);
+    if (ctx->tile_deltas == NULL || ctx->tile_quiet == NULL || \
+            ctx->tile_awake == NULL || ctx->tile_cells == NULL || \
+            ctx->awake_tiles == NULL) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        ctx->all_cells = 0;
+        for (unsigned tile = 0; tile < JACOBI_TILES; tile++) {
+            matrix_partition_t b;
+            jacobi_tile_bounds(tile, &b);
+            for (unsigned row = b.row_start; row < b.row_end; row++) {
+                if (mask == NULL) {
+                    ctx->tile_cells[tile] += b.col_end - b.col_start;
+                }
+                else {
+                    for (unsigned span = mask->row_spans[row]; \
+                            span < mask->row_spans[row+1]; span++) {
+                        unsigned start = mask->spans[span].col_start;
+                        unsigned end = mask->spans[span].col_end;
+                        start = (start > b.col_start) ? start : b.col_start;
+                        end = (end < b.col_end) ? end : b.col_end;
+                        ctx->tile_cells[tile] += (start < end) ? end - start : 0;
+                    }
+                }
+            }
+            ctx->tile_awake[tile] = true;
+            ctx->all_cells += ctx->tile_cells[tile];
+        }
+        jacobi_awake_list(ctx);
+    }
+    return ret;
+}
+
+/**
+ * Finds the neighbours of every partition for neighbour sync mode. Like the
+ *   mask spans, the first pass counts them so they can be allocated in one go
+ *   and the second pass fills them in.
+ */
+jacobi_err jacobi_neighbours_init(jacobi_ctx_t *ctx) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned subtask_num = ctx->opts.subtask_num;
+    matrix_partition_t *bounds = ctx->subtask_bounds;
+
+    unsigned neighbour_num = 0;
+    for (unsigned i = 0; i < subtask_num; i++) {
+        for (unsigned j = 0; j < subtask_num; j++) {
+            if (i != j && jacobi_partitions_touch(&bounds[i], &bounds[j])) {
+                neighbour_num++;
+            }
+        }
+    }
+
+    errno = 0;
+    ctx->neighbours = mem_alloc(MEM_SOLVER, sizeof(unsigned) * \
+        (neighbour_num > 0 ? neighbour_num : 1));
+    ctx->neighbour_start = mem_alloc(MEM_SOLVER, \
+        sizeof(unsigned) * (subtask_num+1));
+    if (ctx->neighbours == NULL || ctx->neighbour_start == NULL) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        unsigned n = 0;
+        for (unsigned i = 0; i < subtask_num; i++) {
+            ctx->neighbour_start[i] = n;
+            for (unsigned j = 0; j < subtask_num; j++) {
+                if (i != j && jacobi_partitions_touch(&bounds[i], &bounds[j])) {
+                    ctx->neighbours[n++] = j;
+                }
+            }
+        }
+        ctx->neighbour_start[subtask_num] = n;
+    }
+    return ret;
+}
+
+/**
+ * All the alocation for running the algorithm. A serial solve (subtask_num of
+ *   0) still gets one partition covering the whole matrix. Async and in place
+ *   modes always partition by rows.
+ */
+jacobi_err jacobi_ctx_mem_init(jacobi_ctx_t *ctx, \
+        double (*input_matrix)[MATRIX_STRIDE]) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned partition_num = (ctx->opts.subtask_num > 0) ? \
+        ctx->opts.subtask_num : 1;
+
+    ctx->partition_num = partition_num;
+    ctx->thread_num = ctx->opts.subtask_num;
+    if (ctx->opts.in_place) {
+        ctx->matrix_a = input_matrix;
+        ctx->matrix_b = input_matrix;
+    }
+    else if (jacobi_own_buffers(ctx)) {
+        ctx->matrix_a = ctx->opts.buffers[0];
+        ctx->matrix_b = ctx->opts.buffers[1];
+        memcpy(ctx->matrix_a, input_matrix, MATRIX_BYTES);
+        memcpy(ctx->matrix_b, input_matrix, MATRIX_BYTES);
+    }
+    else if (matrix_init_value(&(ctx->matrix_a), input_matrix) != \
+            MAT_ERR_NONE || \
+            matrix_init_value(&(ctx->matrix_b), input_matrix) != \
+            MAT_ERR_NONE) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+
+    if (ret == JACOBI_ERR_NONE) {
+        errno = 0;
+        ctx->threads = mem_alloc(MEM_SOLVER, \
+            sizeof(pthread_t) * (ctx->opts.subtask_num+1));
+        ctx->subtask_args = mem_calloc(MEM_SOLVER, \
+            partition_num, sizeof(subtask_arg_t));
+        ctx->subtask_bounds = mem_alloc(MEM_SOLVER, \
+            sizeof(matrix_partition_t) * partition_num);
+        if (ctx->threads == NULL || ctx->subtask_args == NULL || \
+                ctx->subtask_bounds == NULL) {
+            ret = JACOBI_ERR_MALLOC;
+        }
+        else {
+            if (ctx->opts.mask != NULL) {
+                mask_partitions(ctx->subtask_bounds, partition_num, \
+                    ctx->opts.mask);
+            }
+            else if (ctx->opts.subtask_num > 0 && !ctx->opts.in_place && \
+                    ctx->opts.sync != JACOBI_SYNC_ASYNC && !ctx->rebalance) {
+                matrix_partitions(ctx->subtask_bounds, partition_num);
+            }
+            else {
+                matrix_row_partitions(ctx->subtask_bounds, partition_num);
+            }
+            for (unsigned i = 0; i < partition_num; i++) {
+                ctx->subtask_args[i].ctx = ctx;
+                ctx->subtask_args[i].subtask_bounds = &(ctx->subtask_bounds[i]);
+                ctx->subtask_args[i].subtask_id = i;
+                ctx->subtask_args[i].delta_max = 0.0;
+            }
+            if (ctx->opts.sync != JACOBI_SYNC_BARRIER && \
+                    ctx->opts.subtask_num > 0) {
+                ret = jacobi_counters_init(ctx);
+                if (ret == JACOBI_ERR_NONE && \
+                        ctx->opts.sync == JACOBI_SYNC_NEIGHBOUR) {
+                    ret = jacobi_neighbours_init(ctx);
+                }
+            }
+            // Async mode sweeps in place already, so only needs the buffers
+            bool async = (ctx->opts.sync == JACOBI_SYNC_ASYNC && \
+                ctx->opts.subtask_num > 0);
+            if (ret == JACOBI_ERR_NONE && (async || ctx->opts.in_place)) {
+                ret = jacobi_line_rows_init(ctx);
+            }
+            if (ret == JACOBI_ERR_NONE && ctx->opts.in_place && !async) {
+                ret = jacobi_halo_init(ctx);
+            }
+            if (ret == JACOBI_ERR_NONE && ctx->active) {
+                ret = jacobi_active_init(ctx);
+            }
+            if (ret == JACOBI_ERR_NONE && ctx->fibers) {
+                ret = jacobi_fibers_init(ctx);
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * Fills opts with the defaults.
+ */
+void jacobi_opts_default(jacobi_opts_t *opts) {
+    opts->barrier_id = SEM_HEAP_BARRIER;
+    opts->subtask_num = 0;
+    opts->mask = NULL;
+    opts->stencil = stencil_get(STENCIL_2D_5PT);
+    opts->epsilon = JACOBI_EPSILON;
+    opts->sync = JACOBI_SYNC_BARRIER;
+    opts->check_interval = JACOBI_CHECK_INTERVAL;
+    opts->in_place = false;
+    opts->stats = NULL;
+    opts->accel = JACOBI_ACCEL_NONE;
+    opts->active = false;
+    opts->deadline_ms = 0;
+    opts->fibers = false;
+    opts->rebalance = false;
+    opts->buffers[0] = NULL;
+    opts->buffers[1] = NULL;
+}
+
+/**
+ * Creates a solver context. Allocates everything, initializes the barriers and
+ *   starts the subtask threads, which then wait for the first jacobi_step.
+ */
+jacobi_err jacobi_create(jacobi_ctx_t **ctx, const jacobi_opts_t *opts, \
+        double (*input_matrix)[MATRIX_STRIDE]) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+
+    assert(ctx != NULL);
+    assert(opts != NULL);
+    assert(input_matrix != NULL);
+    assert(opts->sync < JACOBI_SYNC_TOTAL);
+    assert(opts->check_interval > 0);
+    assert(opts->accel < JACOBI_ACCEL_TOTAL);
+
+    errno = 0;
+    *ctx = mem_calloc(MEM_SOLVER, 1, sizeof(jacobi_ctx_t));
+    if (*ctx == NULL) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        (*ctx)->opts = *opts;
+        (*ctx)->read_a_write_b = true;
+        (*ctx)->omega = 1.0;
+        (*ctx)->accel = (opts->accel == JACOBI_ACCEL_CHEBYSHEV && \
+            !opts->in_place && (opts->subtask_num == 0 || \
+            opts->sync == JACOBI_SYNC_BARRIER));
+        (*ctx)->active = (opts->active && !(*ctx)->accel && \
+            !opts->in_place && (opts->subtask_num == 0 || \
+            opts->sync == JACOBI_SYNC_BARRIER));
+        (*ctx)->fibers = (opts->fibers && opts->subtask_num > 0 && \
+            opts->sync != JACOBI_SYNC_ASYNC);
+        (*ctx)->rebalance = (opts->rebalance && opts->subtask_num > 1 && \
+            opts->sync == JACOBI_SYNC_BARRIER && opts->mask == NULL && \
+            !opts->in_place && !(*ctx)->active);
+
+        ret = jacobi_ctx_mem_init(*ctx, input_matrix);
+        if (ret == JACOBI_ERR_NONE && opts->subtask_num > 0) {
+            if (barrier_init(&((*ctx)->subtask_done_barrier), \
+                    opts->barrier_id, (*ctx)->thread_num + 1, \
+                    &((*ctx)->threads)) < 0) {
+                ret = JACOBI_ERR_BARRIER_INIT;
+            }
+            else if (barrier_init(&((*ctx)->subtask_wait_barrier), \
+                    opts->barrier_id, (*ctx)->thread_num + 1, \
+                    &((*ctx)->threads)) < 0) {
+                barrier_delete(&((*ctx)->subtask_done_barrier));
+                ret = JACOBI_ERR_BARRIER_INIT;
+            }
+            else {
+                (*ctx)->barriers_init = true;
+                ret = jacobi_iteration_start_subtasks(*ctx);
+            }
+        }
+        if (ret != JACOBI_ERR_NONE) {
+            jacobi_ctx_free(*ctx);
+            *ctx = NULL;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Starts a round of async sweeps, then watches the residuals the threads
+ *   publish and stops them once every thread has been under epsilon for
+ *   check_interval sweeps in a row, or the deadline of the solve passes.
+ *   A count only stands if it was made in the current epoch: a thread that
+ *   hasn't run since another band went over epsilon still shows the count
+ *   it had before, so it is checked against the epoch it published, and the
+ *   epoch is checked again once every thread has been looked at.
+ * Returns the sweeps done, averaged over the threads.
+ */
+unsigned jacobi_async_monitor(jacobi_ctx_t *ctx) {
+    struct timespec wait = {0, JACOBI_MONITOR_NS};
+    unsigned subtask_num = ctx->opts.subtask_num;
+    unsigned long start_sweeps = 0, sweeps = 0;
+    bool settled = false;
+
+    ctx->async_stop = false;
+    for (unsigned i = 0; i < subtask_num; i++) {
+        ctx->counters[i].below = 0;
+        start_sweeps += ctx->counters[i].done;
+    }
+    barrier_wait(&(ctx->subtask_wait_barrier), pthread_self());
+
+    while (!settled && (ctx->deadline == NULL || \
+            !timespec_passed(ctx->deadline))) {
+        unsigned epoch;
+        nanosleep(&wait, NULL);
+        epoch = __atomic_load_n(&(ctx->async_epoch), __ATOMIC_RELAXED);
+        settled = true;
+        for (unsigned i = 0; i < subtask_num && settled; i++) {
+            settled = (__atomic_load_n(&(ctx->counters[i].epoch), \
+                __ATOMIC_ACQUIRE) == epoch && \
+                __atomic_load_n(&(ctx->counters[i].below), \
+                __ATOMIC_RELAXED) >= ctx->opts.check_interval);
+        }
+        settled = settled && \
+            __atomic_load_n(&(ctx->async_epoch), __ATOMIC_RELAXED) == epoch;
+    }
+    __atomic_store_n(&(ctx->async_stop), true, __ATOMIC_RELEASE);
+    barrier_wait(&(ctx->subtask_done_barrier), pthread_self());
+
+    for (unsigned i = 0; i < subtask_num; i++) {
+        sweeps += ctx->counters[i].done;
+    }
+    return (unsigned)((sweeps - start_sweeps) / subtask_num);
+}
+
+/**
+ * Chebyshev mode. Records the max delta of the iteration just done and works
+ *   out the omega of the next one.
+ * rho is first estimated once the warm up iterations are done, as the rate
+ *   the deltas shrank at over the last few. Every cycle after that, the rate
+ *   over the last half cycle is compared to the one the recurrence should
+ *   give for rho. A slower rate means rho is too low, so it is raised to the
+ *   rho that rate points to, and the recurrence starts over from plain
+ *   Jacobi. rho never goes down, since the deltas of a restarted recurrence
+ *   can shrink fast for a while before the slowest error takes over.
+ */
+void jacobi_accel_update(jacobi_ctx_t *ctx, double delta_max) {
+    unsigned iterations = ctx->iterations;
+    double rho = ctx->rho;
+
+    ctx->deltas[iterations % JACOBI_ACCEL_HISTORY] = delta_max;
+    if (rho == 0.0) {
+        if (iterations == JACOBI_ACCEL_WARMUP) {
+            rho = pow(delta_max / ctx->deltas[(iterations - \
+                JACOBI_ACCEL_SPAN) % JACOBI_ACCEL_HISTORY], \
+                1.0 / JACOBI_ACCEL_SPAN);
+            // Also catches a rate that isn't a number, from zero deltas
+            if (!(rho < JACOBI_ACCEL_RHO_MAX)) {
+                rho = JACOBI_ACCEL_RHO_MAX;
+            }
+            ctx->accel_k = 0;
+            ctx->accel_since = 0;
+        }
+    }
+    else {
+        ctx->accel_k++;
+        ctx->accel_since++;
+        if (ctx->accel_since == JACOBI_ACCEL_CYCLE) {
+            ctx->accel_since = 0;
+            double rate = pow(delta_max / ctx->deltas[(iterations - \
+                JACOBI_ACCEL_CYCLE/2) % JACOBI_ACCEL_HISTORY], \
+                1.0 / (JACOBI_ACCEL_CYCLE/2));
+            // The recurrence shrinks the error by 1/sigma every iteration
+            double sigma = 1.0 / rho + sqrt(1.0 / (rho * rho) - 1.0);
+            double z = rate * sigma;
+            if (z > 1.0) {
+                double raised = rho * (z + 1.0 / z) / 2.0;
+                if (raised > JACOBI_ACCEL_RHO_MAX) {
+                    raised = JACOBI_ACCEL_RHO_MAX;
+                }
+                if (raised > rho) {
+                    rho = raised;
+                    ctx->accel_k = 0;
+                }
+            }
+        }
+    }
+    ctx->rho = rho;
+
+    if (rho == 0.0 || ctx->accel_k == 0) {
+        ctx->omega = 1.0;
+    }
+    else if (ctx->accel_k == 1) {
+        ctx->omega = 1.0 / (1.0 - rho * rho / 2.0);
+    }
+    else {
+        ctx->omega = 1.0 / (1.0 - rho * rho * ctx->omega / 4.0);
+    }
+}
+
+/**
+ * Puts tiles of active set mode to sleep and wakes them after an iteration,
+ *   going by the deltas of the tiles in it, and lists the tiles the next
+ *   iteration sweeps. A tile is loud if it was swept and its delta was at
+ *   least the threshold. Tiles next to a loud one (or loud themselves) are
+ *   woken or stay awake, any other awake tile has had one more quiet
+ *   iteration and falls asleep after enough of them. A tile falling asleep
+ *   is copied from the matrix just written to the other one, so both hold
+ *   its latest values for as long as it sleeps.
+ * wake_all wakes every tile instead of letting any fall asleep.
+ */
+void jacobi_active_update(jacobi_ctx_t *ctx, bool wake_all) {
+    double threshold = JACOBI_ACTIVE_FRACTION * ctx->opts.epsilon;
+    double (*written)[MATRIX_STRIDE] = ctx->read_a_write_b ? \
+        ctx->matrix_b : ctx->matrix_a;
+    double (*other)[MATRIX_STRIDE] = ctx->read_a_write_b ? \
+        ctx->matrix_a : ctx->matrix_b;
+    bool loud[JACOBI_TILES];
+
+    for (unsigned tile = 0; tile < JACOBI_TILES; tile++) {
+        loud[tile] = ctx->tile_awake[tile] && \
+            ctx->tile_deltas[tile] >= threshold;
+    }
+    for (int tile_row = 0; tile_row < JACOBI_TILE_ROWS; tile_row++) {
+        for (int tile_col = 0; tile_col < JACOBI_TILE_COLS; tile_col++) {
+            unsigned tile = tile_row * JACOBI_TILE_COLS + tile_col;
+            bool near_loud = false;
+            for (int r = tile_row-1; r <= tile_row+1; r++) {
+                for (int c = tile_col-1; c <= tile_col+1; c++) {
+                    if (r >= 0 && r < JACOBI_TILE_ROWS && c >= 0 && \
+                            c < JACOBI_TILE_COLS) {
+                        near_loud |= loud[r * JACOBI_TILE_COLS + c];
+                    }
+                }
+            }
+            if (near_loud) {
+                ctx->tile_quiet[tile] = 0;
+                ctx->tile_awake[tile] = true;
+            }
+            else if (ctx->tile_awake[tile]) {
+                ctx->tile_quiet[tile]++;
+                if (ctx->tile_quiet[tile] >= JACOBI_ACTIVE_SWEEPS && \
+                        !wake_all) {
+                    matrix_partition_t b;
+                    jacobi_tile_bounds(tile, &b);
+                    for (unsigned row = b.row_start; row < b.row_end; row++) {
+                        memcpy(&other[row][b.col_start], \
+                            &written[row][b.col_start], \
+                            sizeof(double) * (b.col_end - b.col_start));
+                    }
+                    ctx->tile_awake[tile] = false;
+                }
+            }
+            if (wake_all) {
+                ctx->tile_awake[tile] = true;
+            }
+        }
+    }
+    jacobi_awake_list(ctx);
+}
+
+/**
+ * Rebalance mode. Measures the imbalance of the sweeps since the last
+ *   rebalance, the slowest subtask over the average, and if boundaries are
+ *   to move gives every band rows in proportion to the rows per ns its
+ *   subtask swept. Each boundary moves JACOBI_REBALANCE_DAMPING of the way
+ *   to its target, and every band keeps at least a row.
+ * Only called between steps, while the subtasks wait, so the bands can't
+ *   change under them.
+ */
+void jacobi_rebalance(jacobi_ctx_t *ctx) {
+    unsigned partition_num = ctx->partition_num;
+    matrix_partition_t *bounds = ctx->subtask_bounds;
+    double total_ns = 0.0, max_ns = 0.0, rate_sum = 0.0;
+    bool timed = true;
+
+    for (unsigned i = 0; i < partition_num; i++) {
+        double ns = (double)ctx->subtask_args[i].sweep_ns;
+        total_ns += ns;
+        if (ns > max_ns) {
+            max_ns = ns;
+        }
+        if (ns > 0.0) {
+            rate_sum += (bounds[i].row_end - bounds[i].row_start) / ns;
+        }
+        else {
+            timed = false;
+        }
+    }
+
+    if (timed) {
+        double imbalance = max_ns / (total_ns / partition_num);
+        if (ctx->imbalance_before == 0.0) {
+            ctx->imbalance_before = imbalance;
+        }
+        ctx->imbalance_after = imbalance;
+        if (imbalance > JACOBI_REBALANCE_ENTER) {
+            ctx->rebalancing = true;
+        }
+        else if (imbalance < JACOBI_REBALANCE_EXIT) {
+            ctx->rebalancing = false;
+        }
+    }
+
+    if (timed && ctx->rebalancing) {
+        double target = 1.0;
+        unsigned row_start = 1;
+        for (unsigned i = 0; i < partition_num; i++) {
+            unsigned row_end = MATRIX_ROWS-1;
+            // Bands after i still need a row each
+            unsigned row_max = MATRIX_ROWS-1 - (partition_num-1 - i);
+            target += (MATRIX_ROWS-2) * ((bounds[i].row_end - \
+                bounds[i].row_start) / (double)ctx->subtask_args[i].sweep_ns) \
+                / rate_sum;
+            if (i < partition_num-1) {
+                row_end = (unsigned)lround(bounds[i].row_end + \
+                    (target - bounds[i].row_end) * JACOBI_REBALANCE_DAMPING);
+                if (row_end <= row_start) {
+                    row_end = row_start + 1;
+                }
+                if (row_end > row_max) {
+                    row_end = row_max;
+                }
+            }
+            bounds[i].row_start = row_start;
+            bounds[i].row_end = row_end;
+            row_start = row_end;
+        }
+    }
+    for (unsigned i = 0; i < partition_num; i++) {
+        ctx->subtask_args[i].sweep_ns = 0;
+    }
+}
+
+/**
+ * Does one iteration. With subtasks, the wait barrier releases them to do
+ *   their partitions and the done barrier waits for all of them to finish.
+ *   The calling thread then collects the max delta and flips the matrices.
+ * In neighbour sync mode the subtasks do a round of check_interval iterations
+ *   between the barriers instead, and the matrices flip once per iteration.
+ * The calling thread id is refreshed every step, so any one thread at a time
+ *   can drive the context.
+ * Every step is published to the stats, if there are any.
+ * In Chebyshev mode the omega of the next iteration is worked out here, while
+ *   the subtasks wait, so they all see the same one. So are the tiles of the
+ *   next iteration in active set mode, and if an iteration with tiles asleep
+ *   falls to epsilon, the full iteration that confirms it is done as part of
+ *   the same step, and its max delta stored instead.
+ */
+jacobi_err jacobi_step(jacobi_ctx_t *ctx, double *delta_max) {
+    unsigned subtask_num = ctx->opts.subtask_num;
+    unsigned iterations = 1;
+    bool flip = true;
+    bool partial = false;
+
+    *delta_max = 0.0;
+    if (subtask_num == 0) {
+        subtask_arg_t *subtask_args = &(ctx->subtask_args[0]);
+        if (ctx->opts.stats != NULL) {
+            subtask_args->round_start_ns = stats_now_ns();
+        }
+        *delta_max = do_subtask_iteration(subtask_args, ctx->read_a_write_b);
+        if (ctx->opts.stats != NULL) {
+            subtask_args->busy_ns += stats_now_ns() - \
+                subtask_args->round_start_ns;
+            stats_thread_publish(ctx->opts.stats, 0, ctx->iterations + 1, \
+                subtask_args->busy_ns, 0, *delta_max);
+        }
+    }
+    else if (ctx->opts.sync == JACOBI_SYNC_ASYNC) {
+        // Sweeps are done in place, so the matrices never flip
+        ctx->threads[ctx->thread_num] = pthread_self();
+        iterations = jacobi_async_monitor(ctx);
+        flip = false;
+
+        for (int i = 0; i < subtask_num; i++) {
+            if (ctx->subtask_args[i].delta_max > *delta_max) {
+                *delta_max = ctx->subtask_args[i].delta_max;
+            }
+        }
+    }
+    else {
+        ctx->threads[ctx->thread_num] = pthread_self();
+        barrier_wait(&(ctx->subtask_wait_barrier), pthread_self());
+        barrier_wait(&(ctx->subtask_done_barrier), pthread_self());
+
+        for (int i = 0; i < subtask_num; i++) {
+            if (ctx->subtask_args[i].delta_max > *delta_max) {
+                *delta_max = ctx->subtask_args[i].delta_max;
+            }
+        }
+        if (ctx->opts.sync == JACOBI_SYNC_NEIGHBOUR) {
+            iterations = ctx->opts.check_interval;
+        }
+        // The subtasks are all waiting for the next step, so their bands can
+        //   be moved
+        else if (ctx->rebalance && \
+                ++(ctx->rebalance_since) == JACOBI_REBALANCE_INTERVAL) {
+            jacobi_rebalance(ctx);
+            ctx->rebalance_since = 0;
+        }
+    }
+    if (ctx->active) {
+        partial = (ctx->awake_num < JACOBI_TILES);
+        ctx->swept_cells += ctx->awake_cells;
+        ctx->total_cells += ctx->all_cells;
+        jacobi_active_update(ctx, partial && !ctx->verifying && \
+            *delta_max <= ctx->opts.epsilon);
+    }
+    if (flip && iterations % 2 == 1) {
+        ctx->read_a_write_b = !ctx->read_a_write_b;
+    }
+    ctx->iterations += iterations;
+    if (ctx->accel) {
+        jacobi_accel_update(ctx, *delta_max);
+    }
+    if (ctx->opts.stats != NULL) {
+        stats_publish(ctx->opts.stats, ctx->iterations, *delta_max);
+    }
+    if (partial && !ctx->verifying && *delta_max <= ctx->opts.epsilon) {
+        ctx->verifying = true;
+        jacobi_step(ctx, delta_max);
+        ctx->verifying = false;
+    }
+    return JACOBI_ERR_NONE;
+}
+
+/**
+ * Iterations left until delta falls to epsilon, if it keeps falling at the
+ *   rate it did over the last span iterations, from delta_old.
+ */
+double jacobi_estimate_left(double delta, double delta_old, unsigned span, \
+        double epsilon) {
+    double left = INFINITY;
+
+    if (delta <= epsilon) {
+        left = 0.0;
+    }
+    else if (span > 0 && delta < delta_old) {
+        double rate = pow(delta / delta_old, 1.0 / span);
+        left = ceil(log(epsilon / delta) / log(rate));
+    }
+    return left;
+}
+
+/**
+ * Iterates until the max delta is no more than epsilon or deadline passes.
+ *   Records the realtime and CPU time of the iterations along with their
+ *   number in rs, and how close the result is to converging. The deltas of
+ *   the last JACOBI_ESTIMATE_STEPS steps are kept for the estimate.
+ */
+jacobi_err jacobi_solve_until(jacobi_ctx_t *ctx, struct runtime_stats *rs, \
+        const struct timespec *deadline) {
+    struct timespec starttime_cpu_process;
+    struct timespec starttime_real;
+    struct timespec endtime_cpu_process;
+    struct timespec endtime_real;
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned start_iterations = ctx->iterations;
+    double deltas[JACOBI_ESTIMATE_STEPS];
+    unsigned delta_iterations[JACOBI_ESTIMATE_STEPS];
+    unsigned steps = 0;
+    bool passed = false;
+    double delta_max;
+
+    ctx->deadline = deadline;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &starttime_cpu_process);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &starttime_real);
+
+    do {
+        ret = jacobi_step(ctx, &delta_max);
+        deltas[steps % JACOBI_ESTIMATE_STEPS] = delta_max;
+        delta_iterations[steps % JACOBI_ESTIMATE_STEPS] = ctx->iterations;
+        steps++;
+        if (deadline != NULL) {
+            passed = timespec_passed(deadline);
+        }
+    } while (ret == JACOBI_ERR_NONE && delta_max > ctx->opts.epsilon && \
+        !passed);
+
+    if (ret == JACOBI_ERR_NONE) {
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endtime_cpu_process);
+        clock_gettime(CLOCK_MONOTONIC_RAW, &endtime_real);
+
+        rs->iterations = ctx->iterations - start_iterations;
+        timespec_diff(&endtime_cpu_process, &starttime_cpu_process, \
+            &(rs->runtime_cpu_process));
+        timespec_diff(&endtime_real, &starttime_real, &(rs->runtime_real));
+
+        unsigned oldest = (steps > JACOBI_ESTIMATE_STEPS) ? \
+            steps % JACOBI_ESTIMATE_STEPS : 0;
+        rs->delta_max = delta_max;
+        rs->converged = (delta_max <= ctx->opts.epsilon);
+        rs->iterations_left = jacobi_estimate_left(delta_max, \
+            deltas[oldest], ctx->iterations - delta_iterations[oldest], \
+            ctx->opts.epsilon);
+    }
+    ctx->deadline = NULL;
+    return ret;
+}
+
+/**
+ * Iterates until the max delta is no more than epsilon, or until the
+ *   deadline_ms of the options have passed if there are any.
+ */
+jacobi_err jacobi_solve(jacobi_ctx_t *ctx, struct runtime_stats *rs) {
+    struct timespec deadline;
+    jacobi_err ret;
+
+    if (ctx->opts.deadline_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &deadline);
+        timespec_add_ms(&deadline, ctx->opts.deadline_ms);
+        ret = jacobi_solve_until(ctx, rs, &deadline);
+    }
+    else {
+        ret = jacobi_solve_until(ctx, rs, NULL);
+    }
+    return ret;
+}
+
+/**
+ * The latest estimate, which is the matrix the next iteration reads from.
+ */
+double (*jacobi_result(jacobi_ctx_t *ctx))[MATRIX_STRIDE] {
+    if (ctx->read_a_write_b) {
+        return ctx->matrix_a;
+    }
+    else {
+        return ctx->matrix_b;
+    }
+}
+
+/**
+ * Number of iterations done so far.
+ */
+unsigned jacobi_iterations(jacobi_ctx_t *ctx) {
+    return ctx->iterations;
+}
+
+/**
+ * Number of sweeps a subtask has done so far. Outside of async mode every
+ *   subtask does every iteration.
+ */
+unsigned jacobi_sweeps(jacobi_ctx_t *ctx, unsigned subtask) {
+    unsigned sweeps = ctx->iterations;
+    assert(subtask < ctx->opts.subtask_num || subtask == 0);
+    if (ctx->opts.sync == JACOBI_SYNC_ASYNC && ctx->opts.subtask_num > 0) {
+        sweeps = ctx->counters[subtask].done;
+    }
+    return sweeps;
+}
+
+/**
+ * Imbalance of the first and last interval of rebalance mode.
+ */
+void jacobi_imbalance(jacobi_ctx_t *ctx, double *before, double *after) {
+    *before = ctx->imbalance_before;
+    *after = ctx->imbalance_after;
+}
+
+/**
+ * Fraction of the cell updates skipped by active set mode so far.
+ */
+double jacobi_skipped(jacobi_ctx_t *ctx) {
+    double skipped = 0.0;
+    if (ctx->active && ctx->total_cells > 0.0) {
+        skipped = 1.0 - ctx->swept_cells / ctx->total_cells;
+    }
+    return skipped;
+}
+
+/**
+ * Stops the subtask threads (they exit once released from the wait barrier
+ *   with do_next_iteration false) and frees the context.
+ */
+void jacobi_destroy(jacobi_ctx_t *ctx) {
+    if (ctx->threads_started) {
+        ctx->do_next_iteration = false;
+        ctx->threads[ctx->thread_num] = pthread_self();
+        barrier_wait(&(ctx->subtask_wait_barrier), pthread_self());
+        for (int i = 0; i < ctx->thread_num; i++) {
+            pthread_join(ctx->threads[i], NULL);
+        }
+        sem_destroy(&(ctx->creation_wait));
+    }
+    jacobi_ctx_free(ctx);
+}
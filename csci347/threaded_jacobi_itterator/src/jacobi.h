@@ -0,0 +1,236 @@
+#ifndef __JACOBI_H
+#define __JACOBI_H
+#include "matrix.h"
+#include "mask.h"
+#include "stencil.h"
+#include "barrier.h"
+#include "stats.h"
+#include <time.h>
+
+// libjacobi
+// All the state of a solve lives in its jacobi_ctx_t, so any number of solves
+//   can run at once in one process. A context is created from options and an
+//   input matrix, then either solved to convergence or stepped one iteration
+//   at a time, and finally destroyed.
+
+// Accuracy constant
+#define JACOBI_EPSILON 0.001
+
+// Iterations between convergence checks in neighbour sync mode
+#define JACOBI_CHECK_INTERVAL 8
+
+// Chebyshev mode. Iterations of plain Jacobi done before the spectral radius
+//   is first estimated, and the iterations the estimate is taken over
+#define JACOBI_ACCEL_WARMUP 8
+#define JACOBI_ACCEL_SPAN 4
+// Iterations between checks of the estimate against the observed convergence
+#define JACOBI_ACCEL_CYCLE 12
+// Estimates are capped here, past it the weights stop improving anything
+#define JACOBI_ACCEL_RHO_MAX 0.99999
+// Iterations of deltas kept for the estimates, more than any of the above
+#define JACOBI_ACCEL_HISTORY 16
+
+// Active set mode. Side of a tile in cells, the fraction of epsilon a tile
+//   and its neighbours have to stay under to sleep, and the sweeps in a row
+//   they have to stay under it for. A sleeping tile still drifts by up to the
+//   fraction every sweep it misses, so it is kept small enough that the
+//   drift stays under epsilon by the time the solve converges (a tenth left
+//   results 9x epsilon off a full solve).
+#define JACOBI_TILE 32
+#define JACOBI_TILE_ROWS ((MATRIX_ROWS-2 + JACOBI_TILE-1) / JACOBI_TILE)
+#define JACOBI_TILE_COLS ((MATRIX_COLS-2 + JACOBI_TILE-1) / JACOBI_TILE)
+#define JACOBI_TILES (JACOBI_TILE_ROWS * JACOBI_TILE_COLS)
+#define JACOBI_ACTIVE_FRACTION 0.01
+#define JACOBI_ACTIVE_SWEEPS 4
+
+// Fiber mode. Stack of every fiber, in bytes
+#define JACOBI_FIBER_STACK (64 * 1024)
+
+// Rebalance mode. Iterations between rebalances, the imbalance (slowest band
+//   over the average) that starts moving rows and the one that stops it
+//   again, and the fraction of the way to its target a boundary is moved.
+#define JACOBI_REBALANCE_INTERVAL 16
+#define JACOBI_REBALANCE_ENTER 1.10
+#define JACOBI_REBALANCE_EXIT 1.03
+#define JACOBI_REBALANCE_DAMPING 0.5
+
+// Steps back that the iterations a solve stopped at its deadline still needed
+//   are estimated over
+#define JACOBI_ESTIMATE_STEPS 16
+
+// Error defines
+typedef enum jacobi_err jacobi_err;
+enum jacobi_err {
+    JACOBI_ERR_NONE,
+    JACOBI_ERR_MALLOC,
+    JACOBI_ERR_PTHREAD_CREATE,
+    JACOBI_ERR_BARRIER_INIT
+};
+
+// Statistics related to the runtime performance of the jacobi_iteration algorithm
+// The quality of the result is only filled in by jacobi_solve. delta_max is
+//   that of the last iteration, and iterations_left is how many more a solve
+//   that was stopped at its deadline would have needed to converge, going by
+//   how fast delta_max was falling when it stopped: 0 if it converged, and
+//   INFINITY if delta_max was not falling. It tends to be low early in a solve,
+//   while the fast to converge parts of the error are still dying out.
+struct runtime_stats {
+    unsigned iterations;
+    struct timespec runtime_cpu_process;
+    struct timespec runtime_real;
+    double delta_max;
+    bool converged;
+    double iterations_left;
+};
+
+// How the subtask threads are kept in step.
+// JACOBI_SYNC_BARRIER syncs every thread twice an iteration on barrier_id and
+//   checks convergence after every iteration.
+// JACOBI_SYNC_NEIGHBOUR has each partition wait only for the partitions next
+//   to it, through per partition iteration counters, so a partition can get
+//   up to one iteration ahead of its neighbours. The threads only meet on the
+//   barriers every check_interval iterations to check convergence, so a solve
+//   does a multiple of check_interval iterations.
+// JACOBI_SYNC_ASYNC does chaotic relaxation. Partitions are row bands swept in
+//   place over and over, reading whatever values their neighbours have
+//   written so far, so the iteration path changes from run to run. Each
+//   thread publishes its residual, and the run stops once every thread has
+//   been under epsilon for check_interval sweeps in a row. The iterations of
+//   a solve are the sweeps averaged over the threads.
+typedef enum jacobi_sync_e jacobi_sync_e;
+enum jacobi_sync_e {
+    JACOBI_SYNC_BARRIER   = 0,
+    JACOBI_SYNC_NEIGHBOUR = 1,
+    JACOBI_SYNC_ASYNC     = 2,
+    JACOBI_SYNC_TOTAL     = 3
+};
+
+// How the iterations are accelerated.
+// JACOBI_ACCEL_CHEBYSHEV does Chebyshev semi-iteration. Each iteration still
+//   works out every cell from the last estimate alone, but then moves the
+//   cell omega of the way from its value two iterations ago to the new value,
+//   with omega from the Chebyshev recurrence for the spectral radius rho of
+//   Jacobi. The value of two iterations ago is what the matrix being written
+//   holds anyway, so no extra matrix is needed. rho is first estimated from
+//   how fast the deltas of a few plain iterations shrink, and raised, which
+//   restarts the recurrence, whenever the deltas shrink slower than the
+//   estimate says they should. The deltas are still those of plain Jacobi.
+//   Only applies with barrier sync or to serial solves, and not in place.
+typedef enum jacobi_accel_e jacobi_accel_e;
+enum jacobi_accel_e {
+    JACOBI_ACCEL_NONE      = 0,
+    JACOBI_ACCEL_CHEBYSHEV = 1,
+    JACOBI_ACCEL_TOTAL     = 2
+};
+
+// Options of a solve. subtask_num of 0 solves on the calling thread alone,
+//   otherwise subtask_num threads are started and synced with barrier_id.
+//   mask is optional (NULL iterates every interior cell) and must outlive the
+//   context.
+// in_place solves in the input matrix itself instead of in two copies of it,
+//   so the whole solve holds one matrix, plus a few rows for each partition.
+//   The result is still exactly that of Jacobi. Partitions are always row
+//   bands, and the input matrix is overwritten and must outlive the context.
+// stats is optional (NULL publishes nothing). Otherwise the progress of the
+//   solve is published to it as it goes, and it must have an entry for every
+//   subtask (or one for a serial solve) and outlive the context.
+// accel is ignored by the modes it does not apply to, see jacobi_accel_e.
+// active only sweeps the tiles of the grid that are still changing. A tile
+//   falls asleep once it and the 8 around it have all changed by less than
+//   JACOBI_ACTIVE_FRACTION of epsilon for JACOBI_ACTIVE_SWEEPS sweeps in a
+//   row, and is woken as soon as a tile next to it changes by more than that.
+//   Sleeping tiles are the same in both matrices, so they are simply read
+//   as they are. Once an iteration with tiles asleep falls to epsilon, every
+//   tile is woken and one more full iteration decides whether the solve has
+//   really converged. The awake tiles are split evenly between the
+//   subtasks instead of them having fixed partitions. Applies where accel
+//   does, and is ignored if accel applies too.
+// deadline_ms of 0 solves until convergence, otherwise jacobi_solve stops once
+//   that long has passed even if the solve hasn't converged. The last step is
+//   always finished, and async mode stops its sweeps at the deadline.
+// fibers runs the subtasks as user space fibers instead of threads, on one
+//   worker thread per CPU (or per subtask, if there are fewer), each pinned
+//   to its CPU. Every worker runs a contiguous block of subtasks, and only
+//   the workers meet on the barriers. Waiting on the barrier or on a
+//   neighbour just switches to the next fiber of the worker, so any number
+//   of subtasks costs no more kernel threads or context switches than there
+//   are CPUs. Results are the same as with threads. Ignored in async mode,
+//   where the sweeps never wait.
+// rebalance times the sweep of every subtask, and every
+//   JACOBI_REBALANCE_INTERVAL iterations moves the boundaries between row
+//   bands so each band gets rows in proportion to how fast its subtask swept
+//   them, for cores that run at different speeds. Boundaries only start
+//   moving once the imbalance passes JACOBI_REBALANCE_ENTER, and stop once
+//   it falls under JACOBI_REBALANCE_EXIT, so noise alone doesn't move them.
+//   Partitions are always row bands. Only applies with barrier sync, more
+//   than one subtask and no mask, and not in place or with active.
+// buffers, if both are set, are the two matrices the solve iterates between
+//   instead of allocating its own. The input is copied into both, and they
+//   must outlive the context, so a caller running many solves can reuse them.
+//   Ignored in place.
+typedef struct jacobi_opts jacobi_opts_t;
+struct jacobi_opts {
+    barrier_e barrier_id;
+    unsigned subtask_num;
+    mask_t *mask;
+    const stencil_t *stencil;
+    double epsilon;
+    jacobi_sync_e sync;
+    unsigned check_interval;
+    bool in_place;
+    stats_t *stats;
+    jacobi_accel_e accel;
+    bool active;
+    unsigned deadline_ms;
+    bool fibers;
+    bool rebalance;
+    double (*buffers[2])[MATRIX_STRIDE];
+};
+
+// Opaque solver context
+typedef struct jacobi_ctx jacobi_ctx_t;
+
+// Fills opts with the defaults: serial 5 point solve of every cell.
+void jacobi_opts_default(jacobi_opts_t *opts);
+// Creates a context that solves input_matrix with opts. input_matrix is copied
+//   so the caller keeps ownership of it, unless opts->in_place is set, in which
+//   case it is used as is. Subtask threads are started here.
+jacobi_err jacobi_create(jacobi_ctx_t **ctx, const jacobi_opts_t *opts, \
+    double (*input_matrix)[MATRIX_STRIDE]);
+// Does a single iteration and stores its max delta in delta_max. In neighbour
+//   sync mode it does check_interval iterations and stores the max delta of
+//   the last one. In async mode it sweeps until the residuals settle.
+jacobi_err jacobi_step(jacobi_ctx_t *ctx, double *delta_max);
+// Iterates until the max delta falls to epsilon, or the deadline of the
+//   options passes, and stores the stats in rs.
+jacobi_err jacobi_solve(jacobi_ctx_t *ctx, struct runtime_stats *rs);
+// Like jacobi_solve, but stops at deadline, on CLOCK_MONOTONIC_RAW, instead.
+//   A NULL deadline solves until convergence.
+jacobi_err jacobi_solve_until(jacobi_ctx_t *ctx, struct runtime_stats *rs, \
+    const struct timespec *deadline);
+// The latest estimate. Owned by ctx, so it is only valid until it is destroyed.
+double (*jacobi_result(jacobi_ctx_t *ctx))[MATRIX_STRIDE];
+// Number of iterations done so far.
+unsigned jacobi_iterations(jacobi_ctx_t *ctx);
+// Number of sweeps a subtask has done so far. Only differs between subtasks
+//   in async mode.
+unsigned jacobi_sweeps(jacobi_ctx_t *ctx, unsigned subtask);
+// Fraction of the cell updates of the solve so far that active set mode
+//   skipped, 0 in every other mode.
+double jacobi_skipped(jacobi_ctx_t *ctx);
+// Imbalance of the sweeps of the subtasks, the slowest over the average, over
+//   the first JACOBI_REBALANCE_INTERVAL iterations of the solve and over the
+//   last such span, in rebalance mode. Both 0 in every other mode, or if no
+//   span has been measured yet.
+void jacobi_imbalance(jacobi_ctx_t *ctx, double *before, double *after);
+// Stops the subtask threads and frees everything owned by ctx.
+void jacobi_destroy(jacobi_ctx_t *ctx);
+
+// Timing helpers
+void timespec_diff(struct timespec *end, struct timespec *start, \
+    struct timespec *diff);
+double conv_timespec_to_ms(struct timespec *tm);
+void timespec_add_ms(struct timespec *tm, unsigned ms);
+bool timespec_passed(const struct timespec *deadline);
+
+#endif /* __JACOBI_H */
@@ -1,444 +1,566 @@
-#include "matrix.h"
-#include "barrier.h"
+#include "jacobi.h"
+#include "batch.h"
 #include "options.h"
-#include <stdbool.h>
+#include "roofline.h"
+#include "ooc.h"
+#include "multi.h"
+#include "plan.h"
+#include "incr.h"
+#include "mem_stats.h"
+#include "sweep.h"
 #include <math.h>
-#include <time.h>
-
-// Accuracy constant
-const double epsilon = 0.001;
-
-// Where all subtask threads sync after doing an iteration
-barrier_t subtask_done_barrier;
-// Where the subtask threads wait for the main thread to decide their fate
-barrier_t subtask_wait_barrier;
-
-// Subtask arguments
-typedef struct subtask_arg subtask_arg_t;
-struct subtask_arg {
-    double (*matrix_a)[MATRIX_COLS];
-    double (*matrix_b)[MATRIX_COLS];
-    matrix_partition_t *subtask_bounds;
-    double delta_max;
-};
-
-// Global states for communication with subtask threads
-
-// Keeps threads from executing before all threads are created (to make errors)
-//   in thread creation easier to handle.
-sem_t creation_wait;
-// Controls further iterations of jacobi algorithm
-bool do_next_iteration;
-// Controls which matrix is read from or written to. Shared since this must be
-//   identical between threads.
-bool read_a_write_b;
-
-// Statistics related to the runtime performance of the jacobi_iteration algorithm
-struct runtime_stats {
-    unsigned iterations;
-    struct timespec runtime_cpu_process;
-    struct timespec runtime_real;
-};
-
-// Error defines
-typedef enum jacobi_err jacobi_err;
-enum jacobi_err {
-    JACOBI_ERR_NONE,
-    JACOBI_ERR_MALLOC,
-    JACOBI_ERR_PTHREAD_CREATE,
-    JACOBI_ERR_BARRIER_INIT
-};
+#include <unistd.h>
 
 /**
- * Calcualtes difference between start and end times for a given run of jacobi
+ * Simple error output for any mat_err
+ * All of the errors have associated errno values, so perror is called 
+ *   directly.
  */
-void timespec_diff(struct timespec *end, struct timespec *start, \
-        struct timespec *diff) {
-    diff->tv_sec = end->tv_sec - start->tv_sec;
-    diff->tv_nsec = end->tv_nsec - start->tv_nsec;
-    if (diff->tv_nsec < 0) {
-        diff->tv_sec--;
-        diff->tv_nsec = 1000000000L + diff->tv_nsec;
-    }
+void mat_perror(mat_err err, char *prog_name) {
+    printf("%s: mat_err: ", prog_name);
+    perror(NULL);
 }
 
 /**
- * Converts time to microseconds
- */
-double conv_timespec_to_ms(struct timespec *tm) {
-    double msec = tm->tv_sec * 1000.0;
-    msec += tm->tv_nsec / 1000000.0;
-    return msec;
+ * Simple error output for any jacobi_err
+ * All of the errors have associated errno values, so perror is called 
+ *   directly.
+ */ 
+void jacobi_perror(jacobi_err err, char *prog_name) {
+    printf("%s: jacobi_err: ", prog_name);
+    perror(NULL);
 }
 
 /**
- * Calculcates an iteration of jacobi's within the specified bounds.
- * Returns the max delta of the iteration.
+ * Prints the results of a solve as a CSV line with no newline:
+ *   iterations,real-time(ms),cpu-time(ms),
+ * Async runs add the sweeps of each thread as one field separated by ;
+ *   out of core runs add MB streamed,MB to and from disk, both per iteration,
+ *   and --roofline adds GB/s,GFLOP/s,STREAM GB/s,% of roofline,
+ * Runs with a deadline add max delta,converged (0 or 1),iterations left,
+ *   planned runs add the subtasks,acceleration the plan picked,
+ *   --active adds the % of cell updates skipped, and --rebalance the
+ *   imbalance of the first and last rebalance interval,
+ * ctx is only used by async runs, io is NULL unless the run was out of core
+ *   and plan is NULL unless the run was planned.
  */
-double do_bounded_iteration(double (*read_matrix)[MATRIX_COLS], \
-        double (*write_matrix)[MATRIX_COLS], \
-        matrix_partition_t *subtask_bounds) {
-    
-    double prev_estimate, delta, delta_max = 0.0;
-
-    for (unsigned row = subtask_bounds->row_start; \
-            row < subtask_bounds->row_end; row++) {
-        for (unsigned col = subtask_bounds->col_start; \
-                col < subtask_bounds->col_end; col++){
-
-            prev_estimate = read_matrix[row][col];
-            write_matrix[row][col] = (read_matrix[row][col+1]+
-                                      read_matrix[row][col-1]+
-                                      read_matrix[row+1][col]+
-                                      read_matrix[row-1][col]) / 4.0;
-
-            delta = fabs(prev_estimate - write_matrix[row][col]);
-            if (delta > delta_max) {
-                delta_max = delta;
-            }
+void print_results_csv(jacobi_ctx_t *ctx, jacobi_opts_t *opts, \
+        struct runtime_stats *rs, ooc_io_t *io, roofline_t *rl, \
+        bool roofline, plan_t *plan) {
+    printf("%d,%.10e,%.10e,", rs->iterations, \
+        conv_timespec_to_ms(&(rs->runtime_real)), \
+        conv_timespec_to_ms(&(rs->runtime_cpu_process)));
+    if (opts->sync == JACOBI_SYNC_ASYNC && opts->subtask_num > 0) {
+        for (unsigned i = 0; i < opts->subtask_num; i++) {
+            printf("%u%s", jacobi_sweeps(ctx, i), \
+                (i < opts->subtask_num-1) ? ";" : ",");
         }
     }
-    return delta_max;
+    if (io != NULL) {
+        printf("%.4f,%.4f,", io->streamed_bytes / 1e6, io->disk_bytes / 1e6);
+    }
+    if (roofline) {
+        printf("%.4f,%.4f,%.4f,%.2f,", rl->gbs, rl->gflops, rl->stream_gbs, \
+            rl->roof_pct);
+    }
+    if (opts->deadline_ms > 0 || plan != NULL) {
+        printf("%.10e,%d,%.0f,", rs->delta_max, rs->converged, \
+            rs->iterations_left);
+    }
+    if (plan != NULL) {
+        printf("%u,%d,", plan->subtask_num, plan->accel);
+    }
+    if (opts->active) {
+        printf("%.2f,", jacobi_skipped(ctx) * 100.0);
+    }
+    if (opts->rebalance) {
+        double before, after;
+        jacobi_imbalance(ctx, &before, &after);
+        printf("%.4f,%.4f,", before, after);
+    }
 }
 
 /**
- * Does iterations of jacobi to completion over some bounds given in arg.
- * creation_wait provides a way to kill threads if one of them fails to create.
- *   Once passed, it calculates iterations of its partition until told to stop.
- * Exit condition is do_next_iteration being set false. 
+ * Prints the results of a solve as a single JSON object, followed by a
+ *   newline. The rates are always there, the STREAM fields only with
+ *   --roofline. iterations_left is null if the delta was not falling.
  */
-void* jacobi_iteration_subtask(void* arg) {
-    subtask_arg_t *subtask_args = (subtask_arg_t*)arg;
-    double delta_max = 0.0;
-
-    sem_wait(&creation_wait);
-
-    while (do_next_iteration) {
-        if (read_a_write_b) {
-            delta_max = do_bounded_iteration(subtask_args->matrix_a, \
-                subtask_args->matrix_b, subtask_args->subtask_bounds);
+void print_results_json(jacobi_ctx_t *ctx, jacobi_opts_t *opts, \
+        struct runtime_stats *rs, ooc_io_t *io, roofline_t *rl, \
+        bool roofline, plan_t *plan) {
+    printf("{\"iterations\": %u, \"real_ms\": %.6f, \"cpu_ms\": %.6f, "\
+        "\"stencil\": \"%s\", \"cell_updates\": %.0f, \"gbs\": %.4f, "\
+        "\"gflops\": %.4f", rs->iterations, \
+        conv_timespec_to_ms(&(rs->runtime_real)), \
+        conv_timespec_to_ms(&(rs->runtime_cpu_process)), \
+        opts->stencil->name, rl->cell_updates, rl->gbs, rl->gflops);
+    if (opts->sync == JACOBI_SYNC_ASYNC && opts->subtask_num > 0) {
+        printf(", \"sweeps\": [");
+        for (unsigned i = 0; i < opts->subtask_num; i++) {
+            printf("%u%s", jacobi_sweeps(ctx, i), \
+                (i < opts->subtask_num-1) ? ", " : "]");
+        }
+    }
+    if (io != NULL) {
+        printf(", \"streamed_mb_per_iteration\": %.4f, "\
+            "\"disk_mb_per_iteration\": %.4f", io->streamed_bytes / 1e6, \
+            io->disk_bytes / 1e6);
+    }
+    if (roofline) {
+        printf(", \"stream_gbs\": %.4f, \"roofline_pct\": %.2f", \
+            rl->stream_gbs, rl->roof_pct);
+    }
+    if (opts->deadline_ms > 0 || plan != NULL) {
+        printf(", \"delta_max\": %.10e, \"converged\": %s, "\
+            "\"iterations_left\": ", rs->delta_max, \
+            rs->converged ? "true" : "false");
+        if (isinf(rs->iterations_left)) {
+            printf("null");
         }
         else {
-            delta_max = do_bounded_iteration(subtask_args->matrix_b, \
-                subtask_args->matrix_a, subtask_args->subtask_bounds);
+            printf("%.0f", rs->iterations_left);
         }
-        subtask_args->delta_max = delta_max;
-        barrier_wait(&subtask_done_barrier, pthread_self());
-        barrier_wait(&subtask_wait_barrier, pthread_self());
     }
-    pthread_exit(NULL);
+    if (plan != NULL) {
+        printf(", \"plan_subtasks\": %u, \"plan_accel\": %d", \
+            plan->subtask_num, plan->accel);
+    }
+    if (opts->active) {
+        printf(", \"skipped_pct\": %.2f", jacobi_skipped(ctx) * 100.0);
+    }
+    if (opts->rebalance) {
+        double before, after;
+        jacobi_imbalance(ctx, &before, &after);
+        printf(", \"imbalance_before\": %.4f, \"imbalance_after\": %.4f", \
+            before, after);
+    }
+    printf("}\n");
 }
 
-
-
 /**
- * Creates the subtask threads.
- * creation_wait exists as a safeguard against a pthread failing to 
- *   create. If one fails, do_next_iteration is set to false and creation_wait
- *   is released for all the threads that succeeded, killing them. Otherwise at
- *   the end it is released for all threads.
- * At the end, the main thread id is put into threads since it is used by the
- *   semaphore heap barrier.
+ * Solves input_matrix with the options given on the command line and writes
+ *   the result to the output file.
+ * With --roofline the STREAM probe runs first, on as many threads as the
+ *   solve, so the solve itself is timed alone.
+ * With --stats the solve publishes its progress for jacobi_top as it goes.
+ * With --deadline-ms the solve stops at the budget even if it hasn't
+ *   converged, and the best estimate so far is written. With --plan as well
+ *   the subtasks and acceleration are picked for the budget (see plan.h).
  */
-jacobi_err jacobi_iteration_start_subtasks(pthread_t *threads, \
-        subtask_arg_t *subtask_args, unsigned subtask_num) {
-    int err = 0;
-    jacobi_err ret = JACOBI_ERR_NONE;
-    
-    sem_init(&creation_wait, 0, 0);
-    unsigned t = 0;
-    while (t < subtask_num && err == 0) {
-        err = pthread_create(&(threads[t]), NULL, \
-            jacobi_iteration_subtask, (void*)&(subtask_args[t]));
-        if (err > 0) {
-            do_next_iteration = false;
-            for (int j = 0; j < t; j++) {
-                sem_post(&creation_wait);
-            }
-            for (int j = 0; j < t; j++) {
-                pthread_join(threads[j], NULL);
-            }
+int solve_and_write(option_values_t *option_values, \
+        double (*input_matrix)[MATRIX_STRIDE], mask_t *mask, char *prog_name) {
+    jacobi_opts_t opts;
+    jacobi_ctx_t *ctx;
+    struct runtime_stats rs;
+    roofline_t rl;
+    double stream_gbs = 0.0;
+    stats_t stats;
+    plan_t plan;
+    plan_t *plan_p = NULL;
+    unsigned long cells = (mask != NULL) ? mask->active_cells : \
+        (unsigned long)(MATRIX_ROWS-2) * (MATRIX_COLS-2);
+
+    mat_err m_err = MAT_ERR_NONE;
+    jacobi_err j_err = JACOBI_ERR_NONE;
+    int ret = 0;
 
-            errno = err;
-            ret = JACOBI_ERR_PTHREAD_CREATE;
+    jacobi_opts_default(&opts);
+    opts.barrier_id = option_values->barrier_id;
+    opts.subtask_num = option_values->subtask_num;
+    opts.mask = mask;
+    opts.stencil = stencil_get(option_values->stencil_id);
+    opts.sync = option_values->sync;
+    opts.check_interval = option_values->check_interval;
+    // The input is not needed once solved, so it may be solved in place
+    opts.in_place = option_values->in_place;
+    opts.accel = option_values->accel;
+    opts.active = option_values->active;
+    opts.fibers = option_values->fibers;
+    opts.rebalance = option_values->rebalance;
+    opts.deadline_ms = option_values->deadline_ms;
+
+    if (option_values->roofline) {
+        stream_gbs = roofline_stream_probe(opts.subtask_num);
+    }
+    if (option_values->plan) {
+        j_err = plan_solve(&opts, input_matrix, opts.deadline_ms, &ctx, &rs, \
+            &plan);
+        if (j_err != JACOBI_ERR_NONE) {
+            jacobi_perror(j_err, prog_name);
+            ret = -1;
         }
         else {
-            t++;
+            plan_p = &plan;
+            opts.subtask_num = plan.subtask_num;
+            opts.sync = JACOBI_SYNC_BARRIER;
+            opts.accel = plan.accel;
         }
     }
-
-    threads[t] = pthread_self();
-
-    if (t == subtask_num) {
-        for (int j = 0; j < subtask_num; j++) {
-            sem_post(&creation_wait);
+    else if (option_values->stats && stats_create(&stats, \
+            (opts.subtask_num > 0) ? opts.subtask_num : 1, cells, \
+            opts.epsilon) < 0) {
+        printf("%s: stats: ", prog_name);
+        perror(NULL);
+        ret = -1;
+    }
+    else {
+        if (option_values->stats) {
+            opts.stats = &stats;
+        }
+        j_err = jacobi_create(&ctx, &opts, input_matrix);
+        if (j_err != JACOBI_ERR_NONE) {
+            jacobi_perror(j_err, prog_name);
+            ret = -1;
+        }
+        else {
+            j_err = jacobi_solve(ctx, &rs);
+            if (j_err != JACOBI_ERR_NONE) {
+                jacobi_perror(j_err, prog_name);
+                ret = -1;
+                jacobi_destroy(ctx);
+            }
         }
     }
-    
-    return ret;
-}
-
-/**
- * Initializes subtasks, and after each iteration calculates the maximum delta
- *   and compares against epsilon to decide whether to continue running or not.
- * Once done, waits for all subtask threads to exit, and stores the number of
- *   iterations in iterations.
- */
-jacobi_err jacobi_iteration_main_thread(pthread_t *threads, subtask_arg_t *subtask_args, \
-        unsigned subtask_num, unsigned *iterations) {
-
-    *iterations = 0;
-    jacobi_err ret = JACOBI_ERR_NONE;
-
-    do_next_iteration = true;
-    read_a_write_b = true;
-
-    ret = jacobi_iteration_start_subtasks(threads, subtask_args, subtask_num);
-    if (ret == JACOBI_ERR_NONE) {
-        while (do_next_iteration) {
-            barrier_wait(&subtask_done_barrier, pthread_self());
-
-            double delta_max = 0.0;
-            for (int i = 0; i < subtask_num; i++) {
-                if (subtask_args[i].delta_max > delta_max) {
-                    delta_max = subtask_args[i].delta_max;
-                }
+    if (ret == 0) {
+        m_err = matrix_file_out(jacobi_result(ctx), \
+            option_values->output_fname);
+        if (m_err != MAT_ERR_NONE) {
+            mat_perror(m_err, prog_name);
+            ret = -1;
+        }
+        else {
+            // Active set mode only updates the cells of the awake tiles
+            unsigned long swept_cells = (unsigned long)(cells * \
+                (1.0 - jacobi_skipped(ctx)) + 0.5);
+            roofline_compute(&rl, swept_cells, rs.iterations, opts.stencil, \
+                conv_timespec_to_ms(&(rs.runtime_real)), stream_gbs);
+            if (option_values->print_format == PRINT_JSON) {
+                print_results_json(ctx, &opts, &rs, NULL, &rl, \
+                    option_values->roofline, plan_p);
             }
-
-            do_next_iteration = (delta_max > epsilon);
-            if (do_next_iteration) {
-                read_a_write_b = !read_a_write_b;
+            else {
+                print_results_csv(ctx, &opts, &rs, NULL, &rl, \
+                    option_values->roofline, plan_p);
             }
-
-            (*iterations)++;
-            barrier_wait(&subtask_wait_barrier, pthread_self());
-        }
-        for (int i = 0; i < subtask_num; i++) {
-            pthread_join(threads[i], NULL);
         }
+        jacobi_destroy(ctx);
+    }
+    if (opts.stats != NULL) {
+        stats_done(opts.stats);
+        stats_delete(opts.stats);
     }
     return ret;
 }
 
 /**
- * Wrapper function to record realtime and CPU time of the jacobi algorithm.
- * Runs the jacobi algorithm and stores the return data in rs.
+ * Solves out of core (see ooc.h) and writes the result to the output file.
+ *   The input is read straight into a grid file named after the output file,
+ *   which is removed once the result has been written.
  */
-jacobi_err time_jacobi_iteration(pthread_t *threads, \
-        subtask_arg_t *subtask_args, unsigned subtask_num, \
-        struct runtime_stats *rs) {
-
-    struct timespec starttime_cpu_process;
-    struct timespec starttime_real;
-    struct timespec endtime_cpu_process;
-    struct timespec endtime_real;
-    jacobi_err ret = JACOBI_ERR_NONE;
-    
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &starttime_cpu_process);
-    clock_gettime(CLOCK_MONOTONIC_RAW, &starttime_real);
+int ooc_solve_and_write(option_values_t *option_values, mask_t *mask, \
+        char *prog_name) {
+    jacobi_opts_t opts;
+    ooc_grid_t grid;
+    ooc_io_t io;
+    struct runtime_stats rs;
+    roofline_t rl;
+    double stream_gbs = 0.0;
+    char *grid_fname;
 
-    ret = jacobi_iteration_main_thread(threads, subtask_args, subtask_num, \
-        &(rs->iterations));
+    mat_err m_err = MAT_ERR_NONE;
+    jacobi_err j_err = JACOBI_ERR_NONE;
+    int ret = 0;
 
-    if (ret == JACOBI_ERR_NONE) {
-        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endtime_cpu_process);
-        clock_gettime(CLOCK_MONOTONIC_RAW, &endtime_real);
+    jacobi_opts_default(&opts);
+    opts.mask = mask;
+    opts.stencil = stencil_get(option_values->stencil_id);
 
-        timespec_diff(&endtime_cpu_process, &starttime_cpu_process, \
-            &(rs->runtime_cpu_process));
-        timespec_diff(&endtime_real, &starttime_real, &(rs->runtime_real));
+    if (option_values->roofline) {
+        stream_gbs = roofline_stream_probe(1);
     }
-    return ret;
-}
-
-/**
- * All the alocation for running the algorithm. Contained in a folder to keep
- *   the mess hidden from view.
- */
-jacobi_err jacobi_iteration_mem_init(double (*input_matrix)[MATRIX_COLS], \
-        double (**matrix_a)[MATRIX_COLS], double (**matrix_b)[MATRIX_COLS], \
-        pthread_t **threads, subtask_arg_t **subtask_args, \
-        matrix_partition_t **subtask_bounds, unsigned subtask_num) {
-
-    jacobi_err ret = JACOBI_ERR_NONE;
 
-    ret = matrix_init_value(matrix_a, input_matrix);
-    if (ret == JACOBI_ERR_NONE) {
-        ret = matrix_init_value(matrix_b, input_matrix);
-        if (ret != JACOBI_ERR_NONE) {
-            matrix_delete(matrix_a);
+    errno = 0;
+    grid_fname = malloc(strlen(option_values->output_fname) + \
+        strlen(OOC_GRID_SUFFIX) + 1);
+    if (grid_fname == NULL) {
+        mat_perror(MAT_ERR_MALLOC, prog_name);
+        ret = -1;
+    }
+    else {
+        strcpy(grid_fname, option_values->output_fname);
+        strcat(grid_fname, OOC_GRID_SUFFIX);
+        m_err = ooc_grid_create(&grid, grid_fname);
+        if (m_err != MAT_ERR_NONE) {
+            mat_perror(m_err, prog_name);
+            ret = -1;
         }
         else {
-            errno = 0;
-            *threads = malloc(sizeof(pthread_t) * (subtask_num+1));
-            if (*threads == NULL) {
-                matrix_delete(matrix_a);
-                matrix_delete(matrix_b);
-
-                ret = JACOBI_ERR_MALLOC;
+            m_err = matrix_file_in(grid.matrix, option_values->input_fname);
+            if (m_err == MAT_ERR_NONE) {
+                j_err = ooc_solve(&grid, &opts, option_values->ooc_steps, \
+                    &rs, &io);
+                if (j_err != JACOBI_ERR_NONE) {
+                    jacobi_perror(j_err, prog_name);
+                    ret = -1;
+                }
+                else {
+                    m_err = matrix_file_out(grid.matrix, \
+                        option_values->output_fname);
+                }
             }
-            else {
-                errno = 0;
-                *subtask_args = malloc(sizeof(subtask_arg_t) * subtask_num);
-                if (*subtask_args == NULL) {
-                    matrix_delete(matrix_a);
-                    matrix_delete(matrix_b);
-                    free(*threads);
-
-                    ret = JACOBI_ERR_MALLOC;
+            if (m_err != MAT_ERR_NONE) {
+                mat_perror(m_err, prog_name);
+                ret = -1;
+            }
+            else if (ret == 0) {
+                unsigned long cells = (mask != NULL) ? mask->active_cells : \
+                    (unsigned long)(MATRIX_ROWS-2) * (MATRIX_COLS-2);
+                roofline_compute(&rl, cells, rs.iterations, opts.stencil, \
+                    conv_timespec_to_ms(&(rs.runtime_real)), stream_gbs);
+                if (option_values->print_format == PRINT_JSON) {
+                    print_results_json(NULL, &opts, &rs, &io, &rl, \
+                        option_values->roofline, NULL);
                 }
                 else {
-                    *subtask_bounds = malloc(sizeof(matrix_partition_t) * \
-                        subtask_num);
-                    if (*subtask_bounds == NULL) {
-                        matrix_delete(matrix_a);
-                        matrix_delete(matrix_b);
-                        free(*threads);
-                        free(*subtask_args);
-
-                        ret = JACOBI_ERR_MALLOC;
-                    }
+                    print_results_csv(NULL, &opts, &rs, &io, &rl, \
+                        option_values->roofline, NULL);
                 }
             }
+            ooc_grid_close(&grid);
+            unlink(grid_fname);
         }
+        free(grid_fname);
     }
     return ret;
 }
 
 /**
- * Starts the algorithm. Allocates everything and handles lots of random errors.
+ * Re-solves the input, a solution, after the --resolve edits (see incr.h) and
+ *   writes the result to the output file. Prints a CSV line with no newline:
+ *   iterations,real-time(ms),cpu-time(ms),dirty tiles,tiles,
  */
-jacobi_err jacobi_iterator(double (*input_matrix)[MATRIX_COLS], \
-        double (**output_matrix)[MATRIX_COLS], barrier_e barrier_id, \
-        unsigned subtask_num, struct runtime_stats *rs) {
-
-    assert(input_matrix != NULL);
-    assert(output_matrix != NULL);
-    assert(rs != NULL);
-
-    double (*matrix_a)[MATRIX_COLS];
-    double (*matrix_b)[MATRIX_COLS];
+int incr_solve_and_write(option_values_t *option_values, \
+        double (*input_matrix)[MATRIX_STRIDE], mask_t *mask, char *prog_name) {
+    jacobi_opts_t opts;
+    struct runtime_stats rs;
+    incr_edit_t *edits;
+    unsigned edit_num, dirty_tiles;
 
-    pthread_t *threads;
-    subtask_arg_t *subtask_args;
-    matrix_partition_t *subtask_bounds;
+    mat_err m_err = MAT_ERR_NONE;
+    jacobi_err j_err = JACOBI_ERR_NONE;
+    int ret = 0;
 
-    jacobi_err ret;
+    jacobi_opts_default(&opts);
+    opts.mask = mask;
+    opts.stencil = stencil_get(option_values->stencil_id);
 
-    if (barrier_init(&subtask_done_barrier, barrier_id, subtask_num + 1, &threads) < 0
-     || barrier_init(&subtask_wait_barrier, barrier_id, subtask_num + 1, &threads) < 0) {
-         ret = JACOBI_ERR_BARRIER_INIT;
+    m_err = incr_edits_file_in(&edits, &edit_num, option_values->edits_fname);
+    if (m_err != MAT_ERR_NONE) {
+        mat_perror(m_err, prog_name);
+        ret = -1;
     }
     else {
-        ret = jacobi_iteration_mem_init(input_matrix, &matrix_a, &matrix_b, \
-            &threads, &subtask_args, &subtask_bounds, subtask_num);
-        if (ret == JACOBI_ERR_NONE) {
-            matrix_partitions(subtask_bounds, subtask_num);
-            for (unsigned i = 0; i < subtask_num; i++) {
-                subtask_args[i].matrix_a = matrix_a;
-                subtask_args[i].matrix_b = matrix_b;
-                subtask_args[i].subtask_bounds = &(subtask_bounds[i]);
+        j_err = incr_solve(input_matrix, &opts, edits, edit_num, &rs, \
+            &dirty_tiles);
+        if (j_err != JACOBI_ERR_NONE) {
+            jacobi_perror(j_err, prog_name);
+            ret = -1;
+        }
+        else {
+            m_err = matrix_file_out(input_matrix, option_values->output_fname);
+            if (m_err != MAT_ERR_NONE) {
+                mat_perror(m_err, prog_name);
+                ret = -1;
             }
-            
-            ret = time_jacobi_iteration(threads, subtask_args, subtask_num, rs);
-
-            if (ret == JACOBI_ERR_NONE) {
-                if (read_a_write_b) {
-                    matrix_delete(&matrix_a);
-                    *output_matrix = matrix_b;
-                }
-                else {
-                    matrix_delete(&matrix_b);
-                    *output_matrix = matrix_a;
-                }
+            else {
+                printf("%d,%.10e,%.10e,%u,%u,", rs.iterations, \
+                    conv_timespec_to_ms(&(rs.runtime_real)), \
+                    conv_timespec_to_ms(&(rs.runtime_cpu_process)), \
+                    dirty_tiles, INCR_TILES);
             }
-            free(threads);
-            free(subtask_args);
-            barrier_delete(&subtask_done_barrier);
-            barrier_delete(&subtask_wait_barrier);
         }
+        free(edits);
     }
     return ret;
 }
 
 /**
- * Simple error output for any mat_err
- * All of the errors have associated errno values, so perror is called 
- *   directly.
+ * Solves every problem of the --multi list at once, interleaved, with the
+ *   --mask of the command line as the geometry of all of them.
  */
-void mat_perror(mat_err err, char *prog_name) {
-    printf("%s: mat_err: ", prog_name);
-    perror(NULL);
+int multi_solve_and_write(option_values_t *option_values, mask_t *mask, \
+        char *prog_name) {
+    jacobi_opts_t opts;
+    int ret = 0;
+
+    jacobi_opts_default(&opts);
+    opts.barrier_id = option_values->barrier_id;
+    opts.subtask_num = option_values->subtask_num;
+    opts.mask = mask;
+    opts.stencil = stencil_get(option_values->stencil_id);
+
+    if (multi_run(option_values->multi_fname, &opts) < 0) {
+        printf("%s: multi: ", prog_name);
+        perror(NULL);
+        ret = -1;
+    }
+    return ret;
 }
 
 /**
- * Simple error output for any jacobi_err
- * All of the errors have associated errno values, so perror is called 
- *   directly.
- */ 
-void jacobi_perror(jacobi_err err, char *prog_name) {
-    printf("%s: jacobi_err: ", prog_name);
-    perror(NULL);
+ * Runs the --sweep on input_matrix and writes its table to the output file.
+ *   Every option but the barrier and subtasks applies to all of its runs.
+ *   Prints a CSV line with no newline: runs,failed runs,
+ */
+int sweep_solve_and_write(option_values_t *option_values, \
+        double (*input_matrix)[MATRIX_STRIDE], mask_t *mask, char *prog_name) {
+    jacobi_opts_t opts;
+    sweep_t *sweep = &(option_values->sweep);
+    unsigned failed = 0;
+    int ret = 0;
+
+    jacobi_opts_default(&opts);
+    opts.mask = mask;
+    opts.stencil = stencil_get(option_values->stencil_id);
+    opts.sync = option_values->sync;
+    opts.check_interval = option_values->check_interval;
+    opts.in_place = option_values->in_place;
+    opts.accel = option_values->accel;
+    opts.active = option_values->active;
+    opts.fibers = option_values->fibers;
+    opts.rebalance = option_values->rebalance;
+    opts.deadline_ms = option_values->deadline_ms;
+
+    if (sweep_run(sweep, &opts, input_matrix, option_values->output_fname, \
+            &failed) < 0) {
+        printf("%s: sweep: ", prog_name);
+        perror(NULL);
+        ret = -1;
+    }
+    else {
+        printf("%u,%u,", sweep->barrier_num * sweep->thread_num * \
+            sweep->samples, failed);
+        if (failed > 0) {
+            ret = -1;
+        }
+    }
+    return ret;
 }
 
 /**
  * Parses options, reads input, runs the algorithm, writes output.
+ * --mem-stats prints the allocation counts last, once everything has been
+ *   freed, so any bytes still live there have leaked.
  */
 int main(int argc, char **argv) {
     option_values_t option_values;
 
-    double (*input_matrix)[MATRIX_COLS];
-    double (*output_matrix)[MATRIX_COLS];
-
-    struct runtime_stats rs;
+    double (*input_matrix)[MATRIX_STRIDE];
+    mask_t mask;
+    mask_t *mask_p = NULL;
 
     mat_err m_err = MAT_ERR_NONE;
-    jacobi_err j_err = JACOBI_ERR_NONE;
     int ret = 0;
 
     if (get_option_values(argv, &option_values) < 0) {
         printf("Invalid arguments\n");
-        printf("Usage: %s --[barrier][0-2] --[input][\"file name\"] "\
-            "--[output][\"file name\"] --[subtasks][n]\n", argv[0]);
-        printf("All the above arguments are required\n");
+        printf("Usage: %s --[barrier][0-3] --[input][\"file name\"] "\
+            "--[output][\"file name\"] --[subtasks][n] "\
+            "(--[mask][\"file name\"]) (--[stencil][5|9]) "\
+            "(--[hugepages][0-2]) (--[compress][0-1]) (--[sync][0-2]) "\
+            "(--[interval][n]) (--[roofline][0-1]) (--[format][csv|json]) "\
+            "(--[inplace][0-1]) (--[outofcore][steps]) (--[stats][0-1]) "\
+            "(--[accel][0-1]) (--[deadline-ms][n]) (--[plan][0-1]) "\
+            "(--[active][0-1]) (--[fibers][0-1]) (--[rebalance][0-1]) "\
+            "(--[mem-stats][0-1])\n", argv[0]);
+        printf("   or: %s --[barrier][0-3] --[input][\"solution file\"] "\
+            "--[output][\"file name\"] --[subtasks][n] "\
+            "--[resolve][\"edits file\"] (--[mask][\"file name\"]) "\
+            "(--[stencil][5|9]) (--[hugepages][0-2]) (--[compress][0-1]) "\
+            "(--[mem-stats][0-1])\n", argv[0]);
+        printf("   or: %s --[barrier][0-3] --[batch][\"file name\"] "\
+            "--[subtasks][n] (--[stencil][5|9]) (--[hugepages][0-2]) "\
+            "(--[compress][0-1]) (--[mem-stats][0-1])\n", argv[0]);
+        printf("   or: %s --[barrier][0-3] --[multi][\"file name\"] "\
+            "--[subtasks][n] (--[mask][\"file name\"]) (--[stencil][5|9]) "\
+            "(--[hugepages][0-2]) (--[compress][0-1]) (--[mem-stats][0-1])\n", \
+            argv[0]);
+        printf("   or: %s --[sweep][\"spec\"] --[input][\"file name\"] "\
+            "--[output][\"table file\"] (--[mask][\"file name\"]) "\
+            "(--[stencil][5|9]) (--[hugepages][0-2]) (--[sync][0-2]) "\
+            "(--[interval][n]) (--[inplace][0-1]) (--[accel][0-1]) "\
+            "(--[active][0-1]) (--[fibers][0-1]) (--[rebalance][0-1]) "\
+            "(--[deadline-ms][n]) (--[mem-stats][0-1])\n", argv[0]);
+        printf("All the above arguments are required, except those in ()\n");
         ret = -1;
     }
+    else if (option_values.batch_fname != NULL) {
+        unsigned failed = 0;
+        matrix_alloc_mode(option_values.alloc_mode);
+        matrix_out_format(option_values.out_format);
+        if (batch_run(option_values.batch_fname, option_values.barrier_id, \
+                option_values.subtask_num, \
+                stencil_get(option_values.stencil_id), &failed) < 0) {
+            printf("%s: batch: ", argv[0]);
+            perror(NULL);
+            ret = -1;
+        }
+        else if (failed > 0) {
+            ret = -1;
+        }
+    }
     else {
-        m_err = matrix_init(&input_matrix);
+        matrix_alloc_mode(option_values.alloc_mode);
+        matrix_out_format(option_values.out_format);
+        if (option_values.mask_fname != NULL) {
+            m_err = mask_file_in(&mask, option_values.mask_fname);
+            if (m_err == MAT_ERR_NONE) {
+                mask_p = &mask;
+            }
+        }
         if (m_err != MAT_ERR_NONE) {
             mat_perror(m_err, argv[0]);
             ret = -1;
         }
+        else if (option_values.multi_fname != NULL) {
+            ret = multi_solve_and_write(&option_values, mask_p, argv[0]);
+        }
+        else if (option_values.ooc_steps > 0) {
+            ret = ooc_solve_and_write(&option_values, mask_p, argv[0]);
+        }
         else {
-            m_err = matrix_file_in(input_matrix, option_values.input_fname);
+            m_err = matrix_init(&input_matrix);
             if (m_err != MAT_ERR_NONE) {
                 mat_perror(m_err, argv[0]);
                 ret = -1;
             }
             else {
-                j_err = jacobi_iterator(input_matrix, &output_matrix, \
-                    option_values.barrier_id, option_values.subtask_num, &rs);
-                if (j_err != JACOBI_ERR_NONE) {
-                    jacobi_perror(j_err, argv[0]);
+                m_err = matrix_file_in(input_matrix, option_values.input_fname);
+                if (m_err != MAT_ERR_NONE) {
+                    mat_perror(m_err, argv[0]);
                     ret = -1;
                 }
+                else if (option_values.sweep_spec != NULL) {
+                    ret = sweep_solve_and_write(&option_values, input_matrix, \
+                        mask_p, argv[0]);
+                }
+                else if (option_values.edits_fname != NULL) {
+                    ret = incr_solve_and_write(&option_values, input_matrix, \
+                        mask_p, argv[0]);
+                }
                 else {
-                    m_err = matrix_file_out(output_matrix, \
-                        option_values.output_fname);
-                    if (m_err != MAT_ERR_NONE) {
-                        mat_perror(m_err, argv[0]);
-                        ret = -1;
-                    }
-                    else {
-                        printf("%d,%.10e,%.10e,", rs.iterations, \
-                            conv_timespec_to_ms(&(rs.runtime_real)), \
-                            conv_timespec_to_ms(&(rs.runtime_cpu_process)));
-                    }
-                    free(input_matrix);
-                    free(output_matrix);
+                    ret = solve_and_write(&option_values, input_matrix, \
+                        mask_p, argv[0]);
                 }
+                matrix_delete(&input_matrix);
             }
         }
+        if (mask_p != NULL) {
+            mask_delete(mask_p);
+        }
+    }
+    if (ret == 0 && option_values.mem_stats) {
+        mem_stats_print(stdout);
     }
     return ret;
 }
@@ -0,0 +1,171 @@
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+
+// Time between refreshes in ms, unless one is given
+#define TOP_INTERVAL_MS 500
+// Where POSIX shared memory segments show up
+#define TOP_SHM_DIR "/dev/shm"
+
+/**
+ * Finds a running solve from the stats segments in TOP_SHM_DIR. Segments left
+ *   behind by solves that died are skipped.
+ * Returns its pid, or 0 if there is none.
+ */
+pid_t top_find_pid(void) {
+    const char *prefix = STATS_SHM_PREFIX + 1;
+    pid_t pid = 0;
+
+    DIR *dir = opendir(TOP_SHM_DIR);
+    if (dir != NULL) {
+        struct dirent *entry;
+        while (pid == 0 && (entry = readdir(dir)) != NULL) {
+            if (strncmp(entry->d_name, prefix, strlen(prefix)) == 0) {
+                pid_t found = (pid_t)strtol(entry->d_name + strlen(prefix), \
+                    NULL, 10);
+                if (found > 0 && kill(found, 0) == 0) {
+                    pid = found;
+                }
+            }
+        }
+        closedir(dir);
+    }
+    return pid;
+}
+
+/**
+ * Share of a time in a total, as a percentage.
+ */
+double top_pct(uint64_t part, uint64_t total) {
+    return (total > 0) ? 100.0 * part / total : 0.0;
+}
+
+/**
+ * Prints one refresh. Rates are over the time since the last snapshot, or over
+ *   the whole solve on the first one, and so are the busy and wait shares.
+ */
+void top_print(stats_header_t *header, stats_thread_t *threads, \
+        stats_header_t *last, stats_thread_t *last_threads, bool clear) {
+    double elapsed = (header->update_ns - header->start_ns) / 1e9;
+    double interval = (header->update_ns - last->update_ns) / 1e9;
+    unsigned iterations = header->iterations - last->iterations;
+    double rate = (interval > 0.0) ? iterations / interval : 0.0;
+
+    if (clear) {
+        printf("\033[H\033[J");
+    }
+    printf("jacobi_top - pid %d, %u threads, %.2f s, %s\n", header->pid, \
+        header->thread_num, elapsed, \
+        (header->state == STATS_DONE) ? "done" : "running");
+    printf("iterations %u  it/s %.1f  Mcells/s %.1f  delta %.4e  "\
+        "epsilon %.4e\n", header->iterations, rate, \
+        rate * header->cells / 1e6, header->delta_max, header->epsilon);
+    printf("%6s %10s %10s %7s %7s %12s\n", "thread", "iterations", "it/s", \
+        "busy%", "wait%", "delta");
+    for (unsigned i = 0; i < header->thread_num; i++) {
+        uint64_t busy = threads[i].busy_ns - last_threads[i].busy_ns;
+        uint64_t wait = threads[i].wait_ns - last_threads[i].wait_ns;
+        double thread_interval = (busy + wait) / 1e9;
+        unsigned thread_iterations = threads[i].iterations - \
+            last_threads[i].iterations;
+        printf("%6u %10u %10.1f %7.1f %7.1f %12.4e\n", i, \
+            threads[i].iterations, (thread_interval > 0.0) ? \
+            thread_iterations / thread_interval : 0.0, \
+            top_pct(busy, busy + wait), top_pct(wait, busy + wait), \
+            threads[i].delta);
+    }
+    fflush(stdout);
+}
+
+/**
+ * Attaches to a running solve and shows its progress until it finishes or
+ *   its process goes away. Waits for the solve to set up its stats if it has
+ *   not yet. Without a pid, picks any running solve.
+ * The screen is only cleared between refreshes on a terminal, otherwise every
+ *   refresh is appended.
+ */
+int main(int argc, char **argv) {
+    stats_t stats;
+    stats_header_t header, last;
+    stats_thread_t *threads, *last_threads;
+    unsigned interval_ms = TOP_INTERVAL_MS;
+    pid_t pid = 0;
+    int ret = 0;
+
+    if (argc > 3) {
+        printf("Usage: %s (pid) (interval ms)\n", argv[0]);
+        ret = -1;
+    }
+    else {
+        if (argc > 1) {
+            pid = (pid_t)strtol(argv[1], NULL, 10);
+        }
+        else {
+            pid = top_find_pid();
+        }
+        if (argc > 2) {
+            interval_ms = (unsigned)strtoul(argv[2], NULL, 10);
+        }
+        struct timespec wait = {interval_ms / 1000, \
+            (interval_ms % 1000) * 1000000L};
+
+        if (pid <= 0) {
+            printf("%s: no running solve found\n", argv[0]);
+            ret = -1;
+        }
+        else {
+            int attached = stats_attach(&stats, pid);
+            while (attached < 0 && (errno == ENOENT || errno == EAGAIN) && \
+                    kill(pid, 0) == 0) {
+                nanosleep(&wait, NULL);
+                attached = stats_attach(&stats, pid);
+            }
+            if (attached < 0) {
+                printf("%s: ", argv[0]);
+                perror(NULL);
+                ret = -1;
+            }
+            else {
+                unsigned thread_num = stats.header->thread_num;
+                threads = calloc(thread_num, sizeof(stats_thread_t));
+                last_threads = calloc(thread_num, sizeof(stats_thread_t));
+                if (threads == NULL || last_threads == NULL) {
+                    printf("%s: ", argv[0]);
+                    perror(NULL);
+                    ret = -1;
+                }
+                else {
+                    bool clear = isatty(STDOUT_FILENO);
+                    bool running = true;
+                    // The first refresh covers the whole solve so far
+                    stats_read(&stats, &last, threads);
+                    last.iterations = 0;
+                    last.update_ns = last.start_ns;
+                    while (running) {
+                        stats_read(&stats, &header, threads);
+                        top_print(&header, threads, &last, last_threads, \
+                            clear);
+                        running = (header.state != STATS_DONE && \
+                            kill(pid, 0) == 0);
+                        if (running) {
+                            last = header;
+                            memcpy(last_threads, threads, \
+                                sizeof(stats_thread_t) * thread_num);
+                            nanosleep(&wait, NULL);
+                        }
+                    }
+                }
+                free(threads);
+                free(last_threads);
+                stats_detach(&stats);
+            }
+        }
+    }
+    return ret;
+}
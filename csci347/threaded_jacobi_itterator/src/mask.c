@@ -0,0 +1,132 @@
+#include "mask.h"
+#include "mem_stats.h"
+
+/**
+ * Reads a mask from a file. The mask file uses the same format as a matrix
+ *   file, so it is sampled the same way as the input matrix. A cell holding
+ *   0.0 is free, any other value marks the cell as fixed.
+ */
+mat_err mask_file_in(mask_t *mask, char *mask_fname) {
+    double (*mask_matrix)[MATRIX_STRIDE];
+    mat_err ret = MAT_ERR_NONE;
+
+    ret = matrix_init(&mask_matrix);
+    if (ret == MAT_ERR_NONE) {
+        ret = matrix_file_in(mask_matrix, mask_fname);
+        if (ret == MAT_ERR_NONE) {
+            ret = mask_init(mask, mask_matrix);
+        }
+        matrix_delete(&mask_matrix);
+    }
+    return ret;
+}
+
+/**
+ * Builds the runs of free cells from a mask matrix. The outer boundary of the
+ *   matrix is always fixed, whatever the mask says.
+ * The first pass only counts the spans so they can be allocated in one go, the
+ *   second pass fills them in.
+ */
+mat_err mask_init(mask_t *mask, double (*mask_matrix)[MATRIX_STRIDE]) {
+    mat_err ret = MAT_ERR_NONE;
+
+    assert(mask != NULL);
+    unsigned span_num = 0;
+    for (unsigned row = 1; row < MATRIX_ROWS-1; row++) {
+        bool in_span = false;
+        for (unsigned col = 1; col < MATRIX_COLS-1; col++) {
+            bool free_cell = (mask_matrix[row][col] == 0.0);
+            if (free_cell && !in_span) {
+                span_num++;
+            }
+            in_span = free_cell;
+        }
+    }
+
+    errno = 0;
+    mask->spans = mem_alloc(MEM_MASK, sizeof(mask_span_t) * \
+        (span_num > 0 ? span_num : 1));
+    if (mask->spans == NULL) {
+        ret = MAT_ERR_MALLOC;
+    }
+    else {
+        unsigned span = 0;
+        mask->active_cells = 0;
+        mask->row_spans[0] = 0;
+        for (unsigned row = 0; row < MATRIX_ROWS; row++) {
+            if (row > 0 && row < MATRIX_ROWS-1) {
+                unsigned col = 1;
+                while (col < MATRIX_COLS-1) {
+                    if (mask_matrix[row][col] != 0.0) {
+                        col++;
+                    }
+                    else {
+                        mask->spans[span].col_start = col;
+                        while (col < MATRIX_COLS-1 && \
+                                mask_matrix[row][col] == 0.0) {
+                            col++;
+                        }
+                        mask->spans[span].col_end = col;
+                        mask->active_cells += col - \
+                            mask->spans[span].col_start;
+                        span++;
+                    }
+                }
+            }
+            mask->row_spans[row+1] = span;
+        }
+        assert(span == span_num);
+        mask->span_num = span_num;
+    }
+    return ret;
+}
+
+/**
+ * Deletes a mask's spans and points them to NULL.
+ */
+void mask_delete(mask_t *mask) {
+    mem_free(MEM_MASK, mask->spans);
+    mask->spans = NULL;
+}
+
+/**
+ * Partitions a masked matrix by rows so that every partition gets roughly the
+ *   same number of active cells rather than the same number of rows.
+ * Partition i ends at the first row where the running count of active cells
+ *   reaches (i+1)/partitions_c of the total, as long as enough rows are left
+ *   over to give every remaining partition at least one row.
+ */
+void mask_partitions(matrix_partition_t *partitions, unsigned partitions_c, \
+        mask_t *mask) {
+    assert(partitions_c <= MATRIX_ROWS-2);
+
+    unsigned long row_cells, cells = 0;
+    unsigned row = 1;
+    unsigned partition_i = 0;
+    while (partition_i < partitions_c) {
+        partitions[partition_i].col_start = 1;
+        partitions[partition_i].col_end   = MATRIX_COLS-1;
+        partitions[partition_i].row_start = row;
+
+        unsigned long target = mask->active_cells * (partition_i+1) / \
+            partitions_c;
+        unsigned rows_left = partitions_c - partition_i - 1;
+        do {
+            row_cells = 0;
+            for (unsigned span = mask->row_spans[row]; \
+                    span < mask->row_spans[row+1]; span++) {
+                row_cells += mask->spans[span].col_end - \
+                    mask->spans[span].col_start;
+            }
+            cells += row_cells;
+            row++;
+        } while (cells < target && row < MATRIX_ROWS-1-rows_left);
+
+        if (partition_i == partitions_c-1) {
+            row = MATRIX_ROWS-1;
+        }
+        partitions[partition_i].row_end = row;
+        partition_i++;
+    }
+    assert(row == MATRIX_ROWS-1);
+}
@@ -0,0 +1,32 @@
+#ifndef __MASK_H
+#define __MASK_H
+#include "matrix.h"
+
+// A run of free cells in a single row. Covers the columns [col_start, col_end)
+typedef struct mask_span mask_span_t;
+struct mask_span {
+    unsigned col_start;
+    unsigned col_end;
+};
+
+// Compressed mask of the free cells of a matrix. Free cells are stored as
+//   runs per row, so the spans of row r are spans[row_spans[r]] up to (but not
+//   including) spans[row_spans[r+1]]. Every cell outside a span is fixed.
+typedef struct mask mask_t;
+struct mask {
+    mask_span_t *spans;
+    unsigned row_spans[MATRIX_ROWS+1];
+    unsigned span_num;
+    unsigned long active_cells;
+};
+
+// Mask creation/deletion
+mat_err mask_file_in(mask_t *mask, char *mask_fname);
+mat_err mask_init(mask_t *mask, double (*mask_matrix)[MATRIX_STRIDE]);
+void mask_delete(mask_t *mask);
+
+// Mask partitioning
+void mask_partitions(matrix_partition_t *partitions, unsigned partitions_c, \
+    mask_t *mask);
+
+#endif /* __MASK_H */
@@ -1,29 +1,113 @@
 #include "matrix.h"
+#include "pyramid.h"
+#include "compress.h"
+#include "mem_stats.h"
+
+// Allocator used by matrix_init and matrix_delete
+static mat_alloc_e mat_alloc = MAT_ALLOC_ALIGNED;
+// Format written by matrix_file_out
+static mat_format_e mat_format = MAT_FORMAT_TEXT;
+
+/**
+ * Picks how matrices are allocated. Must be called before any matrix is
+ *   allocated, since matrix_delete frees with the current mode.
+ */
+void matrix_alloc_mode(mat_alloc_e mode) {
+    assert(mode < MAT_ALLOC_TOTAL);
+    mat_alloc = mode;
+}
+
+/**
+ * Picks the format matrix_file_out writes.
+ */
+void matrix_out_format(mat_format_e format) {
+    assert(format < MAT_FORMAT_TOTAL);
+    mat_format = format;
+}
+
+/**
+ * Maps memory for a matrix that starts on a huge page boundary, and asks for
+ *   it to be backed by transparent huge pages. mmap only guarantees small page
+ *   alignment, so an extra huge page is mapped and the ends are trimmed off.
+ */
+void *matrix_map_thp(size_t bytes) {
+    void *map = mmap(NULL, bytes + MATRIX_HUGE_PAGE, PROT_READ | PROT_WRITE, \
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        map = NULL;
+    }
+    else {
+        size_t head = (MATRIX_HUGE_PAGE - ((size_t)map % MATRIX_HUGE_PAGE)) % \
+            MATRIX_HUGE_PAGE;
+        if (head > 0) {
+            munmap(map, head);
+        }
+        munmap((char*)map + head + bytes, MATRIX_HUGE_PAGE - head);
+        map = (char*)map + head;
+
+        // Only advice, the mapping works without huge pages too
+        madvise(map, bytes, MADV_HUGEPAGE);
+    }
+    return map;
+}
 
 /**
- * Initializes a matrix. Simple stuff.
+ * Initializes a matrix. Rows are MATRIX_STRIDE long and 64 byte aligned.
+ * Depending on the allocation mode the memory comes from posix_memalign, a
+ *   transparent huge page mapping, or explicit huge pages (which fails if the
+ *   system has none reserved). Whatever it comes from is counted as matrix
+ *   memory, mappings by the whole huge pages they take.
  */
-mat_err matrix_init(double (**matrix)[MATRIX_COLS]) {
+mat_err matrix_init(double (**matrix)[MATRIX_STRIDE]) {
     mat_err ret = MAT_ERR_NONE;
+    size_t huge_bytes = (MATRIX_BYTES + MATRIX_HUGE_PAGE - 1) / \
+        MATRIX_HUGE_PAGE * MATRIX_HUGE_PAGE;
+    void *map;
+    int err;
 
     assert(matrix != NULL);
     errno = 0;
-    *matrix = malloc(sizeof(double) * MATRIX_ROWS * MATRIX_COLS);
+    switch (mat_alloc) {
+    case MAT_ALLOC_ALIGNED:
+        err = posix_memalign((void**)matrix, MATRIX_ALIGN, MATRIX_BYTES);
+        if (err > 0) {
+            errno = err;
+            *matrix = NULL;
+        }
+        break;
+    case MAT_ALLOC_THP:
+        *matrix = matrix_map_thp(huge_bytes);
+        break;
+    case MAT_ALLOC_HUGETLB:
+        map = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE, \
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        *matrix = (map == MAP_FAILED) ? NULL : map;
+        break;
+    case MAT_ALLOC_TOTAL:
+        abort();
+        break;
+    default:
+        abort();
+    }
     if (*matrix == NULL) {
         ret = MAT_ERR_MALLOC;
     }
+    else {
+        mem_count_alloc(MEM_MATRIX, (mat_alloc == MAT_ALLOC_ALIGNED) ? \
+            MATRIX_BYTES : huge_bytes);
+    }
     return ret;
 }
 
 /**
  * Initializes a matrix and sets its initial value.
  */
-mat_err matrix_init_value(double (**matrix)[MATRIX_COLS], \
-        double (*matrix_src)[MATRIX_COLS]) {
+mat_err matrix_init_value(double (**matrix)[MATRIX_STRIDE], \
+        double (*matrix_src)[MATRIX_STRIDE]) {
     mat_err ret = MAT_ERR_NONE;
     ret = matrix_init(matrix);
     if (ret == MAT_ERR_NONE) {
-        memcpy(*matrix, matrix_src, sizeof(double) * MATRIX_COLS * MATRIX_ROWS);
+        memcpy(*matrix, matrix_src, MATRIX_BYTES);
     }
     return ret;
 }
@@ -31,8 +115,20 @@ mat_err matrix_init_value(double (**matrix)[MATRIX_COLS], \
 /**
  * Deletes a matrix and points it to NULL.
  */
-void matrix_delete(double (**matrix)[MATRIX_COLS]) {
-    free(*matrix);
+void matrix_delete(double (**matrix)[MATRIX_STRIDE]) {
+    size_t huge_bytes = (MATRIX_BYTES + MATRIX_HUGE_PAGE - 1) / \
+        MATRIX_HUGE_PAGE * MATRIX_HUGE_PAGE;
+
+    if (*matrix != NULL) {
+        if (mat_alloc == MAT_ALLOC_ALIGNED) {
+            free(*matrix);
+            mem_count_free(MEM_MATRIX, MATRIX_BYTES);
+        }
+        else {
+            munmap(*matrix, huge_bytes);
+            mem_count_free(MEM_MATRIX, huge_bytes);
+        }
+    }
     *matrix = NULL;
 }
 
@@ -166,7 +262,26 @@ int getpow2(int n) {
 }
 
 /**
- * Gets a matrix from a file.
+ * Gets a matrix from a file, either a text matrix file, a pyramid file (see
+ *   pyramid.h) or a compressed file (see compress.h).
+ */
+mat_err matrix_file_in(double (*matrix)[MATRIX_STRIDE], char *input_fname) {
+    mat_err ret = MAT_ERR_NONE;
+
+    if (pyramid_file_check(input_fname)) {
+        ret = pyramid_file_in(matrix, input_fname);
+    }
+    else if (cmtx_file_check(input_fname)) {
+        ret = cmtx_file_in(matrix, input_fname);
+    }
+    else {
+        ret = matrix_text_file_in(matrix, input_fname);
+    }
+    return ret;
+}
+
+/**
+ * Gets a matrix from a text file.
  * Finds the relative scale of the matrix size to the full matrix size to
  *   determine how many rows and columns, if any, to skip.
  * To keep the end points, it divides up the space inbetween the first and last
@@ -174,7 +289,8 @@ int getpow2(int n) {
  *   of characters each float takes up and other horrible 
  *   hard-coded-considerations. (sorry)
  */
-mat_err matrix_file_in(double (*matrix)[MATRIX_COLS], char *input_fname) {
+mat_err matrix_text_file_in(double (*matrix)[MATRIX_STRIDE], \
+        char *input_fname) {
     FILE *input;
     mat_err ret = MAT_ERR_NONE;
 
@@ -232,9 +348,32 @@ mat_err matrix_file_in(double (*matrix)[MATRIX_COLS], char *input_fname) {
 }
 
 /**
- * Outputs a matrix to a file. Simple stuff.
+ * Outputs a matrix to a file in the format picked with matrix_out_format.
+ */
+mat_err matrix_file_out(double (*matrix)[MATRIX_STRIDE], char *output_fname) {
+    mat_err ret = MAT_ERR_NONE;
+
+    switch (mat_format) {
+    case MAT_FORMAT_TEXT:
+        ret = matrix_text_file_out(matrix, output_fname);
+        break;
+    case MAT_FORMAT_COMPRESSED:
+        ret = cmtx_file_out(matrix, output_fname);
+        break;
+    case MAT_FORMAT_TOTAL:
+        abort();
+        break;
+    default:
+        abort();
+    }
+    return ret;
+}
+
+/**
+ * Outputs a matrix to a text file. Simple stuff.
  */
-mat_err matrix_file_out(double (*matrix)[MATRIX_COLS], char *output_fname) {
+mat_err matrix_text_file_out(double (*matrix)[MATRIX_STRIDE], \
+        char *output_fname) {
     FILE *output;
     mat_err ret = MAT_ERR_NONE;
 
@@ -264,6 +403,47 @@ mat_err matrix_file_out(double (*matrix)[MATRIX_COLS], char *output_fname) {
     return ret;
 }
 
+/**
+ * Reads row_num rows starting at row_start of a full size matrix file into
+ *   rows, which holds row_num * MATRIX_COLS doubles. Every value takes exactly
+ *   COL_CHARS characters, so the rows are found with a single seek and several
+ *   threads can read different parts of the same file at once.
+ * buf must hold at least ROW_CHARS * row_num + 1 characters.
+ */
+mat_err matrix_file_read_rows(FILE *f, char *buf, double *rows, \
+        unsigned row_start, unsigned row_num) {
+    mat_err ret = MAT_ERR_NONE;
+    size_t chars = (size_t)ROW_CHARS * row_num;
+
+    assert(MATRIX_COLS == MATRIX_COLS_FULL);
+    errno = 0;
+    if (fseek(f, (long)ROW_CHARS * row_start, SEEK_SET) < 0) {
+        ret = MAT_ERR_FSCANF;
+    }
+    else if (fread(buf, 1, chars, f) != chars) {
+        if (errno == 0) {
+            errno = EIO;
+        }
+        ret = MAT_ERR_FSCANF;
+    }
+    else {
+        buf[chars] = '\0';
+        char *pos = buf;
+        char *end;
+        size_t i = 0;
+        while (i < (size_t)MATRIX_COLS * row_num && ret == MAT_ERR_NONE) {
+            rows[i] = strtod(pos, &end);
+            if (end == pos) {
+                errno = EILSEQ;
+                ret = MAT_ERR_FSCANF;
+            }
+            pos = end;
+            i++;
+        }
+    }
+    return ret;
+}
+
 /**
  * Skips the number of rows in a matrix file.
  */
@@ -7,10 +7,16 @@
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <sys/mman.h>
 
-// Full matrix size
+// Full matrix size, the size text input files have to be. Can be set at build
+//   time to solve other sizes, see MATRIX_SIZE in the makefile.
+#ifndef MATRIX_ROWS_FULL
 #define MATRIX_ROWS_FULL 1024
+#endif
+#ifndef MATRIX_COLS_FULL
 #define MATRIX_COLS_FULL 1024
+#endif
 
 // Size of the actual matrix
 // The barrier test has a smaller matrix size, otherwise the full barrier is
@@ -19,10 +25,24 @@
 #define MATRIX_ROWS 66
 #define MATRIX_COLS 66
 #else
-#define MATRIX_ROWS 1024
-#define MATRIX_COLS 1024
+#define MATRIX_ROWS MATRIX_ROWS_FULL
+#define MATRIX_COLS MATRIX_COLS_FULL
 #endif
 
+// Leading dimension of a matrix in memory. Rows are padded to a whole number of
+//   cache lines so every row starts 64 byte aligned. If that makes twice the
+//   row stride a multiple of 4 KiB, one more cache line is added so the rows
+//   above and below a cell, two strides apart, don't map to the same cache
+//   sets (1024 doubles would be exactly 8 KiB, 256 doubles put the rows
+//   around a cell exactly 4 KiB apart).
+#define MATRIX_ALIGN 64
+#define MATRIX_COLS_ALIGNED ((MATRIX_COLS + 7) / 8 * 8)
+#define MATRIX_STRIDE (MATRIX_COLS_ALIGNED + \
+    ((MATRIX_COLS_ALIGNED % 256 == 0) ? 8 : 0))
+#define MATRIX_BYTES (sizeof(double) * MATRIX_ROWS * MATRIX_STRIDE)
+// Huge page size used to round up mappings for the huge page allocators
+#define MATRIX_HUGE_PAGE (2UL * 1024UL * 1024UL)
+
 // Defines for variable-size matrix input
 #define COL_CHARS 13
 #define ROW_CHARS ((COL_CHARS * MATRIX_COLS_FULL) + 1)
@@ -37,6 +57,23 @@ enum mat_err {
     MAT_ERR_FPRINTF
 };
 
+// How matrices are allocated. Set once, before any matrix is allocated.
+typedef enum mat_alloc_e mat_alloc_e;
+enum mat_alloc_e {
+    MAT_ALLOC_ALIGNED = 0,
+    MAT_ALLOC_THP     = 1,
+    MAT_ALLOC_HUGETLB = 2,
+    MAT_ALLOC_TOTAL   = 3
+};
+
+// Format written by matrix_file_out. Reading detects the format by itself.
+typedef enum mat_format_e mat_format_e;
+enum mat_format_e {
+    MAT_FORMAT_TEXT       = 0,
+    MAT_FORMAT_COMPRESSED = 1,
+    MAT_FORMAT_TOTAL      = 2
+};
+
 // The partition type
 typedef struct matrix_partition matrix_partition_t;
 struct matrix_partition {
@@ -47,10 +84,12 @@ struct matrix_partition {
 };
 
 // Matrix creation/deletion
-mat_err matrix_init(double (**matrix)[MATRIX_COLS]);
-mat_err matrix_init_value(double (**matrix)[MATRIX_COLS], \
-    double (*matrix_src)[MATRIX_COLS]);
-void matrix_delete(double (**matrix)[MATRIX_COLS]);
+void matrix_alloc_mode(mat_alloc_e mode);
+void matrix_out_format(mat_format_e format);
+mat_err matrix_init(double (**matrix)[MATRIX_STRIDE]);
+mat_err matrix_init_value(double (**matrix)[MATRIX_STRIDE], \
+    double (*matrix_src)[MATRIX_STRIDE]);
+void matrix_delete(double (**matrix)[MATRIX_STRIDE]);
 
 // Matrix partitioning
 void matrix_partitions(matrix_partition_t *partitions, \
@@ -64,8 +103,14 @@ bool ispow2(int n);
 int getpow2(int n);
 
 // Matrix file operations
-mat_err matrix_file_in(double (*matrix)[MATRIX_COLS], char *input_fname);
-mat_err matrix_file_out(double (*matrix)[MATRIX_COLS], char *output_fname);
+mat_err matrix_file_in(double (*matrix)[MATRIX_STRIDE], char *input_fname);
+mat_err matrix_text_file_in(double (*matrix)[MATRIX_STRIDE], \
+    char *input_fname);
+mat_err matrix_file_out(double (*matrix)[MATRIX_STRIDE], char *output_fname);
+mat_err matrix_text_file_out(double (*matrix)[MATRIX_STRIDE], \
+    char *output_fname);
+mat_err matrix_file_read_rows(FILE *f, char *buf, double *rows, \
+    unsigned row_start, unsigned row_num);
 mat_err skip_rows(FILE *f, unsigned skip);
 mat_err skip_cols(FILE *f, unsigned skip);
 
@@ -0,0 +1,132 @@
+#include "mem_stats.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+// Room in front of every counted allocation for its size. Big enough to keep
+//   the alignment malloc gives.
+#define MEM_HEADER 16
+
+// Counts of a subsystem, or of all of them
+typedef struct mem_counts mem_counts_t;
+struct mem_counts {
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long long bytes;
+    unsigned long long live;
+    unsigned long long peak;
+};
+
+static const char * const mem_subsys_names[MEM_TOTAL] = {"matrix", "mask", \
+    "solver"};
+static mem_counts_t mem_counts[MEM_TOTAL + 1];
+static mem_allocator_t mem_allocator = {malloc, free};
+
+/**
+ * Replaces the allocator.
+ */
+void mem_set_allocator(const mem_allocator_t *allocator) {
+    if (allocator != NULL) {
+        mem_allocator = *allocator;
+    }
+    else {
+        mem_allocator.alloc = malloc;
+        mem_allocator.free = free;
+    }
+}
+
+/**
+ * Raises peak to live if that is higher, racing any other thread doing the
+ *   same.
+ */
+static inline void mem_raise_peak(unsigned long long *peak, \
+        unsigned long long live) {
+    unsigned long long old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while (live > old && !__atomic_compare_exchange_n(peak, &old, live, \
+            true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * Counts bytes allocated by subsys, in it and in the total.
+ */
+void mem_count_alloc(mem_subsys_e subsys, size_t bytes) {
+    mem_counts_t *counts[2] = {&mem_counts[subsys], &mem_counts[MEM_TOTAL]};
+
+    for (unsigned i = 0; i < 2; i++) {
+        __atomic_add_fetch(&(counts[i]->allocs), 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&(counts[i]->bytes), bytes, __ATOMIC_RELAXED);
+        mem_raise_peak(&(counts[i]->peak), __atomic_add_fetch( \
+            &(counts[i]->live), bytes, __ATOMIC_RELAXED));
+    }
+}
+
+/**
+ * Counts bytes freed by subsys, in it and in the total.
+ */
+void mem_count_free(mem_subsys_e subsys, size_t bytes) {
+    mem_counts_t *counts[2] = {&mem_counts[subsys], &mem_counts[MEM_TOTAL]};
+
+    for (unsigned i = 0; i < 2; i++) {
+        __atomic_add_fetch(&(counts[i]->frees), 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&(counts[i]->live), bytes, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Allocates bytes for subsys from the allocator, with its size in front.
+ */
+void *mem_alloc(mem_subsys_e subsys, size_t bytes) {
+    void *ret = NULL;
+
+    char *block = mem_allocator.alloc(bytes + MEM_HEADER);
+    if (block != NULL) {
+        memcpy(block, &bytes, sizeof(size_t));
+        mem_count_alloc(subsys, bytes);
+        ret = block + MEM_HEADER;
+    }
+    return ret;
+}
+
+/**
+ * Allocates zeroed memory for num elements of size for subsys.
+ */
+void *mem_calloc(mem_subsys_e subsys, size_t num, size_t size) {
+    void *ret = mem_alloc(subsys, num * size);
+
+    if (ret != NULL) {
+        memset(ret, 0, num * size);
+    }
+    return ret;
+}
+
+/**
+ * Frees memory of subsys from mem_alloc. NULL is ignored, like free does.
+ */
+void mem_free(mem_subsys_e subsys, void *ptr) {
+    if (ptr != NULL) {
+        char *block = (char*)ptr - MEM_HEADER;
+        size_t bytes;
+        memcpy(&bytes, block, sizeof(size_t));
+        mem_count_free(subsys, bytes);
+        mem_allocator.free(block);
+    }
+}
+
+/**
+ * Prints the counts of every subsystem, then the totals.
+ */
+void mem_stats_print(FILE *f) {
+    struct rusage usage;
+
+    for (unsigned i = 0; i <= MEM_TOTAL; i++) {
+        mem_counts_t *c = &mem_counts[i];
+        fprintf(f, "\nmem,%s,%lu,%lu,%llu,%llu,%llu,", \
+            (i < MEM_TOTAL) ? mem_subsys_names[i] : "total", c->allocs, \
+            c->frees, c->bytes, c->live, c->peak);
+    }
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        fprintf(f, "%ld,", usage.ru_maxrss);
+    }
+}
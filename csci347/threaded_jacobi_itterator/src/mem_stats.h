@@ -0,0 +1,51 @@
+#ifndef __MEM_STATS_H
+#define __MEM_STATS_H
+#include <stdio.h>
+#include <stddef.h>
+
+// Allocation accounting
+// Every allocation of a subsystem either goes through mem_alloc and friends,
+//   which get their memory from the current allocator and count it, or, for
+//   memory the subsystem maps or aligns itself, is just counted with
+//   mem_count_alloc and mem_count_free. Counts are kept per subsystem: calls,
+//   frees, bytes allocated in all, bytes live and the high water mark of
+//   those, plus the high water mark of all of them together. Counting is
+//   atomic, so any thread can allocate.
+// The allocator is malloc and free unless it is replaced, which has to happen
+//   before anything is allocated through it.
+
+typedef enum mem_subsys_e mem_subsys_e;
+enum mem_subsys_e {
+    MEM_MATRIX = 0,
+    MEM_MASK   = 1,
+    MEM_SOLVER = 2,
+    MEM_TOTAL  = 3
+};
+
+typedef struct mem_allocator mem_allocator_t;
+struct mem_allocator {
+    void *(*alloc)(size_t bytes);
+    void (*free)(void *ptr);
+};
+
+// Replaces the allocator, NULL goes back to malloc and free.
+void mem_set_allocator(const mem_allocator_t *allocator);
+
+// Counted allocations. Like malloc, calloc and free, with errno set by the
+//   allocator on failure. Memory must be freed with the subsystem it was
+//   allocated with.
+void *mem_alloc(mem_subsys_e subsys, size_t bytes);
+void *mem_calloc(mem_subsys_e subsys, size_t num, size_t size);
+void mem_free(mem_subsys_e subsys, void *ptr);
+
+// Counts memory a subsystem got or gave back some other way.
+void mem_count_alloc(mem_subsys_e subsys, size_t bytes);
+void mem_count_free(mem_subsys_e subsys, size_t bytes);
+
+// Prints a CSV line per subsystem, each after a newline:
+//   mem,subsystem,allocs,frees,bytes allocated,bytes live,peak bytes,
+//   and one for all of them with the peak RSS of the process:
+//   mem,total,allocs,frees,bytes allocated,bytes live,peak bytes,peak RSS(KB),
+void mem_stats_print(FILE *f);
+
+#endif /* __MEM_STATS_H */
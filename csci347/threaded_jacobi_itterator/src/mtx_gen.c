@@ -0,0 +1,68 @@
+#include "gen.h"
+
+/**
+ * Writes a synthetic input matrix of any size.
+ * The size is one number for a square matrix or rowsxcols, the profile is one
+ *   of gen_profiles. The seed defaults to 0 and the format to text.
+ * Prints the size written in the form rows,cols.
+ */
+int main(int argc, char **argv) {
+    gen_opts_t opts;
+    char *end;
+    mat_err m_err = MAT_ERR_NONE;
+    int ret = 0;
+
+    opts.rows = 0;
+    opts.cols = 0;
+    opts.profile = GEN_TOTAL;
+    opts.seed = 0;
+    opts.format = MAT_FORMAT_TOTAL;
+    if (argc >= 4 && argc <= 6) {
+        opts.rows = (unsigned)strtoul(argv[2], &end, 10);
+        opts.cols = opts.rows;
+        if (*end == 'x') {
+            opts.cols = (unsigned)strtoul(end + 1, &end, 10);
+        }
+        if (*end != '\0') {
+            opts.rows = 0;
+        }
+        for (unsigned i = 0; i < GEN_TOTAL; i++) {
+            if (strcmp(argv[3], gen_profiles[i]) == 0) {
+                opts.profile = (gen_profile_e)i;
+            }
+        }
+        if (argc > 4) {
+            opts.seed = strtoull(argv[4], NULL, 10);
+        }
+        if (argc > 5 && strcmp(argv[5], "compressed") == 0) {
+            opts.format = MAT_FORMAT_COMPRESSED;
+        }
+        else if (argc <= 5 || strcmp(argv[5], "text") == 0) {
+            opts.format = MAT_FORMAT_TEXT;
+        }
+    }
+
+    if (opts.rows < 3 || opts.cols < 3 || opts.profile == GEN_TOTAL || \
+            opts.format == MAT_FORMAT_TOTAL) {
+        printf("Usage: %s output size|rowsxcols profile (seed) " \
+            "(text|compressed)\n", argv[0]);
+        printf("profiles:");
+        for (unsigned i = 0; i < GEN_TOTAL; i++) {
+            printf(" %s", gen_profiles[i]);
+        }
+        printf("\n");
+        ret = -1;
+    }
+    else {
+        m_err = gen_file_out(&opts, argv[1]);
+        if (m_err != MAT_ERR_NONE) {
+            printf("%s: mat_err: ", argv[0]);
+            perror(NULL);
+            ret = -1;
+        }
+        else {
+            printf("%u,%u\n", opts.rows, opts.cols);
+        }
+    }
+    return ret;
+}
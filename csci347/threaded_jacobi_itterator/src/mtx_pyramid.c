@@ -0,0 +1,63 @@
+#include "pyramid.h"
+
+/**
+ * Builds a pyramid file from a full size text matrix file.
+ * Levels are given as sizes after the file names. Without any, every 2^k + 2
+ *   from PYRAMID_MIN_SIZE below the full size is stored, which covers the
+ *   barrier test size of 66.
+ * Prints the sizes stored in the form level,rows,cols, one per line.
+ */
+int main(int argc, char **argv) {
+    double (*matrix)[MATRIX_STRIDE];
+    unsigned sizes[PYRAMID_LEVELS_MAX];
+    unsigned size_num = 0;
+    mat_err m_err = MAT_ERR_NONE;
+    int ret = 0;
+
+    if (argc < 3 || argc - 3 > PYRAMID_LEVELS_MAX - 1) {
+        printf("Usage: %s input.mtx output.pyr (size ...)\n", argv[0]);
+        ret = -1;
+    }
+    else {
+        if (argc > 3) {
+            for (int arg = 3; arg < argc; arg++) {
+                sizes[size_num++] = (unsigned)strtoul(argv[arg], NULL, 10);
+            }
+        }
+        else {
+            unsigned free_cells = 1;
+            while (free_cells * 2 + 2 < MATRIX_ROWS_FULL) {
+                free_cells *= 2;
+            }
+            while (free_cells + 2 >= PYRAMID_MIN_SIZE) {
+                sizes[size_num++] = free_cells + 2;
+                free_cells /= 2;
+            }
+        }
+
+        m_err = matrix_init(&matrix);
+        if (m_err == MAT_ERR_NONE) {
+            m_err = matrix_text_file_in(matrix, argv[1]);
+            if (m_err == MAT_ERR_NONE) {
+                m_err = pyramid_file_out(matrix, sizes, size_num, argv[2]);
+            }
+            matrix_delete(&matrix);
+        }
+        if (m_err != MAT_ERR_NONE) {
+            printf("%s: mat_err: ", argv[0]);
+            perror(NULL);
+            ret = -1;
+        }
+        else {
+            printf("0,%d,%d", MATRIX_ROWS, MATRIX_COLS);
+            unsigned level = 1;
+            for (unsigned i = 0; i < size_num; i++) {
+                if (sizes[i] >= 2 && sizes[i] < MATRIX_ROWS) {
+                    printf("\n%u,%u,%u", level++, sizes[i], sizes[i]);
+                }
+            }
+            printf("\n");
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,721 @@
+#include "multi.h"
+#include "mem_stats.h"
+
+// Subtask arguments
+typedef struct multi_subtask multi_subtask_t;
+struct multi_subtask {
+    multi_ctx_t *ctx;
+    matrix_partition_t *bounds;
+    // Max delta of every lane over the partition, for the last sweep
+    double *deltas;
+};
+
+// Everything about one interleaved solve. Laid out like jacobi_ctx_t, and
+//   shared the same way by the controlling thread and the subtask threads.
+struct multi_ctx {
+    jacobi_opts_t opts;
+    unsigned problem_num;
+    // Lanes of a cell, and how many of the first are still being solved
+    unsigned lanes;
+    unsigned active;
+    size_t row_doubles;
+
+    // Cell major, problem minor grids
+    double *grid_a;
+    double *grid_b;
+    unsigned partition_num;
+
+    // subtask_num+1 long, the controlling thread is last
+    pthread_t *threads;
+    multi_subtask_t *subtasks;
+    matrix_partition_t *bounds;
+    bool threads_started;
+
+    barrier_t subtask_done_barrier;
+    barrier_t subtask_wait_barrier;
+    bool barriers_init;
+    sem_t creation_wait;
+    bool do_next_iteration;
+    bool read_a_write_b;
+    unsigned iterations;
+
+    // The problem in every lane and the lane of every problem
+    unsigned *lane_problem;
+    unsigned *problem_lane;
+    // Iterations every problem took, 0 until it converges, and its result,
+    //   which is only kept once it has
+    unsigned *problem_iterations;
+    double (**results)[MATRIX_STRIDE];
+    // Max delta of every lane over all partitions
+    double *deltas;
+};
+
+/**
+ * Lanes a cell needs for active problems. Below MULTI_LANE_ALIGN it is the
+ *   next power of 2, so cells never straddle a cache line.
+ */
+static inline unsigned multi_lanes(unsigned active) {
+    unsigned lanes = 1;
+
+    if (active > MULTI_LANE_ALIGN) {
+        lanes = (active + MULTI_LANE_ALIGN-1) / MULTI_LANE_ALIGN * \
+            MULTI_LANE_ALIGN;
+    }
+    else {
+        while (lanes < active) {
+            lanes *= 2;
+        }
+    }
+    return lanes;
+}
+
+/**
+ * Start of a row of an interleaved grid.
+ */
+static inline double *multi_row(multi_ctx_t *ctx, double *grid, unsigned row) {
+    return grid + ctx->row_doubles * row;
+}
+
+/**
+ * The grid the next sweep reads from, which has the latest values.
+ */
+static inline double *multi_latest(multi_ctx_t *ctx) {
+    return ctx->read_a_write_b ? ctx->grid_a : ctx->grid_b;
+}
+
+/**
+ * Sweeps a subtask's partition over the active lanes, only touching the free
+ *   cells if the run has a mask. Spans are clipped to the partition like
+ *   do_masked_iteration does.
+ */
+void multi_subtask_iteration(multi_subtask_t *subtask, bool read_a_write_b) {
+    multi_ctx_t *ctx = subtask->ctx;
+    matrix_partition_t *bounds = subtask->bounds;
+    mask_t *mask = ctx->opts.mask;
+    double *read_grid = read_a_write_b ? ctx->grid_a : ctx->grid_b;
+    double *write_grid = read_a_write_b ? ctx->grid_b : ctx->grid_a;
+    unsigned lanes = ctx->lanes;
+    unsigned active = ctx->active;
+
+    memset(subtask->deltas, 0, sizeof(double) * active);
+    for (unsigned row = bounds->row_start; row < bounds->row_end; row++) {
+        const double *rows[STENCIL_WINDOW] = {NULL};
+        double *out = multi_row(ctx, write_grid, row);
+        rows[STENCIL_ROW(1, 0)] = multi_row(ctx, read_grid, row-1);
+        rows[STENCIL_ROW(1, 1)] = multi_row(ctx, read_grid, row);
+        rows[STENCIL_ROW(1, 2)] = multi_row(ctx, read_grid, row+1);
+
+        if (mask != NULL) {
+            for (unsigned span = mask->row_spans[row]; \
+                    span < mask->row_spans[row+1]; span++) {
+                unsigned col_start = mask->spans[span].col_start;
+                unsigned col_end   = mask->spans[span].col_end;
+                if (col_start < bounds->col_start) {
+                    col_start = bounds->col_start;
+                }
+                if (col_end > bounds->col_end) {
+                    col_end = bounds->col_end;
+                }
+                if (col_start < col_end) {
+                    ctx->opts.stencil->multi_row(rows, out, col_start, \
+                        col_end, lanes, active, subtask->deltas);
+                }
+            }
+        }
+        else {
+            ctx->opts.stencil->multi_row(rows, out, bounds->col_start, \
+                bounds->col_end, lanes, active, subtask->deltas);
+        }
+    }
+}
+
+/**
+ * Does a sweep over some bounds for every multi_step of the controlling
+ *   thread, the same way jacobi_iteration_subtask does.
+ */
+void* multi_iteration_subtask(void* arg) {
+    multi_subtask_t *subtask = (multi_subtask_t*)arg;
+    multi_ctx_t *ctx = subtask->ctx;
+
+    sem_wait(&(ctx->creation_wait));
+    bool run = ctx->do_next_iteration;
+    while (run) {
+        barrier_wait(&(ctx->subtask_wait_barrier), pthread_self());
+        run = ctx->do_next_iteration;
+        if (run) {
+            multi_subtask_iteration(subtask, ctx->read_a_write_b);
+            barrier_wait(&(ctx->subtask_done_barrier), pthread_self());
+        }
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * Creates the subtask threads, killing the ones already made if one fails
+ *   like jacobi_iteration_start_subtasks.
+ */
+jacobi_err multi_start_subtasks(multi_ctx_t *ctx) {
+    int err = 0;
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned subtask_num = ctx->opts.subtask_num;
+
+    ctx->do_next_iteration = true;
+    sem_init(&(ctx->creation_wait), 0, 0);
+    unsigned t = 0;
+    while (t < subtask_num && err == 0) {
+        err = pthread_create(&(ctx->threads[t]), NULL, \
+            multi_iteration_subtask, (void*)&(ctx->subtasks[t]));
+        if (err > 0) {
+            ctx->do_next_iteration = false;
+            for (unsigned j = 0; j < t; j++) {
+                sem_post(&(ctx->creation_wait));
+            }
+            for (unsigned j = 0; j < t; j++) {
+                pthread_join(ctx->threads[j], NULL);
+            }
+            sem_destroy(&(ctx->creation_wait));
+
+            errno = err;
+            ret = JACOBI_ERR_PTHREAD_CREATE;
+        }
+        else {
+            t++;
+        }
+    }
+
+    ctx->threads[t] = pthread_self();
+
+    if (t == subtask_num) {
+        for (unsigned j = 0; j < subtask_num; j++) {
+            sem_post(&(ctx->creation_wait));
+        }
+        ctx->threads_started = true;
+    }
+    return ret;
+}
+
+/**
+ * Frees a buffer from multi_alloc holding doubles doubles. NULL is ignored.
+ */
+void multi_free(double *buf, size_t doubles) {
+    if (buf != NULL) {
+        free(buf);
+        mem_count_free(MEM_SOLVER, sizeof(double) * doubles);
+    }
+}
+
+/**
+ * Frees whatever has been allocated for ctx so far. ctx is zeroed on
+ *   creation so this works for partially created contexts too.
+ */
+void multi_ctx_free(multi_ctx_t *ctx) {
+    if (ctx->barriers_init) {
+        barrier_delete(&(ctx->subtask_done_barrier));
+        barrier_delete(&(ctx->subtask_wait_barrier));
+    }
+    multi_free(ctx->grid_a, ctx->row_doubles * MATRIX_ROWS);
+    multi_free(ctx->grid_b, ctx->row_doubles * MATRIX_ROWS);
+    mem_free(MEM_SOLVER, ctx->threads);
+    if (ctx->subtasks != NULL) {
+        for (unsigned i = 0; i < ctx->partition_num; i++) {
+            multi_free(ctx->subtasks[i].deltas, ctx->lanes);
+        }
+    }
+    mem_free(MEM_SOLVER, ctx->subtasks);
+    mem_free(MEM_SOLVER, ctx->bounds);
+    mem_free(MEM_SOLVER, ctx->lane_problem);
+    mem_free(MEM_SOLVER, ctx->problem_lane);
+    mem_free(MEM_SOLVER, ctx->problem_iterations);
+    if (ctx->results != NULL) {
+        for (unsigned i = 0; i < ctx->problem_num; i++) {
+            if (ctx->results[i] != NULL) {
+                matrix_delete(&(ctx->results[i]));
+            }
+        }
+    }
+    mem_free(MEM_SOLVER, ctx->results);
+    mem_free(MEM_SOLVER, ctx->deltas);
+    mem_free(MEM_SOLVER, ctx);
+}
+
+/**
+ * Allocates a zeroed, cache line aligned buffer of doubles.
+ */
+jacobi_err multi_alloc(double **buf, size_t doubles) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+
+    errno = 0;
+    int err = posix_memalign((void**)buf, MATRIX_ALIGN, \
+        sizeof(double) * doubles);
+    if (err > 0) {
+        errno = err;
+        *buf = NULL;
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        memset(*buf, 0, sizeof(double) * doubles);
+        mem_count_alloc(MEM_SOLVER, sizeof(double) * doubles);
+    }
+    return ret;
+}
+
+/**
+ * All the allocation of an interleaved solve. Partitions are made the same
+ *   way as for a barrier synced jacobi solve.
+ */
+jacobi_err multi_ctx_mem_init(multi_ctx_t *ctx) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned partition_num = (ctx->opts.subtask_num > 0) ? \
+        ctx->opts.subtask_num : 1;
+    size_t grid_doubles = ctx->row_doubles * MATRIX_ROWS;
+
+    ctx->partition_num = partition_num;
+    ret = multi_alloc(&(ctx->grid_a), grid_doubles);
+    if (ret == JACOBI_ERR_NONE) {
+        ret = multi_alloc(&(ctx->grid_b), grid_doubles);
+    }
+    if (ret == JACOBI_ERR_NONE) {
+        errno = 0;
+        ctx->threads = mem_alloc(MEM_SOLVER, \
+            sizeof(pthread_t) * (ctx->opts.subtask_num+1));
+        ctx->subtasks = mem_calloc(MEM_SOLVER, \
+            partition_num, sizeof(multi_subtask_t));
+        ctx->bounds = mem_alloc(MEM_SOLVER, \
+            sizeof(matrix_partition_t) * partition_num);
+        ctx->lane_problem = mem_alloc(MEM_SOLVER, \
+            sizeof(unsigned) * ctx->problem_num);
+        ctx->problem_lane = mem_alloc(MEM_SOLVER, \
+            sizeof(unsigned) * ctx->problem_num);
+        ctx->problem_iterations = mem_calloc(MEM_SOLVER, \
+            ctx->problem_num, sizeof(unsigned));
+        ctx->results = mem_calloc(MEM_SOLVER, ctx->problem_num, \
+            sizeof(double (*)[MATRIX_STRIDE]));
+        ctx->deltas = mem_alloc(MEM_SOLVER, sizeof(double) * ctx->lanes);
+        if (ctx->threads == NULL || ctx->subtasks == NULL || \
+                ctx->bounds == NULL || ctx->lane_problem == NULL || \
+                ctx->problem_lane == NULL || \
+                ctx->problem_iterations == NULL || ctx->results == NULL || \
+                ctx->deltas == NULL) {
+            ret = JACOBI_ERR_MALLOC;
+        }
+    }
+    if (ret == JACOBI_ERR_NONE) {
+        if (ctx->opts.mask != NULL) {
+            mask_partitions(ctx->bounds, partition_num, ctx->opts.mask);
+        }
+        else if (ctx->opts.subtask_num > 0) {
+            matrix_partitions(ctx->bounds, partition_num);
+        }
+        else {
+            matrix_row_partitions(ctx->bounds, partition_num);
+        }
+        for (unsigned i = 0; i < ctx->problem_num; i++) {
+            ctx->lane_problem[i] = i;
+            ctx->problem_lane[i] = i;
+        }
+        for (unsigned i = 0; i < partition_num && ret == JACOBI_ERR_NONE; \
+                i++) {
+            ctx->subtasks[i].ctx = ctx;
+            ctx->subtasks[i].bounds = &(ctx->bounds[i]);
+            ret = multi_alloc(&(ctx->subtasks[i].deltas), ctx->lanes);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Creates an interleaved solver context. Allocates everything, initializes
+ *   the barriers and starts the subtask threads, like jacobi_create.
+ */
+jacobi_err multi_create(multi_ctx_t **ctx, const jacobi_opts_t *opts, \
+        unsigned problem_num) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+
+    assert(ctx != NULL);
+    assert(opts != NULL);
+    assert(problem_num > 0);
+
+    errno = 0;
+    *ctx = mem_calloc(MEM_SOLVER, 1, sizeof(multi_ctx_t));
+    if (*ctx == NULL) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        (*ctx)->opts = *opts;
+        (*ctx)->problem_num = problem_num;
+        (*ctx)->lanes = multi_lanes(problem_num);
+        (*ctx)->active = problem_num;
+        (*ctx)->row_doubles = (size_t)(*ctx)->lanes * MATRIX_COLS;
+        (*ctx)->read_a_write_b = true;
+
+        ret = multi_ctx_mem_init(*ctx);
+        if (ret == JACOBI_ERR_NONE && opts->subtask_num > 0) {
+            if (barrier_init(&((*ctx)->subtask_done_barrier), \
+                    opts->barrier_id, opts->subtask_num + 1, \
+                    &((*ctx)->threads)) < 0) {
+                ret = JACOBI_ERR_BARRIER_INIT;
+            }
+            else if (barrier_init(&((*ctx)->subtask_wait_barrier), \
+                    opts->barrier_id, opts->subtask_num + 1, \
+                    &((*ctx)->threads)) < 0) {
+                barrier_delete(&((*ctx)->subtask_done_barrier));
+                ret = JACOBI_ERR_BARRIER_INIT;
+            }
+            else {
+                (*ctx)->barriers_init = true;
+                ret = multi_start_subtasks(*ctx);
+            }
+        }
+        if (ret != JACOBI_ERR_NONE) {
+            multi_ctx_free(*ctx);
+            *ctx = NULL;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Copies the values of a problem into its lane of both grids.
+ */
+void multi_set(multi_ctx_t *ctx, unsigned problem, \
+        double (*matrix)[MATRIX_STRIDE]) {
+    unsigned lane = ctx->problem_lane[problem];
+
+    assert(problem < ctx->problem_num);
+    for (unsigned row = 0; row < MATRIX_ROWS; row++) {
+        double *row_a = multi_row(ctx, ctx->grid_a, row);
+        double *row_b = multi_row(ctx, ctx->grid_b, row);
+        for (unsigned col = 0; col < MATRIX_COLS; col++) {
+            row_a[col * ctx->lanes + lane] = matrix[row][col];
+            row_b[col * ctx->lanes + lane] = matrix[row][col];
+        }
+    }
+}
+
+/**
+ * Copies the latest values of a lane out.
+ */
+void multi_lane_get(multi_ctx_t *ctx, unsigned lane, \
+        double (*matrix)[MATRIX_STRIDE]) {
+    double *grid = multi_latest(ctx);
+
+    for (unsigned row = 0; row < MATRIX_ROWS; row++) {
+        double *grid_row = multi_row(ctx, grid, row);
+        for (unsigned col = 0; col < MATRIX_COLS; col++) {
+            matrix[row][col] = grid_row[col * ctx->lanes + lane];
+        }
+    }
+}
+
+/**
+ * Copies the latest values of a problem out of its lane, or its result once it
+ *   has converged.
+ */
+void multi_get(multi_ctx_t *ctx, unsigned problem, \
+        double (*matrix)[MATRIX_STRIDE]) {
+    assert(problem < ctx->problem_num);
+    if (ctx->results[problem] != NULL) {
+        memcpy(matrix, ctx->results[problem], MATRIX_BYTES);
+    }
+    else {
+        multi_lane_get(ctx, ctx->problem_lane[problem], matrix);
+    }
+}
+
+/**
+ * Takes the problem in lane out of the solve. Its result is copied out, and
+ *   the problem in the last active lane is moved into its lane in both grids.
+ */
+jacobi_err multi_retire(multi_ctx_t *ctx, unsigned lane) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned problem = ctx->lane_problem[lane];
+    unsigned last = ctx->active-1;
+    unsigned other = ctx->lane_problem[last];
+
+    if (matrix_init(&(ctx->results[problem])) != MAT_ERR_NONE) {
+        ctx->results[problem] = NULL;
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        multi_lane_get(ctx, lane, ctx->results[problem]);
+        if (lane != last) {
+            size_t cells = (size_t)MATRIX_ROWS * MATRIX_COLS;
+            for (size_t cell = 0; cell < cells; cell++) {
+                ctx->grid_a[cell * ctx->lanes + lane] = \
+                    ctx->grid_a[cell * ctx->lanes + last];
+                ctx->grid_b[cell * ctx->lanes + lane] = \
+                    ctx->grid_b[cell * ctx->lanes + last];
+            }
+        }
+        ctx->lane_problem[lane] = other;
+        ctx->lane_problem[last] = problem;
+        ctx->problem_lane[other] = lane;
+        ctx->problem_lane[problem] = last;
+        ctx->active--;
+    }
+    return ret;
+}
+
+/**
+ * Narrows the cells of both grids down to the lanes the active problems
+ *   need, once that is fewer than they have. Otherwise the lanes of problems
+ *   that left would still be streamed through the cache with every sweep.
+ *   Cells only ever move down, so this is done in place, in order.
+ */
+void multi_repack(multi_ctx_t *ctx) {
+    unsigned lanes = multi_lanes(ctx->active);
+    size_t cells = (size_t)MATRIX_ROWS * MATRIX_COLS;
+
+    if (ctx->active > 0 && lanes < ctx->lanes) {
+        for (size_t cell = 0; cell < cells; cell++) {
+            for (unsigned lane = 0; lane < ctx->active; lane++) {
+                ctx->grid_a[cell * lanes + lane] = \
+                    ctx->grid_a[cell * ctx->lanes + lane];
+                ctx->grid_b[cell * lanes + lane] = \
+                    ctx->grid_b[cell * ctx->lanes + lane];
+            }
+        }
+        ctx->lanes = lanes;
+        ctx->row_doubles = (size_t)lanes * MATRIX_COLS;
+    }
+}
+
+/**
+ * Does one sweep of every active problem, with the subtasks released and
+ *   collected on the barriers like jacobi_step. Then takes every problem that
+ *   has converged out of the solve and repacks the grids if it can. Lanes are
+ *   checked from the last one down, so the problem moved into a lane has
+ *   always been checked already.
+ */
+jacobi_err multi_step(multi_ctx_t *ctx, unsigned *active) {
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned subtask_num = ctx->opts.subtask_num;
+
+    if (subtask_num == 0) {
+        multi_subtask_iteration(&(ctx->subtasks[0]), ctx->read_a_write_b);
+    }
+    else {
+        ctx->threads[subtask_num] = pthread_self();
+        barrier_wait(&(ctx->subtask_wait_barrier), pthread_self());
+        barrier_wait(&(ctx->subtask_done_barrier), pthread_self());
+    }
+
+    memset(ctx->deltas, 0, sizeof(double) * ctx->active);
+    for (unsigned i = 0; i < ctx->partition_num; i++) {
+        for (unsigned lane = 0; lane < ctx->active; lane++) {
+            if (ctx->subtasks[i].deltas[lane] > ctx->deltas[lane]) {
+                ctx->deltas[lane] = ctx->subtasks[i].deltas[lane];
+            }
+        }
+    }
+    ctx->read_a_write_b = !ctx->read_a_write_b;
+    ctx->iterations++;
+
+    for (unsigned lane = ctx->active; lane-- > 0 && ret == JACOBI_ERR_NONE; ) {
+        if (ctx->deltas[lane] <= ctx->opts.epsilon) {
+            ctx->problem_iterations[ctx->lane_problem[lane]] = ctx->iterations;
+            ret = multi_retire(ctx, lane);
+        }
+    }
+    multi_repack(ctx);
+    *active = ctx->active;
+    return ret;
+}
+
+/**
+ * Sweeps until no problem is left. Records the realtime and CPU time of the
+ *   sweeps along with their number in rs.
+ */
+jacobi_err multi_solve(multi_ctx_t *ctx, struct runtime_stats *rs) {
+    struct timespec starttime_cpu_process;
+    struct timespec starttime_real;
+    struct timespec endtime_cpu_process;
+    struct timespec endtime_real;
+    jacobi_err ret = JACOBI_ERR_NONE;
+    unsigned start_iterations = ctx->iterations;
+    unsigned active = ctx->active;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &starttime_cpu_process);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &starttime_real);
+
+    while (ret == JACOBI_ERR_NONE && active > 0) {
+        ret = multi_step(ctx, &active);
+    }
+
+    if (ret == JACOBI_ERR_NONE) {
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endtime_cpu_process);
+        clock_gettime(CLOCK_MONOTONIC_RAW, &endtime_real);
+
+        rs->iterations = ctx->iterations - start_iterations;
+        timespec_diff(&endtime_cpu_process, &starttime_cpu_process, \
+            &(rs->runtime_cpu_process));
+        timespec_diff(&endtime_real, &starttime_real, &(rs->runtime_real));
+    }
+    return ret;
+}
+
+/**
+ * Iterations a problem took to converge, or the iterations so far if it is
+ *   still being solved.
+ */
+unsigned multi_iterations(multi_ctx_t *ctx, unsigned problem) {
+    assert(problem < ctx->problem_num);
+    return (ctx->problem_iterations[problem] > 0) ? \
+        ctx->problem_iterations[problem] : ctx->iterations;
+}
+
+/**
+ * Stops the subtask threads and frees the context, like jacobi_destroy.
+ */
+void multi_destroy(multi_ctx_t *ctx) {
+    unsigned subtask_num = ctx->opts.subtask_num;
+
+    if (ctx->threads_started) {
+        ctx->do_next_iteration = false;
+        ctx->threads[subtask_num] = pthread_self();
+        barrier_wait(&(ctx->subtask_wait_barrier), pthread_self());
+        for (unsigned i = 0; i < subtask_num; i++) {
+            pthread_join(ctx->threads[i], NULL);
+        }
+        sem_destroy(&(ctx->creation_wait));
+    }
+    multi_ctx_free(ctx);
+}
+
+/**
+ * Reads the list file into inputs and outputs, skipping lines without both.
+ *   Returns the number of problems, or -1 and sets errno on failure.
+ */
+int multi_list_read(char *list_fname, char ***inputs, char ***outputs) {
+    char *line = NULL;
+    size_t line_len = 0;
+    unsigned problem_num = 0, capacity = 0;
+    int ret = 0;
+
+    *inputs = NULL;
+    *outputs = NULL;
+    errno = 0;
+    FILE *list = fopen(list_fname, "r");
+    if (list == NULL) {
+        ret = -1;
+    }
+    else {
+        while (ret == 0 && getline(&line, &line_len, list) != -1) {
+            char *input_fname = NULL, *output_fname = NULL;
+            if (sscanf(line, "%ms %ms", &input_fname, &output_fname) < 2) {
+                free(input_fname);
+            }
+            else {
+                if (problem_num == capacity) {
+                    capacity = (capacity > 0) ? capacity * 2 : 16;
+                    char **grown_in = realloc(*inputs, \
+                        sizeof(char*) * capacity);
+                    if (grown_in != NULL) {
+                        *inputs = grown_in;
+                    }
+                    char **grown_out = realloc(*outputs, \
+                        sizeof(char*) * capacity);
+                    if (grown_out != NULL) {
+                        *outputs = grown_out;
+                    }
+                    if (grown_in == NULL || grown_out == NULL) {
+                        ret = -1;
+                    }
+                }
+                if (ret == 0) {
+                    (*inputs)[problem_num] = input_fname;
+                    (*outputs)[problem_num] = output_fname;
+                    problem_num++;
+                }
+                else {
+                    free(input_fname);
+                    free(output_fname);
+                }
+            }
+        }
+        free(line);
+        fclose(list);
+        if (ret < 0) {
+            for (unsigned i = 0; i < problem_num; i++) {
+                free((*inputs)[i]);
+                free((*outputs)[i]);
+            }
+            free(*inputs);
+            free(*outputs);
+        }
+    }
+    return (ret == 0) ? (int)problem_num : ret;
+}
+
+/**
+ * Loads every problem of the list, solves them all at once and writes them
+ *   out, then prints one result line per problem: input,iterations
+ *   and one for the whole solve, with no newline: multi,problems,iterations,
+ *   real-time elapsed(ms),cpu-time elapsed(ms),solves per second
+ * A single matrix is used to move every problem in and out of the grids.
+ */
+int multi_run(char *list_fname, const jacobi_opts_t *opts) {
+    char **inputs, **outputs;
+    double (*matrix)[MATRIX_STRIDE];
+    multi_ctx_t *ctx;
+    struct runtime_stats rs;
+    int ret = 0;
+
+    int problem_num = multi_list_read(list_fname, &inputs, &outputs);
+    if (problem_num < 0) {
+        ret = -1;
+    }
+    else if (problem_num == 0) {
+        errno = EINVAL;
+        ret = -1;
+    }
+    else if (matrix_init(&matrix) != MAT_ERR_NONE) {
+        ret = -1;
+    }
+    else {
+        if (multi_create(&ctx, opts, (unsigned)problem_num) != \
+                JACOBI_ERR_NONE) {
+            ret = -1;
+        }
+        else {
+            for (int i = 0; i < problem_num && ret == 0; i++) {
+                if (matrix_file_in(matrix, inputs[i]) != MAT_ERR_NONE) {
+                    printf("%s,failed,%s\n", inputs[i], strerror(errno));
+                    ret = -1;
+                }
+                else {
+                    multi_set(ctx, (unsigned)i, matrix);
+                }
+            }
+            if (ret == 0 && multi_solve(ctx, &rs) != JACOBI_ERR_NONE) {
+                ret = -1;
+            }
+            for (int i = 0; i < problem_num && ret == 0; i++) {
+                multi_get(ctx, (unsigned)i, matrix);
+                if (matrix_file_out(matrix, outputs[i]) != MAT_ERR_NONE) {
+                    printf("%s,failed,%s\n", outputs[i], strerror(errno));
+                    ret = -1;
+                }
+                else {
+                    printf("%s,%u,\n", inputs[i], multi_iterations(ctx, i));
+                }
+            }
+            if (ret == 0) {
+                double ms = conv_timespec_to_ms(&(rs.runtime_real));
+                printf("multi,%d,%u,%.10e,%.10e,%.10e,", problem_num, \
+                    rs.iterations, ms, \
+                    conv_timespec_to_ms(&(rs.runtime_cpu_process)), \
+                    (ms > 0.0) ? problem_num / (ms / 1000.0) : 0.0);
+            }
+            multi_destroy(ctx);
+        }
+        matrix_delete(&matrix);
+    }
+    for (int i = 0; i < problem_num; i++) {
+        free(inputs[i]);
+        free(outputs[i]);
+    }
+    free(inputs);
+    free(outputs);
+    return ret;
+}
@@ -0,0 +1,52 @@
+#ifndef __MULTI_H
+#define __MULTI_H
+#include "jacobi.h"
+
+// Interleaved solves
+// Solves many problems with the same geometry (mask and stencil) but their own
+//   values at once. The problems are interleaved cell by cell, so each cell
+//   holds a lane for every problem, and one sweep works out a cell of every
+//   problem from the same neighbours, with the lanes side by side in SIMD
+//   registers. The threads only sync twice a sweep for all the problems.
+// A problem leaves the solve as soon as its max delta falls to epsilon. Its
+//   result is copied out and the problem in the last lane still being solved
+//   takes its lane, so the lanes being solved are always the first ones and
+//   the sweeps only go over those. Once they fit in half the lanes the grids
+//   are repacked with fewer lanes a cell, so the sweeps stream less memory.
+
+// Cells with more lanes than this have a multiple of it, so every cell starts
+//   on a cache line. Cells with fewer have a power of 2.
+#define MULTI_LANE_ALIGN 8
+
+// Opaque interleaved solver context
+typedef struct multi_ctx multi_ctx_t;
+
+// Creates a context for problem_num problems, solved with opts. Only the
+//   barrier, subtasks, mask, stencil and epsilon of opts are used, the solve
+//   is always barrier synced. Every problem starts out zeroed, so each must be
+//   set before solving. Subtask threads are started here.
+jacobi_err multi_create(multi_ctx_t **ctx, const jacobi_opts_t *opts, \
+    unsigned problem_num);
+// Copies the values of a problem in or out of the interleaved grids
+void multi_set(multi_ctx_t *ctx, unsigned problem, \
+    double (*matrix)[MATRIX_STRIDE]);
+void multi_get(multi_ctx_t *ctx, unsigned problem, \
+    double (*matrix)[MATRIX_STRIDE]);
+// Does a single sweep over every problem still being solved and stores how
+//   many still are in active.
+jacobi_err multi_step(multi_ctx_t *ctx, unsigned *active);
+// Sweeps until every problem has converged and stores the stats in rs. The
+//   iterations in rs are those of the slowest problem.
+jacobi_err multi_solve(multi_ctx_t *ctx, struct runtime_stats *rs);
+// Iterations a problem took to converge, or those so far if it hasn't.
+unsigned multi_iterations(multi_ctx_t *ctx, unsigned problem);
+// Stops the subtask threads and frees everything owned by ctx.
+void multi_destroy(multi_ctx_t *ctx);
+
+// Solves every problem in the list file, each line "input output", in one
+//   interleaved solve with opts, and writes their outputs. Returns -1 and sets
+//   errno if the solve could not run, and prints which file it was if one
+//   could not be read or written.
+int multi_run(char *list_fname, const jacobi_opts_t *opts);
+
+#endif /* __MULTI_H */
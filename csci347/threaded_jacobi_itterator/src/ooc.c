@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#include "ooc.h"
+#include "mem_stats.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#define OOC_ROW_BYTES (sizeof(double) * MATRIX_STRIDE)
+
+/**
+ * Creates a grid file big enough for a matrix, maps it, and stamps the header.
+ *   Passes go through the file in order, so both the mapping and the file are
+ *   hinted as sequential.
+ */
+mat_err ooc_grid_create(ooc_grid_t *grid, char *fname) {
+    mat_err ret = MAT_ERR_NONE;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    grid->map_bytes = (OOC_HEADER_BYTES + MATRIX_BYTES + page-1) / page * page;
+    grid->band_rows = OOC_BAND_BYTES / OOC_ROW_BYTES;
+
+    errno = 0;
+    grid->fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (grid->fd < 0) {
+        ret = MAT_ERR_FOPEN;
+    }
+    else if (ftruncate(grid->fd, (off_t)grid->map_bytes) < 0) {
+        close(grid->fd);
+        ret = MAT_ERR_FOPEN;
+    }
+    else {
+        grid->map = mmap(NULL, grid->map_bytes, PROT_READ | PROT_WRITE, \
+            MAP_SHARED, grid->fd, 0);
+        if (grid->map == MAP_FAILED) {
+            close(grid->fd);
+            ret = MAT_ERR_MALLOC;
+        }
+        else {
+            memcpy(grid->map, OOC_MAGIC, OOC_MAGIC_LEN);
+            grid->matrix = (double (*)[MATRIX_STRIDE])((char*)grid->map + \
+                OOC_HEADER_BYTES);
+            madvise(grid->map, grid->map_bytes, MADV_SEQUENTIAL);
+            posix_fadvise(grid->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            mem_count_alloc(MEM_MATRIX, grid->map_bytes);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Unmaps and closes a grid file. Dirty pages are left to the page cache.
+ */
+void ooc_grid_close(ooc_grid_t *grid) {
+    munmap(grid->map, grid->map_bytes);
+    mem_count_free(MEM_MATRIX, grid->map_bytes);
+    close(grid->fd);
+}
+
+/**
+ * Byte range of a band of rows, from the start of the file (which is also the
+ *   start of the mapping). outer rounds it out to whole pages, otherwise it is
+ *   rounded in, so it only has pages that no other band has rows in.
+ * Returns false if the band is past the end of the matrix or the range is
+ *   empty.
+ */
+bool ooc_band_range(ooc_grid_t *grid, unsigned band, bool outer, \
+        size_t *start, size_t *end) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    unsigned row_start = band * grid->band_rows;
+    unsigned row_end = row_start + grid->band_rows;
+
+    if (row_end > MATRIX_ROWS) {
+        row_end = MATRIX_ROWS;
+    }
+    *start = OOC_HEADER_BYTES + (size_t)row_start * OOC_ROW_BYTES;
+    *end = OOC_HEADER_BYTES + (size_t)row_end * OOC_ROW_BYTES;
+    if (outer) {
+        *start = *start / page * page;
+        *end = (*end + page-1) / page * page;
+    }
+    else {
+        *start = (*start + page-1) / page * page;
+        *end = *end / page * page;
+    }
+    return row_start < MATRIX_ROWS && *start < *end;
+}
+
+/**
+ * Asks for a band to be read ahead.
+ */
+void ooc_band_prefetch(ooc_grid_t *grid, unsigned band) {
+    size_t start, end;
+
+    if (ooc_band_range(grid, band, true, &start, &end)) {
+        madvise((char*)grid->map + start, end - start, MADV_WILLNEED);
+    }
+}
+
+/**
+ * Called once every row of a band has been written. Starts the write back of
+ *   the band, and waits for that of the band before it, which was started a
+ *   band ago, so it can be dropped from memory. Dropping only unmaps it from
+ *   the process if the pages are still dirty, so it is never lost.
+ */
+void ooc_band_written(ooc_grid_t *grid, unsigned band) {
+    size_t start, end;
+
+    if (ooc_band_range(grid, band, true, &start, &end)) {
+        sync_file_range(grid->fd, (off_t)start, (off_t)(end - start), \
+            SYNC_FILE_RANGE_WRITE);
+    }
+    if (band > 0 && ooc_band_range(grid, band-1, false, &start, &end)) {
+        madvise((char*)grid->map + start, end - start, MADV_DONTNEED);
+        sync_file_range(grid->fd, (off_t)start, (off_t)(end - start), \
+            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | \
+            SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(grid->fd, (off_t)start, (off_t)(end - start), \
+            POSIX_FADV_DONTNEED);
+    }
+}
+
+/**
+ * Where row r of iteration t of a pass is kept. Each iteration has 3 rows,
+ *   picked by r % 3.
+ */
+static inline double *ooc_level_row(double *levels, unsigned t, unsigned r) {
+    return levels + MATRIX_STRIDE * (t * 3 + r % 3);
+}
+
+/**
+ * Works out the new values of one row into out, over the free cells only if
+ *   the run has a mask.
+ * Returns the max delta of the row, or delta_max if that is larger.
+ */
+static inline double ooc_row_iteration(const jacobi_opts_t *opts, \
+        const double *const *rows, double *out, unsigned row, \
+        double delta_max) {
+    mask_t *mask = opts->mask;
+
+    if (mask != NULL) {
+        for (unsigned span = mask->row_spans[row]; \
+                span < mask->row_spans[row+1]; span++) {
+            delta_max = opts->stencil->row(rows, out, \
+                mask->spans[span].col_start, mask->spans[span].col_end, \
+                delta_max);
+        }
+    }
+    else {
+        delta_max = opts->stencil->row(rows, out, 1, MATRIX_COLS-1, \
+            delta_max);
+    }
+    return delta_max;
+}
+
+/**
+ * Does one pass of steps iterations over the grid. Step s reads row s+1 of the
+ *   file into iteration 0 and then works out row s-t+1 of every iteration t,
+ *   whose rows above and below in iteration t-1 are done by then. The last
+ *   iteration is written straight back to the file, the rest go to levels.
+ *   The file is only written steps-1 rows behind where it is read, and those
+ *   rows have already been copied into iteration 0, so a pass never reads a
+ *   value it has overwritten.
+ * The first and last rows never change, so every iteration just copies them.
+ *   Neither do the cells outside the mask or the first and last columns, so
+ *   the rows written to the file already have them.
+ * Stores the max delta of each iteration in deltas.
+ */
+void ooc_pass(ooc_grid_t *grid, const jacobi_opts_t *opts, unsigned steps, \
+        double *levels, double *deltas) {
+    double (*matrix)[MATRIX_STRIDE] = grid->matrix;
+    unsigned band_rows = grid->band_rows;
+    size_t row_bytes = sizeof(double) * MATRIX_COLS;
+
+    for (unsigned t = 0; t < steps; t++) {
+        deltas[t] = 0.0;
+        memcpy(ooc_level_row(levels, t, 0), matrix[0], row_bytes);
+    }
+    ooc_band_prefetch(grid, 0);
+    ooc_band_prefetch(grid, 1);
+    memcpy(ooc_level_row(levels, 0, 1), matrix[1], row_bytes);
+
+    for (unsigned s = 1; s < MATRIX_ROWS-1 + steps-1; s++) {
+        unsigned front = s+1;
+        if (front < MATRIX_ROWS) {
+            if (front % band_rows == 0) {
+                ooc_band_prefetch(grid, front / band_rows + 1);
+            }
+            memcpy(ooc_level_row(levels, 0, front), matrix[front], row_bytes);
+        }
+
+        for (unsigned t = 1; t <= steps && t <= s; t++) {
+            unsigned row = s - t + 1;
+            if (row == MATRIX_ROWS-1 && t < steps) {
+                memcpy(ooc_level_row(levels, t, row), \
+                    ooc_level_row(levels, t-1, row), row_bytes);
+            }
+            else if (row < MATRIX_ROWS-1) {
+                const double *rows[STENCIL_WINDOW] = {NULL};
+                double *out = matrix[row];
+                rows[STENCIL_ROW(1, 0)] = ooc_level_row(levels, t-1, row-1);
+                rows[STENCIL_ROW(1, 1)] = ooc_level_row(levels, t-1, row);
+                rows[STENCIL_ROW(1, 2)] = ooc_level_row(levels, t-1, row+1);
+                if (t < steps) {
+                    out = ooc_level_row(levels, t, row);
+                    memcpy(out, rows[STENCIL_ROW(1, 1)], row_bytes);
+                }
+                deltas[t-1] = ooc_row_iteration(opts, rows, out, row, \
+                    deltas[t-1]);
+            }
+        }
+
+        // Row s-steps+1 is final now. The last band ends on the last row,
+        //   which is never written.
+        if (s >= steps) {
+            unsigned tail = s - steps + 1;
+            if ((tail+1) % band_rows == 0 || tail == MATRIX_ROWS-2) {
+                ooc_band_written(grid, tail / band_rows);
+            }
+        }
+    }
+}
+
+/**
+ * Passes over the grid until the last iteration of a pass has a max delta of
+ *   no more than epsilon. Records the stats of the solve in rs like
+ *   jacobi_solve, and its I/O in io.
+ */
+jacobi_err ooc_solve(ooc_grid_t *grid, const jacobi_opts_t *opts, \
+        unsigned steps, struct runtime_stats *rs, ooc_io_t *io) {
+    struct timespec starttime_cpu_process;
+    struct timespec starttime_real;
+    struct timespec endtime_cpu_process;
+    struct timespec endtime_real;
+    struct rusage start_usage, end_usage;
+    jacobi_err ret = JACOBI_ERR_NONE;
+    double *levels = NULL;
+    double *deltas;
+
+    assert(steps > 0);
+
+    errno = 0;
+    int err = posix_memalign((void**)&levels, MATRIX_ALIGN, \
+        OOC_ROW_BYTES * 3 * steps);
+    if (err > 0) {
+        errno = err;
+        levels = NULL;
+    }
+    else {
+        mem_count_alloc(MEM_SOLVER, OOC_ROW_BYTES * 3 * steps);
+    }
+    deltas = mem_alloc(MEM_SOLVER, sizeof(double) * steps);
+    if (levels == NULL || deltas == NULL) {
+        ret = JACOBI_ERR_MALLOC;
+    }
+    else {
+        unsigned iterations = 0;
+
+        getrusage(RUSAGE_SELF, &start_usage);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &starttime_cpu_process);
+        clock_gettime(CLOCK_MONOTONIC_RAW, &starttime_real);
+
+        do {
+            ooc_pass(grid, opts, steps, levels, deltas);
+            iterations += steps;
+        } while (deltas[steps-1] > opts->epsilon);
+
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endtime_cpu_process);
+        clock_gettime(CLOCK_MONOTONIC_RAW, &endtime_real);
+        getrusage(RUSAGE_SELF, &end_usage);
+
+        rs->iterations = iterations;
+        timespec_diff(&endtime_cpu_process, &starttime_cpu_process, \
+            &(rs->runtime_cpu_process));
+        timespec_diff(&endtime_real, &starttime_real, &(rs->runtime_real));
+
+        // A pass reads every row and writes every row but the first and last
+        io->streamed_bytes = (double)OOC_ROW_BYTES * \
+            (MATRIX_ROWS + MATRIX_ROWS-2) / steps;
+        // Block counts are in 512 byte units
+        io->disk_bytes = 512.0 * \
+            ((end_usage.ru_inblock - start_usage.ru_inblock) + \
+            (end_usage.ru_oublock - start_usage.ru_oublock)) / iterations;
+    }
+    if (levels != NULL) {
+        free(levels);
+        mem_count_free(MEM_SOLVER, OOC_ROW_BYTES * 3 * steps);
+    }
+    mem_free(MEM_SOLVER, deltas);
+    return ret;
+}
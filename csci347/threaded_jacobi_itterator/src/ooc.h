@@ -0,0 +1,60 @@
+#ifndef __OOC_H
+#define __OOC_H
+#include "jacobi.h"
+
+// Out of core solves
+// The matrix lives in a grid file that is mapped into memory, so only the
+//   rows being worked on have to be in RAM and the page cache does the rest.
+// Layout of a grid file, all in host byte order:
+//   OOC_HEADER_BYTES of header, starting with OOC_MAGIC
+//   MATRIX_ROWS rows of MATRIX_STRIDE doubles, exactly as they are in memory
+// A solve streams through the file once for every steps iterations. Each pass
+//   is a wavefront: iteration t of a row is worked out as soon as iteration
+//   t-1 of the rows around it is, so only 3 rows of every iteration in flight
+//   are kept, in memory, and each row of the file is read and written once a
+//   pass however many iterations the pass does.
+// The file is hinted at a band of rows at a time. The band after the one
+//   being read is prefetched, and once a band has all been written its write
+//   back is started, and the band before it is dropped from memory.
+
+#define OOC_MAGIC "JOOCGRID"
+#define OOC_MAGIC_LEN 8
+// Rows start one page in, so the matrix is page aligned
+#define OOC_HEADER_BYTES 4096
+// Size of the bands the file is hinted at
+#define OOC_BAND_BYTES (4UL * 1024UL * 1024UL)
+// Name of a grid file, after the matrix file it is worked out for
+#define OOC_GRID_SUFFIX ".grid"
+
+typedef struct ooc_grid ooc_grid_t;
+struct ooc_grid {
+    int fd;
+    void *map;
+    size_t map_bytes;
+    // The rows of the file
+    double (*matrix)[MATRIX_STRIDE];
+    unsigned band_rows;
+};
+
+// I/O of a solve. streamed is the bytes read and written through the mapping,
+//   disk what actually reached the disk going by the block counts of the
+//   process, both per iteration.
+typedef struct ooc_io ooc_io_t;
+struct ooc_io {
+    double streamed_bytes;
+    double disk_bytes;
+};
+
+// Creates (or truncates) a grid file and maps it. The matrix is left zeroed.
+mat_err ooc_grid_create(ooc_grid_t *grid, char *fname);
+// Unmaps and closes a grid file, writing back whatever is still dirty.
+void ooc_grid_close(ooc_grid_t *grid);
+
+// Solves the matrix of grid with opts, doing steps iterations for every pass
+//   over the file, so a solve does a multiple of steps iterations. Only the
+//   mask, stencil and epsilon of opts are used, the solve runs on the calling
+//   thread.
+jacobi_err ooc_solve(ooc_grid_t *grid, const jacobi_opts_t *opts, \
+    unsigned steps, struct runtime_stats *rs, ooc_io_t *io);
+
+#endif /* __OOC_H */
@@ -1,20 +1,62 @@
 #include "options.h"
+#include <limits.h>
 
 // Sample output
 // ./jacobi_process --barrier 0 --input data_ref/input.mtx --output output --subtasks 4
 // ^ can be in any order
 const char * const options[] = {"--barrier", "--input", "--output", \
-    "--subtasks"};
+    "--subtasks", "--mask", "--stencil", "--batch", "--hugepages", \
+    "--compress", "--sync", "--interval", "--roofline", "--format", \
+    "--inplace", "--outofcore", "--stats", "--accel", "--multi", \
+    "--deadline-ms", "--plan", "--resolve", \
+    "--active", "--mem-stats", "--fibers", "--sweep", \
+    "--rebalance"};
 
 /**
- * Parses the option string and fill option_values. There is NO DEFAULT OPTIONS.
- *   It fails if any options are duplicates or any aren't there. Otherwise
- *   option_values is filled accordingly.
+ * Parses the option string and fill option_values. There is NO DEFAULT for the
+ *   required options. It fails if any options are duplicates or any of the
+ *   required ones aren't there. Otherwise option_values is filled accordingly,
+ *   and the optional ones left out get their defaults.
+ * --batch and --multi take the place of --input and --output, so exactly one
+ *   of the three must be given. Only --multi shares a --mask between its
+ *   problems. --plan needs a --deadline-ms to plan for. --sweep takes the
+ *   place of --barrier and --subtasks, and only runs plain solves, so it
+ *   can't be given with them, any of the other modes, or the options that
+ *   change what a solve writes or prints.
+ * Modes are refused along with the options they can't run with, rather than
+ *   left for jacobi_create to drop: --accel only runs with --sync 0, and not
+ *   with --inplace, --outofcore or --plan (which picks it itself). --active
+ *   is the same, and can't be given with --accel either. --rebalance needs
+ *   --sync 0 and more than one subtask (a sweep picks its own), and can't be
+ *   given with --mask, --inplace, --active, --outofcore or --plan.
  */
 int get_option_values(char **argv, option_values_t *option_values) {
-    bool option_found[] = {false, false, false, false};
+    bool option_found[OPT_TOTAL] = {false};
     int ret = 0;
 
+    option_values->mask_fname = NULL;
+    option_values->stencil_id = STENCIL_2D_5PT;
+    option_values->batch_fname = NULL;
+    option_values->multi_fname = NULL;
+    option_values->alloc_mode = MAT_ALLOC_ALIGNED;
+    option_values->out_format = MAT_FORMAT_TEXT;
+    option_values->sync = JACOBI_SYNC_BARRIER;
+    option_values->check_interval = JACOBI_CHECK_INTERVAL;
+    option_values->roofline = false;
+    option_values->print_format = PRINT_CSV;
+    option_values->in_place = false;
+    option_values->ooc_steps = 0;
+    option_values->stats = false;
+    option_values->accel = JACOBI_ACCEL_NONE;
+    option_values->active = false;
+    option_values->fibers = false;
+    option_values->rebalance = false;
+    option_values->deadline_ms = 0;
+    option_values->plan = false;
+    option_values->edits_fname = NULL;
+    option_values->mem_stats = false;
+    option_values->sweep_spec = NULL;
+
     unsigned arg = 1;
     bool inval = false;
     while (argv[arg] != NULL && !inval) {
@@ -44,11 +86,57 @@ int get_option_values(char **argv, option_values_t *option_values) {
     }
 
     if (ret == 0) {
+        if (option_found[OPT_BATCH] || option_found[OPT_MULTI]) {
+            if (option_found[OPT_INPUT] || option_found[OPT_OUTPUT] || \
+                    (option_found[OPT_BATCH] && option_found[OPT_MASK]) || \
+                    (option_found[OPT_BATCH] && option_found[OPT_MULTI])) {
+                ret = -1;
+            }
+            option_found[OPT_INPUT] = true;
+            option_found[OPT_OUTPUT] = true;
+        }
+        if (option_found[OPT_SWEEP]) {
+            if (option_found[OPT_BARRIER] || option_found[OPT_SUBTASKS] || \
+                    option_found[OPT_BATCH] || option_found[OPT_MULTI] || \
+                    option_found[OPT_OUTOFCORE] || \
+                    option_found[OPT_RESOLVE] || option_found[OPT_PLAN] || \
+                    option_found[OPT_ROOFLINE] || option_found[OPT_FORMAT] || \
+                    option_found[OPT_STATS] || option_found[OPT_COMPRESS]) {
+                ret = -1;
+            }
+            option_found[OPT_BARRIER] = true;
+            option_found[OPT_SUBTASKS] = true;
+        }
+        if (option_values->plan && option_values->deadline_ms == 0) {
+            ret = -1;
+        }
+        if (option_values->accel != JACOBI_ACCEL_NONE && \
+                (option_values->sync != JACOBI_SYNC_BARRIER || \
+                option_values->in_place || option_values->ooc_steps > 0 || \
+                option_values->plan)) {
+            ret = -1;
+        }
+        if (option_values->active && \
+                (option_values->sync != JACOBI_SYNC_BARRIER || \
+                option_values->in_place || option_values->ooc_steps > 0 || \
+                option_values->plan || \
+                option_values->accel != JACOBI_ACCEL_NONE)) {
+            ret = -1;
+        }
+        if (option_values->rebalance && \
+                (option_values->sync != JACOBI_SYNC_BARRIER || \
+                (option_found[OPT_SUBTASKS] && !option_found[OPT_SWEEP] && \
+                option_values->subtask_num < 2) || \
+                option_found[OPT_MASK] || option_values->in_place || \
+                option_values->active || option_values->ooc_steps > 0 || \
+                option_values->plan)) {
+            ret = -1;
+        }
         int opt = 0;
-        while (opt < OPT_TOTAL && option_found[opt]) {
+        while (opt < OPT_REQUIRED && option_found[opt]) {
             opt++;
         }
-        if (opt < OPT_TOTAL) {
+        if (opt < OPT_REQUIRED) {
             ret = -1;
         }
     }
@@ -82,6 +170,179 @@ int parse_opt(opt_e opt, char *arg, option_values_t *option_values) {
         temp = strtoul(arg, NULL, 10);
         option_values->subtask_num = (unsigned)temp;
         break;
+    case OPT_MASK:
+        option_values->mask_fname = arg;
+        break;
+    case OPT_STENCIL:
+        temp = strtoul(arg, NULL, 10);
+        if (temp == 5) {
+            option_values->stencil_id = STENCIL_2D_5PT;
+        }
+        else if (temp == 9) {
+            option_values->stencil_id = STENCIL_2D_9PT;
+        }
+        else {
+            ret = -1;
+        }
+        break;
+    case OPT_BATCH:
+        option_values->batch_fname = arg;
+        break;
+    case OPT_HUGEPAGES:
+        temp = strtoul(arg, NULL, 10);
+        if (temp >= MAT_ALLOC_TOTAL) {
+            ret = -1;
+        }
+        else {
+            option_values->alloc_mode = (mat_alloc_e)temp;
+        }
+        break;
+    case OPT_COMPRESS:
+        temp = strtoul(arg, NULL, 10);
+        if (temp >= MAT_FORMAT_TOTAL) {
+            ret = -1;
+        }
+        else {
+            option_values->out_format = (mat_format_e)temp;
+        }
+        break;
+    case OPT_SYNC:
+        temp = strtoul(arg, NULL, 10);
+        if (temp >= JACOBI_SYNC_TOTAL) {
+            ret = -1;
+        }
+        else {
+            option_values->sync = (jacobi_sync_e)temp;
+        }
+        break;
+    case OPT_INTERVAL:
+        temp = strtoul(arg, NULL, 10);
+        if (temp == 0) {
+            ret = -1;
+        }
+        else {
+            option_values->check_interval = (unsigned)temp;
+        }
+        break;
+    case OPT_ROOFLINE:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > 1) {
+            ret = -1;
+        }
+        else {
+            option_values->roofline = (temp == 1);
+        }
+        break;
+    case OPT_FORMAT:
+        if (strcmp(arg, "csv") == 0) {
+            option_values->print_format = PRINT_CSV;
+        }
+        else if (strcmp(arg, "json") == 0) {
+            option_values->print_format = PRINT_JSON;
+        }
+        else {
+            ret = -1;
+        }
+        break;
+    case OPT_INPLACE:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > 1) {
+            ret = -1;
+        }
+        else {
+            option_values->in_place = (temp == 1);
+        }
+        break;
+    case OPT_OUTOFCORE:
+        temp = strtoul(arg, NULL, 10);
+        option_values->ooc_steps = (unsigned)temp;
+        break;
+    case OPT_STATS:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > 1) {
+            ret = -1;
+        }
+        else {
+            option_values->stats = (temp == 1);
+        }
+        break;
+    case OPT_ACCEL:
+        temp = strtoul(arg, NULL, 10);
+        if (temp >= JACOBI_ACCEL_TOTAL) {
+            ret = -1;
+        }
+        else {
+            option_values->accel = (jacobi_accel_e)temp;
+        }
+        break;
+    case OPT_ACTIVE:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > 1) {
+            ret = -1;
+        }
+        else {
+            option_values->active = (temp == 1);
+        }
+        break;
+    case OPT_MULTI:
+        option_values->multi_fname = arg;
+        break;
+    case OPT_DEADLINE:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > UINT_MAX) {
+            ret = -1;
+        }
+        else {
+            option_values->deadline_ms = (unsigned)temp;
+        }
+        break;
+    case OPT_RESOLVE:
+        option_values->edits_fname = arg;
+        break;
+    case OPT_PLAN:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > 1) {
+            ret = -1;
+        }
+        else {
+            option_values->plan = (temp == 1);
+        }
+        break;
+    case OPT_FIBERS:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > 1) {
+            ret = -1;
+        }
+        else {
+            option_values->fibers = (temp == 1);
+        }
+        break;
+    case OPT_REBALANCE:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > 1) {
+            ret = -1;
+        }
+        else {
+            option_values->rebalance = (temp == 1);
+        }
+        break;
+    case OPT_MEM_STATS:
+        temp = strtoul(arg, NULL, 10);
+        if (temp > 1) {
+            ret = -1;
+        }
+        else {
+            option_values->mem_stats = (temp == 1);
+        }
+        break;
+    case OPT_SWEEP:
+        if (sweep_parse(&(option_values->sweep), arg) < 0) {
+            ret = -1;
+        }
+        else {
+            option_values->sweep_spec = arg;
+        }
+        break;
     case OPT_TOTAL:
         ret = -1;
         break;
@@ -1,6 +1,10 @@
 #ifndef __OPTIONS_H
 #define __OPTIONS_H
 #include "barrier.h"
+#include "stencil.h"
+#include "matrix.h"
+#include "jacobi.h"
+#include "sweep.h"
 #include <stdbool.h>
 #include <string.h>
 
@@ -11,11 +15,45 @@ enum opt {
     OPT_INPUT    = 1,
     OPT_OUTPUT   = 2,
     OPT_SUBTASKS = 3,
-    OPT_TOTAL    = 4
+    OPT_MASK     = 4,
+    OPT_STENCIL  = 5,
+    OPT_BATCH    = 6,
+    OPT_HUGEPAGES = 7,
+    OPT_COMPRESS = 8,
+    OPT_SYNC     = 9,
+    OPT_INTERVAL = 10,
+    OPT_ROOFLINE = 11,
+    OPT_FORMAT   = 12,
+    OPT_INPLACE  = 13,
+    OPT_OUTOFCORE = 14,
+    OPT_STATS    = 15,
+    OPT_ACCEL    = 16,
+    OPT_MULTI    = 17,
+    OPT_DEADLINE = 18,
+    OPT_PLAN     = 19,
+    OPT_RESOLVE  = 20,
+    OPT_ACTIVE   = 21,
+    OPT_MEM_STATS = 22,
+    OPT_FIBERS   = 23,
+    OPT_SWEEP    = 24,
+    OPT_REBALANCE = 25,
+    OPT_TOTAL    = 26
 };
+// Options before this one are required, the rest are optional. The exceptions
+//   are --batch and --multi, which replace --input and --output, and --sweep,
+//   which replaces --barrier and --subtasks.
+#define OPT_REQUIRED OPT_MASK
 // Corresponding strings for each option.
 extern const char * const options[];
 
+// How results are printed
+typedef enum print_format_e print_format_e;
+enum print_format_e {
+    PRINT_CSV   = 0,
+    PRINT_JSON  = 1,
+    PRINT_TOTAL = 2
+};
+
 // struct containing option values
 typedef struct option_values option_values_t;
 struct option_values {
@@ -23,6 +61,35 @@ struct option_values {
     char *input_fname;
     char *output_fname;
     unsigned subtask_num;
+    char *mask_fname;
+    stencil_e stencil_id;
+    char *batch_fname;
+    char *multi_fname;
+    mat_alloc_e alloc_mode;
+    mat_format_e out_format;
+    jacobi_sync_e sync;
+    unsigned check_interval;
+    bool roofline;
+    print_format_e print_format;
+    bool in_place;
+    // Iterations per pass of an out of core solve, 0 solves in memory
+    unsigned ooc_steps;
+    bool stats;
+    jacobi_accel_e accel;
+    bool active;
+    bool fibers;
+    bool rebalance;
+    // Budget of the solve, 0 solves until convergence
+    unsigned deadline_ms;
+    // Picks the subtasks and acceleration for the budget instead
+    bool plan;
+    // Edits to re-solve the input, a solution, for instead of solving it
+    char *edits_fname;
+    // Prints the allocation counts once everything is freed
+    bool mem_stats;
+    // Runs the sweep instead of a single solve if sweep_spec isn't NULL
+    char *sweep_spec;
+    sweep_t sweep;
 };
 
 int get_option_values(char **argv, option_values_t *option_values);
@@ -0,0 +1,167 @@
+#include "plan.h"
+#include <math.h>
+#include <unistd.h>
+
+/**
+ * Fills the candidates to be probed. Returns how many there are.
+ */
+unsigned plan_candidates(plan_t *candidates) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned thread_nums[2] = {0, (cpus > 1) ? (unsigned)cpus : 0};
+    unsigned candidate_num = 0;
+
+    for (unsigned t = 0; t < ((cpus > 1) ? 2 : 1); t++) {
+        for (unsigned a = 0; a < JACOBI_ACCEL_TOTAL; a++) {
+            candidates[candidate_num].subtask_num = thread_nums[t];
+            candidates[candidate_num].accel = (jacobi_accel_e)a;
+            candidates[candidate_num].expected_delta = INFINITY;
+            candidate_num++;
+        }
+    }
+    return candidate_num;
+}
+
+/**
+ * Rate the deltas of a probe fell at an iteration, from iteration first to
+ *   last of the probe (counting from 1). 1 if they didn't fall.
+ */
+double plan_rate(const double *deltas, unsigned first, unsigned last) {
+    double rate = 1.0;
+
+    if (last > first && deltas[last-1] < deltas[first-1]) {
+        rate = pow(deltas[last-1] / deltas[first-1], 1.0 / (last - first));
+    }
+    return rate;
+}
+
+/**
+ * Probes a candidate until it has done PLAN_PROBE_ITERATIONS, converged, or
+ *   run for probe_ms, then works out the delta it is expected to reach in
+ *   left_ms more at the rates of the second half of the probe.
+ * Chebyshev acceleration is plain Jacobi until it is past its warm up and
+ *   first check, which short probes never get to, so unless the probe got
+ *   that far its rate is modelled instead: the rate it measured as plain
+ *   Jacobi is taken as rho, and the recurrence shrinks the error by
+ *   rho / (1 + sqrt(1 - rho^2)) an iteration with it.
+ */
+jacobi_err plan_probe(jacobi_ctx_t *ctx, plan_t *candidate, double probe_ms, \
+        double left_ms, double epsilon) {
+    struct timespec start, now, elapsed;
+    jacobi_err ret = JACOBI_ERR_NONE;
+    double deltas[PLAN_PROBE_ITERATIONS];
+    double delta_max = INFINITY;
+    unsigned iterations = 0;
+    double ms = 0.0;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+    while (ret == JACOBI_ERR_NONE && delta_max > epsilon && \
+            iterations < PLAN_PROBE_ITERATIONS && ms < probe_ms) {
+        unsigned last = iterations;
+        ret = jacobi_step(ctx, &delta_max);
+        iterations = jacobi_iterations(ctx);
+        // A step can do more than one iteration, which all get its delta
+        for (; last < iterations && last < PLAN_PROBE_ITERATIONS; last++) {
+            deltas[last] = delta_max;
+        }
+        clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+        timespec_diff(&now, &start, &elapsed);
+        ms = conv_timespec_to_ms(&elapsed);
+    }
+
+    if (delta_max <= epsilon || ms <= 0.0) {
+        candidate->expected_delta = delta_max;
+    }
+    else {
+        double rate;
+        if (candidate->accel == JACOBI_ACCEL_CHEBYSHEV && \
+                iterations < JACOBI_ACCEL_WARMUP + JACOBI_ACCEL_CYCLE) {
+            unsigned plain = (iterations < JACOBI_ACCEL_WARMUP) ? \
+                iterations : JACOBI_ACCEL_WARMUP;
+            double rho = plan_rate(deltas, (plain + 1) / 2, plain);
+            rate = rho / (1.0 + sqrt(1.0 - rho * rho));
+        }
+        else {
+            unsigned measured = (iterations < PLAN_PROBE_ITERATIONS) ? \
+                iterations : PLAN_PROBE_ITERATIONS;
+            rate = plan_rate(deltas, (measured + 1) / 2, measured);
+        }
+        candidate->expected_delta = delta_max * \
+            pow(rate, iterations / ms * left_ms);
+    }
+    return ret;
+}
+
+/**
+ * Probes every candidate in turn, keeping only the context of the best one
+ *   so far, then solves with it until the deadline. Candidates come serial
+ *   first and plain before accelerated, and a tie goes to the later one,
+ *   since more threads and acceleration only pull further ahead past the
+ *   probe. The time and iterations in rs include the probes, the iterations
+ *   only those of the winner.
+ */
+jacobi_err plan_solve(const jacobi_opts_t *opts, \
+        double (*input_matrix)[MATRIX_STRIDE], unsigned deadline_ms, \
+        jacobi_ctx_t **ctx, struct runtime_stats *rs, plan_t *plan) {
+    struct timespec starttime_cpu_process, starttime_real;
+    struct timespec endtime_cpu_process, endtime_real;
+    struct timespec deadline;
+    plan_t candidates[PLAN_CANDIDATES_MAX];
+    jacobi_ctx_t *best = NULL;
+    jacobi_err ret = JACOBI_ERR_NONE;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &starttime_cpu_process);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &starttime_real);
+    deadline = starttime_real;
+    timespec_add_ms(&deadline, deadline_ms);
+
+    unsigned candidate_num = plan_candidates(candidates);
+    double probe_ms = deadline_ms * PLAN_PROBE_SHARE / candidate_num;
+    double left_ms = deadline_ms * (1.0 - PLAN_PROBE_SHARE);
+
+    for (unsigned i = 0; i < candidate_num && ret == JACOBI_ERR_NONE; i++) {
+        jacobi_opts_t candidate_opts = *opts;
+        jacobi_ctx_t *candidate;
+        candidate_opts.subtask_num = candidates[i].subtask_num;
+        candidate_opts.sync = JACOBI_SYNC_BARRIER;
+        candidate_opts.accel = candidates[i].accel;
+        candidate_opts.deadline_ms = 0;
+        candidate_opts.in_place = false;
+        candidate_opts.stats = NULL;
+
+        ret = jacobi_create(&candidate, &candidate_opts, input_matrix);
+        if (ret == JACOBI_ERR_NONE) {
+            ret = plan_probe(candidate, &(candidates[i]), probe_ms, left_ms, \
+                opts->epsilon);
+            if (ret == JACOBI_ERR_NONE && (best == NULL || \
+                    candidates[i].expected_delta <= plan->expected_delta)) {
+                if (best != NULL) {
+                    jacobi_destroy(best);
+                }
+                best = candidate;
+                *plan = candidates[i];
+            }
+            else {
+                jacobi_destroy(candidate);
+            }
+        }
+    }
+
+    if (ret == JACOBI_ERR_NONE) {
+        unsigned probe_iterations = jacobi_iterations(best);
+        ret = jacobi_solve_until(best, rs, &deadline);
+        if (ret == JACOBI_ERR_NONE) {
+            clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &endtime_cpu_process);
+            clock_gettime(CLOCK_MONOTONIC_RAW, &endtime_real);
+            rs->iterations += probe_iterations;
+            timespec_diff(&endtime_cpu_process, &starttime_cpu_process, \
+                &(rs->runtime_cpu_process));
+            timespec_diff(&endtime_real, &starttime_real, &(rs->runtime_real));
+        }
+    }
+    if (ret != JACOBI_ERR_NONE && best != NULL) {
+        jacobi_destroy(best);
+        best = NULL;
+    }
+    *ctx = best;
+    return ret;
+}
@@ -0,0 +1,44 @@
+#ifndef __PLAN_H
+#define __PLAN_H
+#include "jacobi.h"
+
+// Solve planning
+// Picks the configuration expected to give the lowest max delta by a
+//   deadline. Each candidate is solved from the input for a short probe,
+//   which measures how many iterations it does a second and how fast its
+//   delta falls an iteration, and the delta it would reach by the deadline
+//   at those rates is extrapolated. A Chebyshev candidate whose probe ends
+//   before its acceleration starts gets the rate the recurrence would have
+//   with the rate it measured as rho. The context of the best candidate
+//   carries on to the deadline, so its probe is not wasted.
+// Candidates are a serial solve and, on a machine with more than one CPU, a
+//   barrier synced solve with a thread per CPU, each of them with and without
+//   Chebyshev acceleration.
+
+// Share of the budget spent probing, split evenly between the candidates
+#define PLAN_PROBE_SHARE 0.2
+// Most iterations a probe does. Enough for Chebyshev acceleration to be past
+//   its warm up and first check.
+#define PLAN_PROBE_ITERATIONS \
+    (JACOBI_ACCEL_WARMUP + JACOBI_ACCEL_CYCLE + JACOBI_ACCEL_CYCLE/2)
+#define PLAN_CANDIDATES_MAX 4
+
+// The configuration a plan picked
+typedef struct plan plan_t;
+struct plan {
+    unsigned subtask_num;
+    jacobi_accel_e accel;
+    // Max delta the plan expected the solve to reach by the deadline
+    double expected_delta;
+};
+
+// Probes the candidates for solving input_matrix with opts by deadline_ms
+//   from now, and carries on with the best one until the deadline. opts
+//   gives everything but the subtasks, sync, acceleration and deadline. The
+//   context of the solve is left in ctx, and its stats, from the start of
+//   the plan, in rs.
+jacobi_err plan_solve(const jacobi_opts_t *opts, \
+    double (*input_matrix)[MATRIX_STRIDE], unsigned deadline_ms, \
+    jacobi_ctx_t **ctx, struct runtime_stats *rs, plan_t *plan);
+
+#endif /* __PLAN_H */
@@ -0,0 +1,194 @@
+#include "pyramid.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * Index of the full size row (or column) that row i of a size wide sample
+ *   comes from. This is the same spacing matrix_file_in gets by skipping: the
+ *   first and last entries are kept, and the remainder of an uneven division
+ *   goes to the first gaps.
+ */
+unsigned pyramid_sample_index(unsigned i, unsigned size, unsigned full) {
+    unsigned skip = (full-size) / (size-1);
+    unsigned rem  = (full-size) % (size-1);
+    return i * (skip+1) + (i < rem ? i : rem);
+}
+
+/**
+ * True if the file starts with the pyramid magic.
+ */
+bool pyramid_file_check(char *fname) {
+    char magic[PYRAMID_MAGIC_LEN];
+    bool ret = false;
+
+    FILE *f = fopen(fname, "r");
+    if (f != NULL) {
+        ret = (fread(magic, 1, PYRAMID_MAGIC_LEN, f) == PYRAMID_MAGIC_LEN && \
+            memcmp(magic, PYRAMID_MAGIC, PYRAMID_MAGIC_LEN) == 0);
+        fclose(f);
+    }
+    return ret;
+}
+
+/**
+ * Writes a full size matrix and its samples at each of sizes to a pyramid
+ *   file. Sizes that are not smaller than the full size or below 2 are left
+ *   out, since the full size is always level 0.
+ */
+mat_err pyramid_file_out(double (*matrix)[MATRIX_STRIDE], unsigned *sizes, \
+        unsigned size_num, char *output_fname) {
+    pyramid_header_t header;
+    pyramid_level_t levels[PYRAMID_LEVELS_MAX];
+    FILE *output;
+    mat_err ret = MAT_ERR_NONE;
+
+    assert(MATRIX_ROWS == MATRIX_ROWS_FULL && MATRIX_COLS == MATRIX_COLS_FULL);
+    memcpy(header.magic, PYRAMID_MAGIC, PYRAMID_MAGIC_LEN);
+    header.version = PYRAMID_VERSION;
+    header.level_num = 1;
+    levels[0].rows = MATRIX_ROWS;
+    levels[0].cols = MATRIX_COLS;
+    for (unsigned i = 0; i < size_num; i++) {
+        if (sizes[i] >= 2 && sizes[i] < MATRIX_ROWS && \
+                header.level_num < PYRAMID_LEVELS_MAX) {
+            levels[header.level_num].rows = sizes[i];
+            levels[header.level_num].cols = sizes[i];
+            header.level_num++;
+        }
+    }
+
+    uint64_t offset = sizeof(pyramid_header_t) + \
+        sizeof(pyramid_level_t) * header.level_num;
+    for (unsigned level = 0; level < header.level_num; level++) {
+        offset = (offset + PYRAMID_ALIGN - 1) / PYRAMID_ALIGN * PYRAMID_ALIGN;
+        levels[level].offset = offset;
+        offset += sizeof(double) * levels[level].rows * levels[level].cols;
+    }
+
+    errno = 0;
+    output = fopen(output_fname, "w+");
+    if (output == NULL) {
+        ret = MAT_ERR_FOPEN;
+    }
+    else {
+        if (fwrite(&header, sizeof(pyramid_header_t), 1, output) != 1 || \
+                fwrite(levels, sizeof(pyramid_level_t), header.level_num, \
+                output) != header.level_num) {
+            ret = MAT_ERR_FPRINTF;
+        }
+        unsigned level = 0;
+        while (level < header.level_num && ret == MAT_ERR_NONE) {
+            unsigned rows = levels[level].rows;
+            unsigned cols = levels[level].cols;
+            double *row_buf = malloc(sizeof(double) * cols);
+            if (row_buf == NULL) {
+                ret = MAT_ERR_MALLOC;
+            }
+            else if (fseek(output, (long)levels[level].offset, SEEK_SET) < 0) {
+                ret = MAT_ERR_FPRINTF;
+            }
+            else {
+                unsigned row = 0;
+                while (row < rows && ret == MAT_ERR_NONE) {
+                    unsigned src_row = pyramid_sample_index(row, rows, \
+                        MATRIX_ROWS);
+                    for (unsigned col = 0; col < cols; col++) {
+                        row_buf[col] = matrix[src_row][ \
+                            pyramid_sample_index(col, cols, MATRIX_COLS)];
+                    }
+                    if (fwrite(row_buf, sizeof(double), cols, output) != cols) {
+                        ret = MAT_ERR_FPRINTF;
+                    }
+                    row++;
+                }
+            }
+            free(row_buf);
+            level++;
+        }
+        fclose(output);
+    }
+    return ret;
+}
+
+/**
+ * Reads a matrix from a pyramid file. Only the level this build's size needs
+ *   is mapped. If the file has no level of this size, the full size level is
+ *   mapped and sampled instead, which still avoids parsing any text.
+ */
+mat_err pyramid_file_in(double (*matrix)[MATRIX_STRIDE], char *input_fname) {
+    pyramid_header_t header;
+    pyramid_level_t levels[PYRAMID_LEVELS_MAX];
+    struct stat st;
+    int fd;
+    mat_err ret = MAT_ERR_NONE;
+
+    errno = 0;
+    fd = open(input_fname, O_RDONLY);
+    if (fd < 0) {
+        ret = MAT_ERR_FOPEN;
+    }
+    else {
+        if (pread(fd, &header, sizeof(pyramid_header_t), 0) != \
+                sizeof(pyramid_header_t) || \
+                memcmp(header.magic, PYRAMID_MAGIC, PYRAMID_MAGIC_LEN) != 0 || \
+                header.version != PYRAMID_VERSION || header.level_num == 0 || \
+                header.level_num > PYRAMID_LEVELS_MAX || \
+                pread(fd, levels, sizeof(pyramid_level_t) * header.level_num, \
+                sizeof(pyramid_header_t)) != \
+                (ssize_t)(sizeof(pyramid_level_t) * header.level_num) || \
+                levels[0].rows != MATRIX_ROWS_FULL || \
+                levels[0].cols != MATRIX_COLS_FULL || fstat(fd, &st) < 0) {
+            errno = EILSEQ;
+            ret = MAT_ERR_FSCANF;
+        }
+        else {
+            unsigned level = 0;
+            for (unsigned i = 0; i < header.level_num; i++) {
+                if (levels[i].rows == MATRIX_ROWS && \
+                        levels[i].cols == MATRIX_COLS) {
+                    level = i;
+                }
+            }
+            unsigned rows = levels[level].rows;
+            unsigned cols = levels[level].cols;
+            size_t bytes = sizeof(double) * rows * cols;
+            // mmap offsets have to be page aligned
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            size_t head = levels[level].offset % page;
+
+            if (levels[level].offset + bytes > (uint64_t)st.st_size) {
+                errno = EILSEQ;
+                ret = MAT_ERR_FSCANF;
+            }
+            else {
+                char *map = mmap(NULL, head + bytes, PROT_READ, MAP_PRIVATE, \
+                    fd, (off_t)(levels[level].offset - head));
+                if (map == MAP_FAILED) {
+                    ret = MAT_ERR_FSCANF;
+                }
+                else {
+                    const double *data = (const double*)(map + head);
+                    madvise(map, head + bytes, MADV_SEQUENTIAL);
+                    for (unsigned row = 0; row < MATRIX_ROWS; row++) {
+                        if (rows == MATRIX_ROWS && cols == MATRIX_COLS) {
+                            memcpy(matrix[row], data + (size_t)row * cols, \
+                                sizeof(double) * cols);
+                        }
+                        else {
+                            const double *src = data + (size_t)cols * \
+                                pyramid_sample_index(row, MATRIX_ROWS, rows);
+                            for (unsigned col = 0; col < MATRIX_COLS; col++) {
+                                matrix[row][col] = src[pyramid_sample_index( \
+                                    col, MATRIX_COLS, cols)];
+                            }
+                        }
+                    }
+                    munmap(map, head + bytes);
+                }
+            }
+        }
+        close(fd);
+    }
+    return ret;
+}
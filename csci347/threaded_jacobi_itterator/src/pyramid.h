@@ -0,0 +1,52 @@
+#ifndef __PYRAMID_H
+#define __PYRAMID_H
+#include "matrix.h"
+#include <stdint.h>
+
+// Pyramid matrix files
+// A pyramid file holds a full size matrix along with downsampled copies of it,
+//   so a run at any of the stored sizes maps its level straight into memory
+//   instead of seeking through the text file for every sampled value.
+// Layout, all in host byte order:
+//   pyramid_header_t
+//   pyramid_level_t for each level, level 0 is always the full size matrix
+//   the levels, each rows * cols doubles with no padding, starting on a
+//     PYRAMID_ALIGN boundary
+// A level is sampled exactly the way matrix_file_in samples a text file, so
+//   loading a level gives the same matrix as loading the text file at that size.
+
+#define PYRAMID_MAGIC "JPYRAMID"
+#define PYRAMID_MAGIC_LEN 8
+#define PYRAMID_VERSION 1
+#define PYRAMID_LEVELS_MAX 16
+#define PYRAMID_ALIGN 4096
+// Smallest level stored by default, the default levels are every 2^k + 2 from
+//   here up to the full size (a power of 2 of free cells plus a boundary).
+#define PYRAMID_MIN_SIZE 6
+
+typedef struct pyramid_header pyramid_header_t;
+struct pyramid_header {
+    char magic[PYRAMID_MAGIC_LEN];
+    uint32_t version;
+    uint32_t level_num;
+};
+
+typedef struct pyramid_level pyramid_level_t;
+struct pyramid_level {
+    uint32_t rows;
+    uint32_t cols;
+    // Byte offset of the level from the start of the file
+    uint64_t offset;
+};
+
+// Index of the full size row (or column) that row i of a size wide sample
+//   comes from.
+unsigned pyramid_sample_index(unsigned i, unsigned size, unsigned full);
+
+// Pyramid file operations
+bool pyramid_file_check(char *fname);
+mat_err pyramid_file_out(double (*matrix)[MATRIX_STRIDE], unsigned *sizes, \
+    unsigned size_num, char *output_fname);
+mat_err pyramid_file_in(double (*matrix)[MATRIX_STRIDE], char *input_fname);
+
+#endif /* __PYRAMID_H */
@@ -0,0 +1,156 @@
+#include "roofline.h"
+#include "jacobi.h"
+
+// Shared state of a STREAM probe
+typedef struct stream_probe stream_probe_t;
+struct stream_probe {
+    double *a;
+    double *b;
+    double *c;
+    unsigned thread_num;
+    barrier_t start;
+    barrier_t done;
+    // Like the subtasks, threads wait on creation_wait until every one of
+    //   them has been created, and only run the probe if run is set.
+    sem_t creation_wait;
+    bool run;
+};
+
+// Arguments of a STREAM probe thread
+typedef struct stream_arg stream_arg_t;
+struct stream_arg {
+    stream_probe_t *probe;
+    unsigned long start;
+    unsigned long end;
+};
+
+/**
+ * Works out the achieved rates of a run. Bandwidth is only held against the
+ *   roof if a probe was run.
+ */
+void roofline_compute(roofline_t *rl, unsigned long cells, \
+        unsigned iterations, const stencil_t *stencil, double real_ms, \
+        double stream_gbs) {
+    double seconds = real_ms / 1000.0;
+
+    rl->cell_updates = (double)cells * iterations;
+    rl->gbs = 0.0;
+    rl->gflops = 0.0;
+    if (seconds > 0.0) {
+        rl->gbs = rl->cell_updates * ROOFLINE_CELL_BYTES / seconds / 1e9;
+        rl->gflops = rl->cell_updates * ROOFLINE_CELL_FLOPS(stencil->points) \
+            / seconds / 1e9;
+    }
+    rl->stream_gbs = (stream_gbs > 0.0) ? stream_gbs : 0.0;
+    rl->roof_pct = 0.0;
+    if (rl->stream_gbs > 0.0) {
+        rl->roof_pct = rl->gbs / rl->stream_gbs * 100.0;
+    }
+}
+
+/**
+ * Does the triads of one thread's share of the arrays. The thread writes its
+ *   share first, so the pages end up local to it.
+ */
+void* stream_thread(void *arg) {
+    stream_arg_t *stream_arg = (stream_arg_t*)arg;
+    stream_probe_t *probe = stream_arg->probe;
+    double *a = probe->a, *b = probe->b, *c = probe->c;
+    const double scalar = 3.0;
+
+    sem_wait(&(probe->creation_wait));
+    for (unsigned long i = stream_arg->start; i < stream_arg->end; i++) {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+    for (int trial = 0; trial < ROOFLINE_STREAM_TRIALS && probe->run; \
+            trial++) {
+        barrier_wait(&(probe->start), pthread_self());
+        for (unsigned long i = stream_arg->start; i < stream_arg->end; i++) {
+            a[i] = b[i] + scalar * c[i];
+        }
+        barrier_wait(&(probe->done), pthread_self());
+    }
+    return NULL;
+}
+
+/**
+ * Measures memory bandwidth with a STREAM triad, a = b + s * c, split across
+ *   thread_num threads. The calling thread only times each trial, between a
+ *   barrier that starts all the threads and one that waits for all of them.
+ *   Counts 3 doubles moved per element, as STREAM does.
+ */
+double roofline_stream_probe(unsigned thread_num) {
+    stream_probe_t probe;
+    pthread_t *threads;
+    stream_arg_t *args;
+    struct timespec start, end, diff;
+    double best = -1.0;
+
+    if (thread_num == 0) {
+        thread_num = 1;
+    }
+    probe.thread_num = thread_num;
+    probe.a = malloc(sizeof(double) * ROOFLINE_STREAM_DOUBLES);
+    probe.b = malloc(sizeof(double) * ROOFLINE_STREAM_DOUBLES);
+    probe.c = malloc(sizeof(double) * ROOFLINE_STREAM_DOUBLES);
+    threads = malloc(sizeof(pthread_t) * thread_num);
+    args = malloc(sizeof(stream_arg_t) * thread_num);
+
+    if (probe.a != NULL && probe.b != NULL && probe.c != NULL && \
+            threads != NULL && args != NULL && \
+            barrier_init(&(probe.start), PTHREAD_BARRIER, thread_num+1, \
+            NULL) == 0) {
+        if (barrier_init(&(probe.done), PTHREAD_BARRIER, thread_num+1, \
+                NULL) == 0) {
+            unsigned t = 0;
+            bool started = true;
+            sem_init(&(probe.creation_wait), 0, 0);
+            while (t < thread_num && started) {
+                args[t].probe = &probe;
+                args[t].start = ROOFLINE_STREAM_DOUBLES * t / thread_num;
+                args[t].end = ROOFLINE_STREAM_DOUBLES * (t+1) / thread_num;
+                started = (pthread_create(&(threads[t]), NULL, stream_thread, \
+                    (void*)&(args[t])) == 0);
+                if (started) {
+                    t++;
+                }
+            }
+            // The barriers count on every thread, so the probe can only run
+            //   if they all started
+            probe.run = (t == thread_num);
+            for (unsigned i = 0; i < t; i++) {
+                sem_post(&(probe.creation_wait));
+            }
+            if (probe.run) {
+                for (int trial = 0; trial < ROOFLINE_STREAM_TRIALS; trial++) {
+                    barrier_wait(&(probe.start), pthread_self());
+                    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+                    barrier_wait(&(probe.done), pthread_self());
+                    clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+
+                    timespec_diff(&end, &start, &diff);
+                    double seconds = diff.tv_sec + diff.tv_nsec / 1e9;
+                    double gbs = 3.0 * sizeof(double) * \
+                        ROOFLINE_STREAM_DOUBLES / seconds / 1e9;
+                    if (gbs > best) {
+                        best = gbs;
+                    }
+                }
+            }
+            for (unsigned i = 0; i < t; i++) {
+                pthread_join(threads[i], NULL);
+            }
+            sem_destroy(&(probe.creation_wait));
+            barrier_delete(&(probe.done));
+        }
+        barrier_delete(&(probe.start));
+    }
+    free(probe.a);
+    free(probe.b);
+    free(probe.c);
+    free(threads);
+    free(args);
+    return best;
+}
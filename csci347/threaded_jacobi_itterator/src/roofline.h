@@ -0,0 +1,44 @@
+#ifndef __ROOFLINE_H
+#define __ROOFLINE_H
+#include "stencil.h"
+
+// Roofline instrumentation
+// A run's rates are worked out from the number of cell updates it did:
+//   each update does ROOFLINE_CELL_FLOPS and moves ROOFLINE_CELL_BYTES. The
+//   bytes are the streaming minimum, one read of the old value and one write
+//   of the new one, with the neighbours coming from cache. Like STREAM, write
+//   allocate traffic is not counted.
+// A Jacobi stencil does a fraction of a FLOP per byte, so it is bound by
+//   memory bandwidth on any current machine, and the roof it is held against
+//   is the bandwidth of a STREAM triad measured on this host.
+
+// A multiply and an add per point, one less add for the first point, and a
+//   subtract for the delta
+#define ROOFLINE_CELL_FLOPS(points) (2 * (points))
+#define ROOFLINE_CELL_BYTES (2 * sizeof(double))
+
+// Size of each of the three triad arrays. Big enough to fall out of any L3.
+#define ROOFLINE_STREAM_DOUBLES (8UL * 1024UL * 1024UL)
+// The probe reports the best of this many triads
+#define ROOFLINE_STREAM_TRIALS 5
+
+typedef struct roofline roofline_t;
+struct roofline {
+    double cell_updates;
+    double gbs;
+    double gflops;
+    // Bandwidth of the STREAM probe, 0 if it was not run
+    double stream_gbs;
+    // Achieved bandwidth as a percentage of stream_gbs
+    double roof_pct;
+};
+
+// Works out the rates of a run of iterations over cells active cells
+void roofline_compute(roofline_t *rl, unsigned long cells, \
+    unsigned iterations, const stencil_t *stencil, double real_ms, \
+    double stream_gbs);
+// Measures the memory bandwidth of a triad on thread_num threads in GB/s.
+//   Returns a negative value if the probe could not run.
+double roofline_stream_probe(unsigned thread_num);
+
+#endif /* __ROOFLINE_H */
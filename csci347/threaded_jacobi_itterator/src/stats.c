@@ -0,0 +1,224 @@
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Threads start on the first cache line after the header
+#define STATS_THREADS_OFFSET \
+    ((sizeof(stats_header_t) + STATS_LINE-1) / STATS_LINE * STATS_LINE)
+
+/**
+ * CLOCK_MONOTONIC in ns.
+ */
+uint64_t stats_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
+/**
+ * Opens and maps a segment, either creating it with room for thread_num
+ *   threads or attaching to it read only and sizing it from the file.
+ */
+int stats_map(stats_t *stats, pid_t pid, bool create, unsigned thread_num) {
+    struct stat st;
+    int ret = 0;
+
+    snprintf(stats->name, sizeof(stats->name), "%s%d", STATS_SHM_PREFIX, \
+        (int)pid);
+    stats->owner = create;
+
+    errno = 0;
+    int fd = shm_open(stats->name, create ? (O_RDWR | O_CREAT | O_TRUNC) : \
+        O_RDONLY, 0644);
+    if (fd < 0) {
+        ret = -1;
+    }
+    else {
+        if (create) {
+            stats->bytes = STATS_THREADS_OFFSET + \
+                sizeof(stats_thread_t) * thread_num;
+            if (ftruncate(fd, (off_t)stats->bytes) < 0) {
+                ret = -1;
+            }
+        }
+        else if (fstat(fd, &st) < 0) {
+            ret = -1;
+        }
+        else if ((size_t)st.st_size < STATS_THREADS_OFFSET) {
+            errno = EINVAL;
+            ret = -1;
+        }
+        else {
+            stats->bytes = (size_t)st.st_size;
+        }
+
+        if (ret == 0) {
+            void *map = mmap(NULL, stats->bytes, create ? \
+                (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                ret = -1;
+            }
+            else {
+                stats->header = (stats_header_t*)map;
+                stats->threads = (stats_thread_t*)((char*)map + \
+                    STATS_THREADS_OFFSET);
+            }
+        }
+        close(fd);
+        if (ret < 0 && create) {
+            shm_unlink(stats->name);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Creates the segment of this process. The fields that never change are set
+ *   here, before any reader can see a valid magic.
+ */
+int stats_create(stats_t *stats, unsigned thread_num, uint64_t cells, \
+        double epsilon) {
+    int ret = stats_map(stats, getpid(), true, thread_num);
+
+    if (ret == 0) {
+        stats->header->thread_num = thread_num;
+        stats->header->pid = (int32_t)getpid();
+        stats->header->cells = cells;
+        stats->header->epsilon = epsilon;
+        stats->header->start_ns = stats_now_ns();
+        stats->header->update_ns = stats->header->start_ns;
+        stats->header->state = STATS_RUNNING;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(stats->header->magic, STATS_MAGIC, STATS_MAGIC_LEN);
+    }
+    return ret;
+}
+
+/**
+ * Unmaps the segment, and removes it if this process made it.
+ */
+void stats_delete(stats_t *stats) {
+    munmap(stats->header, stats->bytes);
+    if (stats->owner) {
+        shm_unlink(stats->name);
+    }
+}
+
+/**
+ * Attaches to the segment of pid. Fails with EAGAIN if the segment is not
+ *   set up yet.
+ */
+int stats_attach(stats_t *stats, pid_t pid) {
+    int ret = stats_map(stats, pid, false, 0);
+
+    if (ret == 0) {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (memcmp(stats->header->magic, STATS_MAGIC, STATS_MAGIC_LEN) != 0 \
+         || stats->bytes < STATS_THREADS_OFFSET + sizeof(stats_thread_t) * \
+                stats->header->thread_num) {
+            stats_delete(stats);
+            errno = EAGAIN;
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Detaches from a segment, leaving it to its owner.
+ */
+void stats_detach(stats_t *stats) {
+    stats_delete(stats);
+}
+
+/**
+ * Starts a seqlock write: seq goes odd before any field changes.
+ */
+static inline void stats_write_begin(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * Ends a seqlock write: seq goes even after every field has changed.
+ */
+static inline void stats_write_end(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copies src to dst once no write is in progress and none happened during the
+ *   copy.
+ */
+static void stats_read_entry(const uint32_t *seq, void *dst, const void *src, \
+        size_t bytes) {
+    uint32_t before, after;
+
+    do {
+        before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        memcpy(dst, src, bytes);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    } while ((before & 1) != 0 || before != after);
+}
+
+/**
+ * Publishes the progress of the whole solve.
+ */
+void stats_publish(stats_t *stats, unsigned iterations, double delta_max) {
+    stats_header_t *header = stats->header;
+
+    stats_write_begin(&(header->seq));
+    header->iterations = iterations;
+    header->delta_max = delta_max;
+    header->update_ns = stats_now_ns();
+    stats_write_end(&(header->seq));
+}
+
+/**
+ * Publishes the progress of one thread.
+ */
+void stats_thread_publish(stats_t *stats, unsigned thread, \
+        unsigned iterations, uint64_t busy_ns, uint64_t wait_ns, double delta) {
+    stats_thread_t *entry = &(stats->threads[thread]);
+
+    stats_write_begin(&(entry->seq));
+    entry->iterations = iterations;
+    entry->busy_ns = busy_ns;
+    entry->wait_ns = wait_ns;
+    entry->delta = delta;
+    stats_write_end(&(entry->seq));
+}
+
+/**
+ * Marks the solve as finished.
+ */
+void stats_done(stats_t *stats) {
+    stats_header_t *header = stats->header;
+
+    stats_write_begin(&(header->seq));
+    header->state = STATS_DONE;
+    header->update_ns = stats_now_ns();
+    stats_write_end(&(header->seq));
+}
+
+/**
+ * Takes a snapshot of the segment. Each entry is consistent by itself, but
+ *   they are read one after the other, so entries may be from slightly
+ *   different times.
+ */
+void stats_read(stats_t *stats, stats_header_t *header, \
+        stats_thread_t *threads) {
+    stats_read_entry(&(stats->header->seq), header, stats->header, \
+        sizeof(stats_header_t));
+    for (unsigned i = 0; i < header->thread_num; i++) {
+        stats_read_entry(&(stats->threads[i].seq), &(threads[i]), \
+            &(stats->threads[i]), sizeof(stats_thread_t));
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef __STATS_H
+#define __STATS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Live solve stats
+// A solve can publish its progress to a POSIX shared memory segment named
+//   after its pid, which jacobi_top attaches to. The segment is a
+//   stats_header_t followed by a stats_thread_t for every thread.
+// Every entry has a single writer, so updates are seqlocks: the writer makes
+//   seq odd, stores the fields and makes it even again, and a reader retries
+//   its copy until it sees the same even seq before and after. Writers never
+//   wait and each thread only writes its own cache line, once an iteration.
+
+#define STATS_SHM_PREFIX "/jacobi_stats."
+#define STATS_MAGIC "JSTATS01"
+#define STATS_MAGIC_LEN 8
+#define STATS_LINE 64
+
+// Where a solve is at
+typedef enum stats_state_e stats_state_e;
+enum stats_state_e {
+    STATS_RUNNING = 0,
+    STATS_DONE    = 1,
+    STATS_TOTAL   = 2
+};
+
+// Solve wide stats, written by the controlling thread
+typedef struct stats_header stats_header_t;
+struct stats_header {
+    char magic[STATS_MAGIC_LEN];
+    uint32_t thread_num;
+    int32_t pid;
+    // Cells updated each iteration
+    uint64_t cells;
+    double epsilon;
+    // CLOCK_MONOTONIC times in ns
+    uint64_t start_ns;
+    uint64_t update_ns;
+    uint32_t seq;
+    uint32_t state;
+    uint32_t iterations;
+    uint32_t unused;
+    double delta_max;
+};
+
+// Stats of one thread, alone on its cache line
+typedef struct stats_thread stats_thread_t;
+struct stats_thread {
+    uint32_t seq;
+    uint32_t iterations;
+    // Time spent working and waiting on barriers or neighbours
+    uint64_t busy_ns;
+    uint64_t wait_ns;
+    double delta;
+    char pad[STATS_LINE - 2 * sizeof(uint32_t) - 2 * sizeof(uint64_t) - \
+        sizeof(double)];
+};
+
+typedef struct stats stats_t;
+struct stats {
+    stats_header_t *header;
+    stats_thread_t *threads;
+    size_t bytes;
+    bool owner;
+    char name[32];
+};
+
+// CLOCK_MONOTONIC in ns
+uint64_t stats_now_ns(void);
+
+// Creates the segment of this process for thread_num threads, and unlinks it
+//   again in stats_delete. Returns -1 and sets errno on failure.
+int stats_create(stats_t *stats, unsigned thread_num, uint64_t cells, \
+    double epsilon);
+void stats_delete(stats_t *stats);
+// Attaches to the segment of another process read only. Returns -1 and sets
+//   errno on failure.
+int stats_attach(stats_t *stats, pid_t pid);
+void stats_detach(stats_t *stats);
+
+// Writers
+void stats_publish(stats_t *stats, unsigned iterations, double delta_max);
+void stats_thread_publish(stats_t *stats, unsigned thread, \
+    unsigned iterations, uint64_t busy_ns, uint64_t wait_ns, double delta);
+void stats_done(stats_t *stats);
+
+// Reader. Copies a consistent snapshot of the header and every thread into
+//   header and threads, which holds header->thread_num entries.
+void stats_read(stats_t *stats, stats_header_t *header, \
+    stats_thread_t *threads);
+
+#endif /* __STATS_H */
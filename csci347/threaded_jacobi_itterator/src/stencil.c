@@ -0,0 +1,36 @@
+// The kernels only ever see finite values, and the delta max reduction can
+//   only be vectorized once gcc is allowed to assume that.
+#pragma GCC optimize ("tree-vectorize", "finite-math-only", "no-signed-zeros")
+#include "stencil.h"
+#include <stdlib.h>
+
+// Kernel instantiations. Each one is its own fully specialized function.
+static STENCIL_DEFINE_ROW(stencil_2d_5pt_row, double, STENCIL_SHAPE_2D_5PT)
+static STENCIL_DEFINE_ROW(stencil_2d_9pt_row, double, STENCIL_SHAPE_2D_9PT)
+static STENCIL_DEFINE_ACCEL_ROW(stencil_2d_5pt_accel_row, double, \
+    STENCIL_SHAPE_2D_5PT)
+static STENCIL_DEFINE_ACCEL_ROW(stencil_2d_9pt_accel_row, double, \
+    STENCIL_SHAPE_2D_9PT)
+static STENCIL_DEFINE_MULTI_ROW(stencil_2d_5pt_multi_row, double, \
+    STENCIL_SHAPE_2D_5PT)
+static STENCIL_DEFINE_MULTI_ROW(stencil_2d_9pt_multi_row, double, \
+    STENCIL_SHAPE_2D_9PT)
+
+// All the stencils the solver can run, indexed by stencil_e
+static const stencil_t stencils[STENCIL_TOTAL] = {
+    {"2d_5pt", 2, STENCIL_POINTS(STENCIL_SHAPE_2D_5PT), stencil_2d_5pt_row, \
+        stencil_2d_5pt_accel_row, stencil_2d_5pt_multi_row},
+    {"2d_9pt", 2, STENCIL_POINTS(STENCIL_SHAPE_2D_9PT), stencil_2d_9pt_row, \
+        stencil_2d_9pt_accel_row, stencil_2d_9pt_multi_row}
+};
+
+/**
+ * Gets the stencil for a given id. If stencil_id is invalid the program
+ *   aborts.
+ */
+const stencil_t *stencil_get(stencil_e stencil_id) {
+    if (stencil_id >= STENCIL_TOTAL) {
+        abort();
+    }
+    return &(stencils[stencil_id]);
+}
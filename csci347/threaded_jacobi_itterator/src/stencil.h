@@ -0,0 +1,174 @@
+#ifndef __STENCIL_H
+#define __STENCIL_H
+#include <math.h>
+#include <stddef.h>
+
+// Window of rows a kernel can read from. Rows are picked by plane (z) and row
+//   (y) relative to the updated cell, each 0 for before, 1 for the same, and
+//   2 for after. 2D kernels only ever read the z = 1 rows.
+#define STENCIL_WINDOW 9
+#define STENCIL_ROW(z, y) ((z) * 3 + (y))
+
+// Stencil shapes. Each is an X-macro of X(z, y, dx, weight) with one entry per
+//   point of the stencil, so expanding it unrolls the whole stencil.
+// The weights of the 5 point stencil are a power of 2, so it gives bit for bit
+//   the same results as summing the neighbours and dividing by 4.
+#define STENCIL_SHAPE_2D_5PT(X) \
+    X(1, 1,  1, 0.25) \
+    X(1, 1, -1, 0.25) \
+    X(1, 2,  0, 0.25) \
+    X(1, 0,  0, 0.25)
+
+#define STENCIL_SHAPE_2D_9PT(X) \
+    X(1, 1,  1, 0.2)  \
+    X(1, 1, -1, 0.2)  \
+    X(1, 2,  0, 0.2)  \
+    X(1, 0,  0, 0.2)  \
+    X(1, 0, -1, 0.05) \
+    X(1, 0,  1, 0.05) \
+    X(1, 2, -1, 0.05) \
+    X(1, 2,  1, 0.05)
+
+#define STENCIL_SHAPE_3D_7PT(X) \
+    X(1, 1,  1, 1.0 / 6.0) \
+    X(1, 1, -1, 1.0 / 6.0) \
+    X(1, 2,  0, 1.0 / 6.0) \
+    X(1, 0,  0, 1.0 / 6.0) \
+    X(2, 1,  0, 1.0 / 6.0) \
+    X(0, 1,  0, 1.0 / 6.0)
+
+// Helpers to count the points of a shape at compile time
+#define STENCIL_COUNT_POINT(z, y, dx, w) + 1
+#define STENCIL_POINTS(SHAPE) (0 SHAPE(STENCIL_COUNT_POINT))
+
+// One term of the weighted sum of a stencil
+#define STENCIL_TERM(z, y, dx, w) + (w) * rows[STENCIL_ROW(z, y)][col + (dx)]
+
+// Defines a row kernel called name for a stencil shape on elements of type.
+//   The kernel updates the columns [col_start, col_end) of one row into out
+//   and returns the max delta of the row, or delta_max if that is larger.
+// Everything about the stencil is a constant here, so every instantiation is
+//   fully unrolled and the column loop is left free to vectorize.
+#define STENCIL_DEFINE_ROW(name, type, SHAPE) \
+double name(const type *const *rows, type *restrict out, \
+        unsigned col_start, unsigned col_end, double delta_max) { \
+    const type *mid = rows[STENCIL_ROW(1, 1)]; \
+    for (unsigned col = col_start; col < col_end; col++) { \
+        type estimate = (type)(SHAPE(STENCIL_TERM)); \
+        double delta = fabs((double)mid[col] - (double)estimate); \
+        out[col] = estimate; \
+        delta_max = (delta > delta_max) ? delta : delta_max; \
+    } \
+    return delta_max; \
+}
+
+// Defines an accelerated row kernel called name, for Chebyshev iteration.
+//   Like a row kernel, except out holds the row from the iteration before the
+//   one in rows, and is moved omega of the way from there to the estimate.
+//   The delta is still that of plain Jacobi, so convergence means the same.
+#define STENCIL_DEFINE_ACCEL_ROW(name, type, SHAPE) \
+double name(const type *const *rows, type *restrict out, \
+        unsigned col_start, unsigned col_end, double delta_max, \
+        double omega) { \
+    const type *mid = rows[STENCIL_ROW(1, 1)]; \
+    for (unsigned col = col_start; col < col_end; col++) { \
+        type estimate = (type)(SHAPE(STENCIL_TERM)); \
+        double delta = fabs((double)mid[col] - (double)estimate); \
+        out[col] = out[col] + (type)omega * (estimate - out[col]); \
+        delta_max = (delta > delta_max) ? delta : delta_max; \
+    } \
+    return delta_max; \
+}
+
+// One term of the weighted sum of a stencil over interleaved problems
+#define STENCIL_MULTI_TERM(z, y, dx, w) \
+    + (w) * rows[STENCIL_ROW(z, y)][cell + (dx) * stride + lane]
+
+// Lanes an interleaved kernel works on at a time
+#define STENCIL_MULTI_BLOCK 8
+
+// Works out lane_num lanes of a block along a row, for the kernel below
+#define STENCIL_MULTI_CELLS(type, SHAPE, lane_num) \
+    for (unsigned col = col_start; col < col_end; col++) { \
+        ptrdiff_t cell = (ptrdiff_t)col * stride + first; \
+        for (ptrdiff_t lane = 0; lane < (lane_num); lane++) { \
+            type estimate = (type)(SHAPE(STENCIL_MULTI_TERM)); \
+            double delta = fabs((double)mid[cell + lane] - \
+                (double)estimate); \
+            out[cell + lane] = estimate; \
+            block_deltas[lane] = (delta > block_deltas[lane]) ? \
+                delta : block_deltas[lane]; \
+        } \
+    }
+
+// Defines a row kernel called name for rows of interleaved problems, where
+//   every cell holds a lane for each of lanes problems side by side. The first
+//   active lanes get their max delta kept in deltas, if it is larger.
+// Lanes are worked on a block at a time, with the block's deltas in locals,
+//   so the loop over the lanes of a block vectorizes with nothing but the
+//   cells going through memory. Full blocks have a constant number of lanes,
+//   so it is unrolled too. lanes must be a multiple of the block, or smaller
+//   than it. The lanes past active in the last block are worked out too,
+//   which is harmless, since nothing reads them. Indices are signed and
+//   pointer sized so gcc can tell the lanes are contiguous.
+#define STENCIL_DEFINE_MULTI_ROW(name, type, SHAPE) \
+void name(const type *const *rows, type *restrict out, \
+        unsigned col_start, unsigned col_end, unsigned lanes, \
+        unsigned active, double *restrict deltas) { \
+    const type *mid = rows[STENCIL_ROW(1, 1)]; \
+    ptrdiff_t stride = (ptrdiff_t)lanes; \
+    ptrdiff_t block = (lanes < STENCIL_MULTI_BLOCK) ? stride : \
+        STENCIL_MULTI_BLOCK; \
+    for (ptrdiff_t first = 0; first < (ptrdiff_t)active; first += block) { \
+        double block_deltas[STENCIL_MULTI_BLOCK] = {0.0}; \
+        if (block == STENCIL_MULTI_BLOCK) { \
+            STENCIL_MULTI_CELLS(type, SHAPE, STENCIL_MULTI_BLOCK) \
+        } \
+        else { \
+            STENCIL_MULTI_CELLS(type, SHAPE, block) \
+        } \
+        for (ptrdiff_t lane = 0; lane < block && \
+                first + lane < (ptrdiff_t)active; lane++) { \
+            if (block_deltas[lane] > deltas[first + lane]) { \
+                deltas[first + lane] = block_deltas[lane]; \
+            } \
+        } \
+    } \
+}
+
+// Row kernel signature for double matrices
+typedef double (*stencil_row_f)(const double *const *rows, \
+    double *restrict out, unsigned col_start, unsigned col_end, \
+    double delta_max);
+typedef double (*stencil_accel_row_f)(const double *const *rows, \
+    double *restrict out, unsigned col_start, unsigned col_end, \
+    double delta_max, double omega);
+typedef void (*stencil_multi_row_f)(const double *const *rows, \
+    double *restrict out, unsigned col_start, unsigned col_end, \
+    unsigned lanes, unsigned active, double *restrict deltas);
+
+// enum to uniquely id each stencil the solver can run
+typedef enum stencil_e stencil_e;
+enum stencil_e {
+    STENCIL_2D_5PT = 0,
+    STENCIL_2D_9PT = 1,
+    STENCIL_TOTAL  = 2
+};
+
+// A stencil the solver can run. points is the number of neighbours the row
+//   kernel sums for each cell. accel_row is the kernel of Chebyshev solves,
+//   multi_row that of interleaved solves.
+typedef struct stencil stencil_t;
+struct stencil {
+    const char *name;
+    unsigned dimensions;
+    unsigned points;
+    stencil_row_f row;
+    stencil_accel_row_f accel_row;
+    stencil_multi_row_f multi_row;
+};
+
+// Gets the stencil for a given id. Aborts if stencil_id is invalid.
+const stencil_t *stencil_get(stencil_e stencil_id);
+
+#endif /* __STENCIL_H */
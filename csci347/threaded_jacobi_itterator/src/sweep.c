@@ -0,0 +1,254 @@
+#include "sweep.h"
+#include <math.h>
+
+// Where sweep_flush leaves what it read
+static volatile unsigned long sweep_flush_sink;
+
+/**
+ * Parses a comma separated list of numbers and a..b ranges into values.
+ *   Returns -1 if the list is empty, a range is backwards or starts at 0, or
+ *   there are more than SWEEP_LIST_MAX values. list is cut up by strtok_r.
+ */
+int sweep_parse_list(unsigned *values, unsigned *value_num, char *list) {
+    char *save = NULL;
+    char *item = strtok_r(list, ",", &save);
+    int ret = 0;
+
+    *value_num = 0;
+    if (item == NULL) {
+        ret = -1;
+    }
+    while (item != NULL && ret == 0) {
+        char *end;
+        unsigned long first = strtoul(item, &end, 10);
+        unsigned long last = first;
+        if (end == item) {
+            ret = -1;
+        }
+        else if (strncmp(end, "..", 2) == 0) {
+            char *range_end = end + 2;
+            last = strtoul(range_end, &end, 10);
+            if (end == range_end || first == 0 || last < first) {
+                ret = -1;
+            }
+        }
+        if (ret == 0 && *end != '\0') {
+            ret = -1;
+        }
+        for (unsigned long v = first; v <= last && ret == 0; v *= 2) {
+            if (*value_num == SWEEP_LIST_MAX) {
+                ret = -1;
+            }
+            else {
+                values[(*value_num)++] = (unsigned)v;
+            }
+            if (v == 0) {
+                break;
+            }
+        }
+        item = strtok_r(NULL, ",", &save);
+    }
+    return ret;
+}
+
+/**
+ * Parses a sweep spec, see sweep.h. Keys left out get their defaults.
+ */
+int sweep_parse(sweep_t *sweep, const char *spec) {
+    char *copy, *save = NULL;
+    int ret = 0;
+
+    sweep->barrier_num = BARRIER_TOTAL;
+    for (unsigned i = 0; i < BARRIER_TOTAL; i++) {
+        sweep->barriers[i] = i;
+    }
+    sweep->threads[0] = 1;
+    sweep->thread_num = 1;
+    sweep->samples = 1;
+    sweep->flush = false;
+
+    errno = 0;
+    copy = strdup(spec);
+    if (copy == NULL) {
+        ret = -1;
+    }
+    else {
+        char *key = strtok_r(copy, " ", &save);
+        while (key != NULL && ret == 0) {
+            char *value = strchr(key, '=');
+            if (value == NULL) {
+                ret = -1;
+            }
+            else {
+                *(value++) = '\0';
+                if (strcmp(key, "barriers") == 0) {
+                    ret = sweep_parse_list(sweep->barriers, \
+                        &(sweep->barrier_num), value);
+                    for (unsigned i = 0; i < sweep->barrier_num; i++) {
+                        if (sweep->barriers[i] >= BARRIER_TOTAL) {
+                            ret = -1;
+                        }
+                    }
+                }
+                else if (strcmp(key, "threads") == 0) {
+                    ret = sweep_parse_list(sweep->threads, \
+                        &(sweep->thread_num), value);
+                }
+                else if (strcmp(key, "samples") == 0) {
+                    sweep->samples = (unsigned)strtoul(value, NULL, 10);
+                    if (sweep->samples == 0) {
+                        ret = -1;
+                    }
+                }
+                else if (strcmp(key, "flush") == 0) {
+                    unsigned long flush = strtoul(value, NULL, 10);
+                    if (flush > 1) {
+                        ret = -1;
+                    }
+                    sweep->flush = (flush == 1);
+                }
+                else {
+                    ret = -1;
+                }
+            }
+            key = strtok_r(NULL, " ", &save);
+        }
+        free(copy);
+    }
+    return ret;
+}
+
+/**
+ * Writes all of flush_buf, SWEEP_FLUSH_BYTES long, and reads it back so the
+ *   writes can't be left out.
+ */
+void sweep_flush(unsigned long *flush_buf) {
+    unsigned long sum = 0;
+
+    for (size_t i = 0; i < SWEEP_FLUSH_BYTES / sizeof(unsigned long); i++) {
+        flush_buf[i] += i;
+        sum += flush_buf[i];
+    }
+    sweep_flush_sink = sum;
+}
+
+/**
+ * Largest difference between two matrices.
+ */
+double sweep_max_diff(double (*a)[MATRIX_STRIDE], \
+        double (*b)[MATRIX_STRIDE]) {
+    double max_diff = 0.0;
+
+    for (unsigned row = 0; row < MATRIX_ROWS; row++) {
+        for (unsigned col = 0; col < MATRIX_COLS; col++) {
+            double diff = fabs(a[row][col] - b[row][col]);
+            if (diff > max_diff) {
+                max_diff = diff;
+            }
+        }
+    }
+    return max_diff;
+}
+
+/**
+ * Runs every barrier, subtask count and sample of the sweep in turn, see
+ *   sweep.h. buffers holds the two matrices every run iterates between, or
+ *   just the copy of the input of an in place run, and the result of the
+ *   first run to compare the others to.
+ */
+int sweep_run(const sweep_t *sweep, const jacobi_opts_t *opts, \
+        double (*input_matrix)[MATRIX_STRIDE], char *output_fname, \
+        unsigned *failed) {
+    jacobi_opts_t run_opts = *opts;
+    double (*buffers[3])[MATRIX_STRIDE] = {NULL, NULL, NULL};
+    unsigned long *flush_buf = NULL;
+    FILE *output = NULL;
+    bool first_done = false;
+    int ret = 0;
+
+    *failed = 0;
+    for (unsigned i = 0; i < 3 && ret == 0; i++) {
+        if (matrix_init(&(buffers[i])) != MAT_ERR_NONE) {
+            ret = -1;
+        }
+    }
+    if (ret == 0 && sweep->flush) {
+        errno = 0;
+        flush_buf = calloc(1, SWEEP_FLUSH_BYTES);
+        if (flush_buf == NULL) {
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        errno = 0;
+        output = fopen(output_fname, "w");
+        if (output == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        fprintf(output, "barrier,subtasks,sample,iterations,real_time,"\
+            "cpu_time,max_diff,\n");
+        if (!opts->in_place) {
+            run_opts.buffers[0] = buffers[0];
+            run_opts.buffers[1] = buffers[1];
+        }
+    }
+    for (unsigned b = 0; b < sweep->barrier_num && ret == 0; b++) {
+        for (unsigned t = 0; t < sweep->thread_num; t++) {
+            for (unsigned s = 0; s < sweep->samples; s++) {
+                double (*run_input)[MATRIX_STRIDE] = input_matrix;
+                jacobi_ctx_t *ctx = NULL;
+                struct runtime_stats rs;
+                jacobi_err j_err;
+
+                run_opts.barrier_id = (barrier_e)sweep->barriers[b];
+                run_opts.subtask_num = sweep->threads[t];
+                // In place runs overwrite their input, so each gets a copy
+                if (opts->in_place) {
+                    memcpy(buffers[0], input_matrix, MATRIX_BYTES);
+                    run_input = buffers[0];
+                }
+                fprintf(output, "%u,%u,%u,", sweep->barriers[b], \
+                    sweep->threads[t], s);
+                j_err = jacobi_create(&ctx, &run_opts, run_input);
+                if (j_err == JACOBI_ERR_NONE) {
+                    if (flush_buf != NULL) {
+                        sweep_flush(flush_buf);
+                    }
+                    j_err = jacobi_solve(ctx, &rs);
+                }
+                if (j_err != JACOBI_ERR_NONE) {
+                    fprintf(output, "failed,\n");
+                    (*failed)++;
+                }
+                else {
+                    if (!first_done) {
+                        memcpy(buffers[2], jacobi_result(ctx), MATRIX_BYTES);
+                        first_done = true;
+                    }
+                    fprintf(output, "%d,%.10e,%.10e,%.10e,\n", \
+                        rs.iterations, \
+                        conv_timespec_to_ms(&(rs.runtime_real)), \
+                        conv_timespec_to_ms(&(rs.runtime_cpu_process)), \
+                        sweep_max_diff(jacobi_result(ctx), buffers[2]));
+                }
+                if (ctx != NULL) {
+                    jacobi_destroy(ctx);
+                }
+            }
+        }
+    }
+
+    if (output != NULL && fclose(output) != 0) {
+        ret = -1;
+    }
+    free(flush_buf);
+    for (unsigned i = 0; i < 3; i++) {
+        if (buffers[i] != NULL) {
+            matrix_delete(&(buffers[i]));
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,53 @@
+#ifndef __SWEEP_H
+#define __SWEEP_H
+#include "jacobi.h"
+#include <stdio.h>
+
+// Sweep mode
+// Runs every barrier, subtask count and sample of a sweep in one process, in
+//   place of launching the solver once for each of them. The input is read
+//   once, and every run iterates between the same two matrices, so a run
+//   only costs its solve. The spec is a space separated list of key=value:
+//   barriers=0,1,2   barriers to run, every barrier by default
+//   threads=1..256   subtask counts to run, 1 by default. a..b is a and every
+//                    doubling of it up to b, and lists may mix both, like
+//                    1,3,8..64
+//   samples=5        runs of each barrier and subtask count, 1 by default
+//   flush=1          evicts the caches before every run, 0 by default
+// Every run is a line of one CSV table:
+//   barrier,subtasks,sample,iterations,real-time(ms),cpu-time(ms),max diff,
+//   max diff is the largest difference between the result of the run and
+//   that of the first one, which stands in for checking every output.
+
+// Most values any list of the spec can have
+#define SWEEP_LIST_MAX 64
+// Bigger than the last level cache of anything this runs on, so writing it
+//   evicts everything the last run left there
+#define SWEEP_FLUSH_BYTES (64UL * 1024UL * 1024UL)
+
+typedef struct sweep sweep_t;
+struct sweep {
+    unsigned barriers[SWEEP_LIST_MAX];
+    unsigned barrier_num;
+    unsigned threads[SWEEP_LIST_MAX];
+    unsigned thread_num;
+    unsigned samples;
+    bool flush;
+};
+
+// Parses a sweep spec, returns -1 if it is invalid.
+int sweep_parse(sweep_t *sweep, const char *spec);
+// Runs the sweep with opts for everything it doesn't vary, and writes the
+//   table to output_fname. Runs that fail are left in the table as
+//   barrier,subtasks,sample,failed, and counted in failed.
+int sweep_run(const sweep_t *sweep, const jacobi_opts_t *opts, \
+    double (*input_matrix)[MATRIX_STRIDE], char *output_fname, \
+    unsigned *failed);
+
+// Helpers for sweep_run
+int sweep_parse_list(unsigned *values, unsigned *value_num, char *list);
+void sweep_flush(unsigned long *flush_buf);
+double sweep_max_diff(double (*a)[MATRIX_STRIDE], \
+    double (*b)[MATRIX_STRIDE]);
+
+#endif /* __SWEEP_H */
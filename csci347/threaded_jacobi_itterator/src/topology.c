@@ -0,0 +1,139 @@
+#define _GNU_SOURCE
+#include "topology.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+// Read once for the whole process
+static topology_t topology;
+static bool topology_ok = false;
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Reads a single number out of a sysfs file of a CPU. Returns -1 if the file
+ *   is missing or does not hold one.
+ */
+long topology_read_id(unsigned cpu, const char *file) {
+    char path[128];
+    long id = -1;
+
+    snprintf(path, sizeof(path), TOPOLOGY_SYSFS_CPU, cpu, file);
+    FILE *f = fopen(path, "r");
+    if (f != NULL) {
+        if (fscanf(f, "%ld", &id) != 1) {
+            id = -1;
+        }
+        fclose(f);
+    }
+    return id;
+}
+
+/**
+ * Finds the cache domain of a CPU. L3 ids are only unique within a socket,
+ *   so the domain key is made of both.
+ */
+long topology_cpu_key(unsigned cpu) {
+    long package = topology_read_id(cpu, "topology/physical_package_id");
+    long l3 = -1;
+
+    if (topology_read_id(cpu, "cache/index3/level") == 3) {
+        l3 = topology_read_id(cpu, "cache/index3/id");
+    }
+    if (package < 0) {
+        package = 0;
+    }
+    return package * 65536 + (l3 < 0 ? 0 : l3);
+}
+
+/**
+ * Reads the topology of the CPUs in the process's affinity mask.
+ */
+void topology_init(void) {
+    cpu_set_t set;
+    long *keys;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &set) == 0) {
+        unsigned cpu_num = CPU_COUNT(&set);
+        topology.cpus = malloc(sizeof(unsigned) * cpu_num);
+        topology.cpu_domain = malloc(sizeof(unsigned) * cpu_num);
+        keys = malloc(sizeof(long) * cpu_num);
+        if (topology.cpus != NULL && topology.cpu_domain != NULL && \
+                keys != NULL && cpu_num > 0) {
+            unsigned n = 0;
+            for (unsigned cpu = 0; cpu < CPU_SETSIZE && n < cpu_num; cpu++) {
+                if (CPU_ISSET(cpu, &set)) {
+                    topology.cpus[n] = cpu;
+                    keys[n] = topology_cpu_key(cpu);
+                    n++;
+                }
+            }
+            topology.cpu_num = n;
+
+            // Insertion sort by domain key, CPU ids are already in order so
+            //   this keeps them in order within a domain
+            for (unsigned i = 1; i < n; i++) {
+                long key = keys[i];
+                unsigned cpu = topology.cpus[i];
+                unsigned j = i;
+                while (j > 0 && keys[j-1] > key) {
+                    keys[j] = keys[j-1];
+                    topology.cpus[j] = topology.cpus[j-1];
+                    j--;
+                }
+                keys[j] = key;
+                topology.cpus[j] = cpu;
+            }
+
+            topology.domain_num = 0;
+            for (unsigned i = 0; i < n; i++) {
+                if (i > 0 && keys[i] != keys[i-1]) {
+                    topology.domain_num++;
+                }
+                topology.cpu_domain[i] = topology.domain_num;
+            }
+            topology.domain_num++;
+            topology_ok = true;
+        }
+        free(keys);
+    }
+}
+
+/**
+ * The topology of the machine, read from sysfs on the first call.
+ */
+const topology_t *topology_get(void) {
+    pthread_once(&topology_once, topology_init);
+    return topology_ok ? &topology : NULL;
+}
+
+/**
+ * CPU that a thread slot runs on.
+ */
+unsigned topology_slot_cpu(const topology_t *topo, unsigned slot) {
+    return topo->cpus[slot % topo->cpu_num];
+}
+
+/**
+ * Domain that a thread slot runs in.
+ */
+unsigned topology_slot_domain(const topology_t *topo, unsigned slot) {
+    return topo->cpu_domain[slot % topo->cpu_num];
+}
+
+/**
+ * Pins the calling thread to the CPU of its slot.
+ */
+int topology_pin(unsigned slot) {
+    const topology_t *topo = topology_get();
+    cpu_set_t set;
+    int ret = ENOENT;
+
+    if (topo != NULL) {
+        CPU_ZERO(&set);
+        CPU_SET(topology_slot_cpu(topo, slot), &set);
+        ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+    }
+    return ret;
+}
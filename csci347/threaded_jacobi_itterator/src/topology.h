@@ -0,0 +1,35 @@
+#ifndef __TOPOLOGY_H
+#define __TOPOLOGY_H
+#include <stdbool.h>
+
+// CPU topology
+// The CPUs this process may run on, grouped into domains that share a last
+//   level cache. Domains come from the L3 cache ids in sysfs, or the socket
+//   (physical package) ids where there is no L3. If sysfs has neither, all
+//   the CPUs make up one domain.
+// Threads are given slots 0, 1, 2... Slots are handed out a domain at a time,
+//   so neighbouring slots share a cache for as long as the domain has CPUs.
+//   Slots past the number of CPUs wrap around.
+
+#define TOPOLOGY_SYSFS_CPU "/sys/devices/system/cpu/cpu%u/%s"
+
+typedef struct topology topology_t;
+struct topology {
+    // CPU ids sorted by domain, then by id
+    unsigned *cpus;
+    // Domain of each entry of cpus
+    unsigned *cpu_domain;
+    unsigned cpu_num;
+    unsigned domain_num;
+};
+
+// The topology of the machine, read from sysfs on the first call. NULL if it
+//   could not be read.
+const topology_t *topology_get(void);
+// CPU and domain of a thread slot
+unsigned topology_slot_cpu(const topology_t *topo, unsigned slot);
+unsigned topology_slot_domain(const topology_t *topo, unsigned slot);
+// Pins the calling thread to the CPU of slot. Returns 0 or an error number.
+int topology_pin(unsigned slot);
+
+#endif /* __TOPOLOGY_H */